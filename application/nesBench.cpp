@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "nes.h"
+#include "rom_loader.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+const char* const DefaultRoms[] = { "roms/Balloon Fight (USA).nes", "roms/official_only.nes", "roms/color_test.nes" };
+
+struct Result {
+    std::string rom;
+    u32 frames;
+    double seconds;             // best of the repetitions
+    u64 instructions;
+    u64 dots;
+    long peakRss;               // KB, the whole process so far
+    double relativeSpeed;       // median of the repetitions
+
+    double FramesPerSecond() const { return frames / seconds; }
+    // frames run in the time of one reference workload
+    double RelativeSpeed() const { return relativeSpeed; }
+    double InstructionsPerSecond() const { return instructions / seconds; }
+    double DotsPerSecond() const { return dots / seconds; }
+};
+
+long PeakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * A fixed amount of host work, independent of the emulator: a small bytecode
+ * interpreter, branchy and memory bound as the CPU emulation is. The speed
+ * of a rom relative to it moves with the code, not with the machine, its
+ * clock or its load.
+ * @param iterations the bytecodes to run, ReferenceIterations make the unit
+ * of the relative speeds
+ * @return the seconds it took
+ */
+double ReferenceWorkload(u32 iterations)
+{
+    static u8 program[4096];
+    static u8 memory[2048];
+    u32 seed = 0x12345678;
+    for (u8& byte : program) {
+        seed = seed * 1103515245 + 12345;
+        byte = u8(seed >> 16);
+    }
+    memset(memory, 0, sizeof(memory));
+
+    auto begin = std::chrono::steady_clock::now();
+    u32 a = 0;
+    u32 pc = 0;
+    for (u32 i = 0; i < iterations; ++i) {
+        u8 opcode = program[pc];
+        u8 operand = program[(pc + 1) & 4095];
+        switch (opcode & 7) {
+        case 0: a += operand; break;
+        case 1: a ^= memory[operand << 3]; break;
+        case 2: memory[(a + operand) & 2047] = u8(a); break;
+        case 3: a = (a << 1) | (a >> 31); break;
+        case 4: if (a & 1) { pc += operand; } break;
+        case 5: a -= memory[(a ^ operand) & 2047]; break;
+        case 6: a = a * 3 + 1; break;
+        default: pc ^= a & 0xFF; break;
+        }
+        pc = (pc + 2) & 4095;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    volatile u32 sink = a;
+    (void)sink;
+    return seconds;
+}
+
+std::string HostName()
+{
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (line.compare(0, 10, "model name") != 0 || colon == std::string::npos) {
+            continue;
+        }
+        size_t value = line.find_first_not_of(" \t", colon + 1);
+        return value == std::string::npos ? "unknown" : line.substr(value);
+    }
+    return "unknown";
+}
+
+const u32 ReferenceIterations = 20000000;
+// frames run between two slices of the reference workload
+const u32 SliceFrames = 30;
+const u32 SliceIterations = ReferenceIterations / 2;
+// runs of a rom slower than the baseline before it counts, the state of a
+// shared machine moves slower than the slices and shifts a whole run
+const u32 ConfirmRuns = 2;
+
+/**
+ * Runs the frames as Nes::RunFrame does, counting what it executes. Every
+ * SliceFrames frames run right after a slice of the reference workload of
+ * about the same length, so that a load coming and going slows both alike;
+ * each slice gives a relative speed, the median of the slices of all the
+ * repetitions resists the bursts that still fall on one side.
+ */
+Result Run(const std::string& path, u32 frames, u32 repeat)
+{
+    Result result{ path, frames, 0, 0, 0, 0, 0 };
+    Rom rom(RomLoader::GetRom(path));
+    std::vector<double> relativeSpeeds;
+    for (u32 i = 0; i < repeat; ++i) {
+        Nes nes(rom);
+        nes.ppu.AllocateFrameBuffers();
+        u64 instructions = 0;
+        u64 cycles = 0;
+        double seconds = 0;
+
+        for (u32 frame = 0; frame < frames; frame += SliceFrames) {
+            double referenceSeconds = ReferenceWorkload(SliceIterations) * ReferenceIterations / SliceIterations;
+            u32 sliceFrames = std::min(SliceFrames, frames - frame);
+            auto begin = std::chrono::steady_clock::now();
+            u64 last = nes.ppu.Frame + sliceFrames;
+            while (nes.ppu.Frame < last) {
+                nes.Step();
+                instructions++;
+                cycles += nes.cpu.cycles;
+            }
+            double sliceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            seconds += sliceSeconds;
+            relativeSpeeds.push_back(sliceFrames / sliceSeconds * referenceSeconds);
+        }
+
+        if (i == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        result.instructions = instructions;
+        result.dots = cycles * 3;
+    }
+    delete[] rom.GetRaw();
+    std::sort(relativeSpeeds.begin(), relativeSpeeds.end());
+    size_t middle = relativeSpeeds.size() / 2;
+    result.relativeSpeed = relativeSpeeds.size() % 2 ? relativeSpeeds[middle] : (relativeSpeeds[middle - 1] + relativeSpeeds[middle]) / 2;
+    result.peakRss = PeakRss();
+    return result;
+}
+
+std::string Escape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void WriteJson(std::ostream& out, const std::vector<Result>& results)
+{
+    out << "{\n  \"host\": \"" << Escape(HostName()) << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << std::fixed << std::setprecision(1)
+            << "    {\"rom\": \"" << Escape(result.rom) << "\", \"frames\": " << result.frames
+            << ", \"framesPerSecond\": " << result.FramesPerSecond()
+            << ", \"relativeSpeed\": " << std::setprecision(2) << result.RelativeSpeed()
+            << ", \"instructionsPerSecond\": " << std::setprecision(0) << result.InstructionsPerSecond()
+            << ", \"dotsPerSecond\": " << result.DotsPerSecond()
+            << ", \"peakRssKb\": " << result.peakRss << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+struct Baseline {
+    u32 frames;
+    double framesPerSecond;
+    double relativeSpeed;       // 0 in the reports written before it
+};
+
+// reads a quoted JSON string starting at the given index
+std::string ReadString(const std::string& line, size_t start)
+{
+    std::string text;
+    for (size_t i = start; i < line.size() && line[i] != '"'; ++i) {
+        if (line[i] == '\\' && i + 1 < line.size()) {
+            ++i;
+        }
+        text += line[i];
+    }
+    return text;
+}
+
+/**
+ * Reads the speed of each rom from a report of this tool, one result per
+ * line as WriteJson writes them, and the host it ran on, empty in the
+ * reports written before it.
+ */
+bool ReadBaseline(const std::string& path, std::map<std::string, Baseline>& baseline, std::string& host)
+{
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    const std::string hostKey = "\"host\": \"";
+    const std::string romKey = "\"rom\": \"";
+    const std::string framesKey = "\"frames\": ";
+    const std::string fpsKey = "\"framesPerSecond\": ";
+    const std::string relativeKey = "\"relativeSpeed\": ";
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hostAt = line.find(hostKey);
+        if (hostAt != std::string::npos) {
+            host = ReadString(line, hostAt + hostKey.size());
+            continue;
+        }
+        size_t rom = line.find(romKey);
+        size_t frames = line.find(framesKey);
+        size_t fps = line.find(fpsKey);
+        size_t relative = line.find(relativeKey);
+        if (rom == std::string::npos || frames == std::string::npos || fps == std::string::npos) {
+            continue;
+        }
+        std::string name = ReadString(line, rom + romKey.size());
+        baseline[name] = Baseline{ u32(std::atoi(line.c_str() + frames + framesKey.size())),
+                                   std::atof(line.c_str() + fps + fpsKey.size()),
+                                   relative == std::string::npos ? 0 : std::atof(line.c_str() + relative + relativeKey.size()) };
+    }
+    return true;
+}
+
+}
+
+/**
+ * Measures the emulation speed on a fixed set of roms, without any I/O while
+ * the frames run.
+ *
+ * usage: nes_bench [--frames N] [--repeat N] [--json FILE] [--baseline FILE] [--tolerance PERCENT] [rom...]
+ * Each rom runs N frames from power on, N times. The frames per second are
+ * the best of the repetitions and only printed; the speed relative to the
+ * reference workload is the median of their slices. The baseline is a JSON
+ * report of this tool; exits with 1 when the relative speed of a rom is more
+ * than the tolerance lower than in it, in ConfirmRuns more runs as well. The
+ * ratio to the reference workload still moves with the caches and the branch
+ * predictor of the host, a baseline from another one is compared with a
+ * warning.
+ */
+int main(int argc, char* argv[])
+{
+    u32 frames = 600;
+    u32 repeat = 3;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10;
+    std::vector<std::string> roms;
+    for (int i = 1; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (option == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (option == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+        } else {
+            roms.push_back(option);
+        }
+    }
+    if (roms.empty()) {
+        roms.assign(std::begin(DefaultRoms), std::end(DefaultRoms));
+    }
+
+    std::map<std::string, Baseline> baseline;
+    std::string baselineHost;
+    if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline, baselineHost)) {
+        std::cerr << "cannot read the baseline " << baselinePath << std::endl;
+        return 2;
+    }
+    if (!baselinePath.empty() && baselineHost != HostName()) {
+        std::cerr << "warning: the baseline ran on " << (baselineHost.empty() ? "an unknown host" : baselineHost)
+                  << ", regenerate it with --json on this one for a reliable comparison" << std::endl;
+    }
+
+    std::vector<Result> results;
+    for (const std::string& rom : roms) {
+        results.push_back(Run(rom, frames, repeat));
+    }
+
+    u32 regressions = 0;
+    for (Result& result : results) {
+        auto found = baseline.find(result.rom);
+        if (found == baseline.end()) {
+            continue;
+        }
+        if (found->second.frames != result.frames) {
+            // the first frames of a game do not cost as much as the next ones
+            std::cerr << "       " << result.rom << ": the baseline ran " << found->second.frames << " frames, not compared" << std::endl;
+            continue;
+        }
+        if (found->second.relativeSpeed <= 0) {
+            std::cerr << "       " << result.rom << ": no relative speed in the baseline, not compared" << std::endl;
+            continue;
+        }
+        double change = (result.RelativeSpeed() / found->second.relativeSpeed - 1) * 100;
+        for (u32 i = 0; i < ConfirmRuns && change < -tolerance; ++i) {
+            std::cerr << "       " << result.rom << ": " << std::fixed << std::setprecision(1) << change << "%, measured again" << std::endl;
+            Result again = Run(result.rom, frames, repeat);
+            if (again.RelativeSpeed() > result.RelativeSpeed()) {
+                result = again;
+                change = (result.RelativeSpeed() / found->second.relativeSpeed - 1) * 100;
+            }
+        }
+        bool slower = change < -tolerance;
+        regressions += slower;
+        std::cerr << (slower ? "SLOWER " : "       ") << result.rom << ": " << std::fixed << std::setprecision(1)
+                  << found->second.framesPerSecond << " -> " << result.FramesPerSecond() << " frames/s, relative speed "
+                  << std::setprecision(2) << found->second.relativeSpeed << " -> " << result.RelativeSpeed() << " ("
+                  << std::setprecision(1) << std::showpos << change << std::noshowpos << "%)" << std::endl;
+    }
+
+    WriteJson(std::cout, results);
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        WriteJson(out, results);
+    }
+    return regressions == 0 ? 0 : 1;
+}
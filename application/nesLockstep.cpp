@@ -0,0 +1,243 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "lockstep.h"
+#include "movie.h"
+#include "nes.h"
+#include "rom_loader.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+struct Options {
+    std::string moviePath;
+    std::string candidate = "pipeline";
+    u32 frames = 600;
+    Lockstep::Granularity granularity = Lockstep::Granularity::ScanLine;
+    u32 window = 16;
+};
+
+std::unique_ptr<LockstepCore> MakeCore(const std::string& name, Nes& nes)
+{
+    if (name == "pipeline") {
+        return std::unique_ptr<LockstepCore>(new PipelineCore(nes));
+    }
+    if (name == "skip") {
+        nes.ppu.skipRender = true;
+    }
+    return std::unique_ptr<LockstepCore>(new LockstepCore(nes));
+}
+
+const char* GetPartName(u32 offset)
+{
+    if (offset < offsetof(NesState, ppu)) return "CPU registers";
+    if (offset < offsetof(NesState, pads)) return "PPU registers";
+    if (offset < offsetof(NesState, ram)) return "pads";
+    if (offset < offsetof(NesState, io)) return "RAM";
+    if (offset < offsetof(NesState, sram)) return "I/O registers";
+    if (offset < offsetof(NesState, paletteData)) return "cartridge RAM";
+    if (offset < offsetof(NesState, nameTableData)) return "palette";
+    if (offset < offsetof(NesState, oamData)) return "name tables";
+    if (offset < offsetof(NesState, chrData)) return "OAM";
+    return "pattern tables";
+}
+
+void PrintRecord(const InstructionTrace::Record& record)
+{
+    printf("%04X  %-10s A:%02X X:%02X Y:%02X P:%02X SP:%02X", record.pc, Cpu::instructions[record.bytes[0]].name,
+           record.a, record.x, record.y, record.p, record.sp);
+}
+
+void PrintDivergence(const Lockstep& lockstep)
+{
+    const Lockstep::Divergence& divergence = lockstep.GetDivergence();
+    printf("diverged after instruction %llu (frame %llu, scanline %u, dot %u), last match after %llu\n",
+           (unsigned long long)divergence.instruction, (unsigned long long)divergence.frame, divergence.scanLine,
+           divergence.dot, (unsigned long long)divergence.lastMatch);
+    printf("first difference at byte $%04X of the state: %s\n", divergence.offset, GetPartName(divergence.offset));
+    printf("             reference         candidate\n");
+    printf("registers    %016llx  %016llx\n", (unsigned long long)divergence.reference.registers,
+           (unsigned long long)divergence.candidate.registers);
+    printf("ram          %016llx  %016llx\n", (unsigned long long)divergence.reference.ram,
+           (unsigned long long)divergence.candidate.ram);
+    printf("ppu          %016llx  %016llx\n", (unsigned long long)divergence.reference.ppu,
+           (unsigned long long)divergence.candidate.ppu);
+
+    std::vector<InstructionTrace::Record> reference = lockstep.GetWindow(false);
+    std::vector<InstructionTrace::Record> candidate = lockstep.GetWindow(true);
+    printf("\nlast instructions, reference | candidate:\n");
+    for (size_t i = 0; i < reference.size() || i < candidate.size(); ++i) {
+        if (i < reference.size()) {
+            PrintRecord(reference[i]);
+        } else {
+            printf("%52s", "");
+        }
+        printf(" | ");
+        if (i < candidate.size()) {
+            PrintRecord(candidate[i]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * Runs rom on the reference and the candidate until frames are run, the
+ * movie ends or they diverge, comparing them from the instruction from.
+ * @return false when they diverged, lastMatch is set then
+ */
+bool Run(Rom& rom, const Options& options, Lockstep::Granularity granularity, u64 from, bool report, u64& lastMatch)
+{
+    Nes reference(rom);
+    Nes other(rom);
+    Movie referenceMovie(reference);
+    Movie otherMovie(other);
+    if (!options.moviePath.empty()) {
+        // the movie checkpoints hash the pictures
+        reference.ppu.AllocateFrameBuffers();
+        other.ppu.AllocateFrameBuffers();
+        if (!referenceMovie.Play(options.moviePath) || !otherMovie.Play(options.moviePath)) {
+            std::cerr << "Cannot play " << options.moviePath << std::endl;
+            exit(2);
+        }
+    }
+    // after the movie loaded its state, the pipeline takes the timing of the Ppu
+    std::unique_ptr<LockstepCore> candidate = MakeCore(options.candidate, other);
+    Lockstep lockstep(reference, *candidate, granularity, from, options.window);
+
+    for (u32 i = 0; i < options.frames; ++i) {
+        if (!lockstep.RunFrame()) {
+            if (report) {
+                PrintDivergence(lockstep);
+            }
+            lastMatch = lockstep.GetDivergence().lastMatch;
+            return false;
+        }
+        if (referenceMovie.GetMode() == Movie::Mode::Playing) {
+            referenceMovie.EndFrame();
+            otherMovie.EndFrame();
+            if (referenceMovie.GetMode() == Movie::Mode::Finished) {
+                break;
+            }
+        }
+    }
+    if (report) {
+        printf("%llu instructions, %llu comparisons, no divergence\n", (unsigned long long)lockstep.GetInstructions(),
+               (unsigned long long)lockstep.GetComparisons());
+    }
+    return true;
+}
+
+/**
+ * Runs both machines and, when they diverge between two comparisons, once
+ * more comparing every instruction from the last match.
+ */
+bool Check(Rom& rom, const Options& options, bool verbose)
+{
+    u64 lastMatch = 0;
+    bool instructions = options.granularity == Lockstep::Granularity::Instruction;
+    if (Run(rom, options, options.granularity, 0, verbose || instructions, lastMatch)) {
+        return true;
+    }
+    if (!instructions) {
+        printf("\nreplayed comparing every instruction after %llu:\n", (unsigned long long)lastMatch);
+        Run(rom, options, Lockstep::Granularity::Instruction, lastMatch, true, lastMatch);
+    }
+    return false;
+}
+
+}
+
+/**
+ * Runs a game on the plain Nes::Step and on another way to run it side by
+ * side, and compares the two machines until they diverge.
+ *
+ * usage: nes_lockstep rom [--movie FILE] [options]
+ *        nes_lockstep --fuzz COUNT [--seed S] [--instructions N] [options]
+ * options: [--frames N] [--candidate pipeline|skip|step] [--granularity instruction|scanline|frame] [--window N]
+ * The candidate is the PpuPipeline by default, skip runs Nes::Step without
+ * drawing the pictures and step runs it as the reference. The machines are
+ * compared at the end of each scanline by default; when they diverge the run
+ * is replayed comparing every instruction, to show the first one which
+ * diverged and the instructions before it. --fuzz runs COUNT random
+ * programs (Lockstep::MakeFuzzRom) from seed S, 10 frames each by default.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " rom [--movie FILE] [options]" << std::endl
+                  << "       " << argv[0] << " --fuzz COUNT [--seed S] [--instructions N] [options]" << std::endl
+                  << "options: [--frames N] [--candidate pipeline|skip|step]"
+                  << " [--granularity instruction|scanline|frame] [--window N]" << std::endl;
+        return 2;
+    }
+    Options options;
+    u32 fuzz = 0;
+    u64 seed = 1;
+    u32 instructions = 64;
+    bool framesSet = false;
+    std::string romPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--movie" && i + 1 < argc) {
+            options.moviePath = argv[++i];
+        } else if (option == "--frames" && i + 1 < argc) {
+            options.frames = std::strtoul(argv[++i], nullptr, 10);
+            framesSet = true;
+        } else if (option == "--candidate" && i + 1 < argc) {
+            options.candidate = argv[++i];
+        } else if (option == "--window" && i + 1 < argc) {
+            options.window = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--granularity" && i + 1 < argc) {
+            std::string granularity(argv[++i]);
+            if (granularity == "instruction") {
+                options.granularity = Lockstep::Granularity::Instruction;
+            } else if (granularity == "frame") {
+                options.granularity = Lockstep::Granularity::Frame;
+            } else {
+                options.granularity = Lockstep::Granularity::ScanLine;
+            }
+        } else if (option == "--fuzz" && i + 1 < argc) {
+            fuzz = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--instructions" && i + 1 < argc) {
+            instructions = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option[0] != '-') {
+            romPath = option;
+        }
+    }
+    if (options.candidate != "pipeline" && options.candidate != "skip" && options.candidate != "step") {
+        std::cerr << "Unknown candidate " << options.candidate << std::endl;
+        return 2;
+    }
+
+    if (fuzz > 0) {
+        if (!framesSet) {
+            options.frames = 10;
+        }
+        for (u64 i = seed; i < seed + fuzz; ++i) {
+            std::vector<u8> image = Lockstep::MakeFuzzRom(i, instructions);
+            Rom rom(image.data(), image.size());
+            if (!Check(rom, options, false)) {
+                printf("seed %llu diverged\n", (unsigned long long)i);
+                return 1;
+            }
+        }
+        printf("%u programs, no divergence\n", fuzz);
+        return 0;
+    }
+
+    if (romPath.empty()) {
+        std::cerr << "No rom" << std::endl;
+        return 2;
+    }
+    Rom rom(RomLoader::GetRom(romPath));
+    return Check(rom, options, true) ? 0 : 1;
+}
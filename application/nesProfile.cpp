@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "nes.h"
+#include "profiler.h"
+#include "rom_loader.h"
+
+using namespace Frankenstein;
+
+/**
+ * Profiles the 6502 code of a game.
+ *
+ * usage: nes_profile rom [--frames N] [--symbols FILE] [--folded FILE] [--heatmap FILE] [--top N]
+ * Runs N frames (600 by default) without input, then prints the most
+ * expensive addresses and the cycles per bank. --symbols names the addresses
+ * from a ca65 debug file or a label file, --folded writes the call stacks for
+ * flamegraph.pl and --heatmap the cycles per address as a PGM picture.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " rom [--frames N] [--symbols FILE] [--folded FILE] [--heatmap FILE] [--top N]" << std::endl;
+        return 2;
+    }
+    u32 frames = 600;
+    u32 top = 20;
+    std::string foldedPath;
+    std::string heatmapPath;
+    SymbolTable symbols;
+    for (int i = 2; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--frames" && i + 1 < argc) {
+            frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--top" && i + 1 < argc) {
+            top = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--folded" && i + 1 < argc) {
+            foldedPath = argv[++i];
+        } else if (option == "--heatmap" && i + 1 < argc) {
+            heatmapPath = argv[++i];
+        } else if (option == "--symbols" && i + 1 < argc) {
+            if (!symbols.Load(argv[++i])) {
+                std::cerr << "No label in " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    Rom rom(RomLoader::GetRom(argv[1]));
+    Nes nes(rom);
+    Profiler profiler(nes);
+    for (u32 i = 0; i < frames; ++i) {
+        profiler.RunFrame();
+    }
+
+    u64 total = profiler.GetCycles();
+    std::cout << frames << " frames, " << total << " cycles" << std::endl << std::endl;
+    std::cout << "address      cycles       %  label" << std::endl;
+    for (const auto& hot : profiler.GetHottest(top)) {
+        printf("$%04X  %12llu  %5.2f%%  %s\n", hot.first, static_cast<unsigned long long>(hot.second),
+               100.0 * hot.second / total, symbols.Locate(hot.first).c_str());
+    }
+    std::cout << std::endl << "bank         cycles       %" << std::endl;
+    for (const Profiler::Bank& bank : profiler.GetBanks()) {
+        printf("%-5s  %12llu  %5.2f%%\n", bank.name.c_str(), static_cast<unsigned long long>(bank.cycles),
+               100.0 * bank.cycles / total);
+    }
+
+    if (!foldedPath.empty()) {
+        std::ofstream folded(foldedPath);
+        profiler.WriteFoldedStacks(folded, symbols);
+        if (!folded) {
+            std::cerr << "Cannot write " << foldedPath << std::endl;
+            return 1;
+        }
+    }
+    if (!heatmapPath.empty()) {
+        std::ofstream heatmap(heatmapPath, std::ios::binary);
+        profiler.WriteHeatmap(heatmap);
+        if (!heatmap) {
+            std::cerr << "Cannot write " << heatmapPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ftw.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "nes.h"
+#include "thread_pool.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+struct Result {
+    enum class Status { Ok, Unimplemented, Hang, UnsupportedMapper, Error, Invalid };
+
+    std::string rom;            // path relative to the swept directory
+    Status status;
+    int mapper;                 // -1 when the header cannot be read
+    u32 unimplemented;          // unimplemented opcodes executed
+    std::set<u8> opcodes;       // the distinct unimplemented opcodes
+    double fps;
+    u64 hash;                   // hash of the picture of the last frame
+    std::string message;
+};
+
+const char* const StatusNames[] = { "ok", "unimplemented", "hang", "unsupported-mapper", "error", "invalid" };
+
+const char* StatusName(Result::Status status)
+{
+    return StatusNames[static_cast<int>(status)];
+}
+
+Result::Status ParseStatus(const std::string& name)
+{
+    for (int i = 0; i < 6; ++i) {
+        if (name == StatusNames[i]) {
+            return static_cast<Result::Status>(i);
+        }
+    }
+    return Result::Status::Error;
+}
+
+std::vector<std::string> found;
+
+int Collect(const char* path, const struct stat*, int type, struct FTW*)
+{
+    std::string name(path);
+    std::string extension = name.size() > 4 ? name.substr(name.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (type == FTW_F && extension == ".nes") {
+        found.push_back(name);
+    }
+    return 0;
+}
+
+std::vector<u8> ReadFile(const std::string& path)
+{
+    std::vector<u8> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return data;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    if (!data.empty() && fread(data.data(), data.size(), 1, file) != 1) {
+        data.clear();
+    }
+    fclose(file);
+    return data;
+}
+
+// the Rom class trusts the header, check that the file holds what it announces
+std::string CheckHeader(const std::vector<u8>& data)
+{
+    if (data.size() < Rom::HeaderSize || data[0] != 'N' || data[1] != 'E' || data[2] != 'S' || data[3] != 0x1A) {
+        return "not an iNES file";
+    }
+    u64 expected = Rom::HeaderSize + ((data[6] & 0x04) ? Rom::TrainerSize : 0) + data[4] * 0x4000ull + data[5] * 0x2000ull;
+    if (data[4] == 0 || data.size() < expected) {
+        return "truncated file";
+    }
+    return "";
+}
+
+Result Run(const std::string& root, const std::string& path, u32 frames)
+{
+    Result result{ path.substr(root.size() + 1), Result::Status::Invalid, -1, 0, {}, 0, 0, "" };
+
+    std::vector<u8> data = ReadFile(path);
+    result.message = CheckHeader(data);
+    if (!result.message.empty()) {
+        return result;
+    }
+    result.mapper = (data[6] >> 4) | (data[7] & 0xF0);
+    // the Nes maps the cartridge as mapper 0 (NROM), any other would run garbage
+    if (result.mapper != 0) {
+        result.status = Result::Status::UnsupportedMapper;
+        result.message = "mapper " + std::to_string(result.mapper);
+        return result;
+    }
+
+    try {
+        Rom rom(data.data(), data.size());
+        Nes nes(rom);
+        nes.ppu.AllocateFrameBuffers();
+
+        auto begin = std::chrono::steady_clock::now();
+        bool displayed = false;
+        u16 lowestPC = 0xFFFF;
+        u16 highestPC = 0;
+        for (u32 frame = 0; frame < frames; ++frame) {
+            bool last = frame + 1 == frames;
+            u64 current = nes.ppu.Frame;
+            while (nes.ppu.Frame == current) {
+                u32 unimplemented = nes.cpu.unimplemented;
+                nes.Step();
+                if (nes.cpu.unimplemented != unimplemented) {
+                    result.opcodes.insert(nes.cpu.currentOpcode);
+                }
+                if (last) {
+                    lowestPC = std::min(lowestPC, nes.cpu.registers.PC);
+                    highestPC = std::max(highestPC, nes.cpu.registers.PC);
+                }
+            }
+            displayed |= nes.ppu.flagShowBackground != 0 || nes.ppu.flagShowSprites != 0;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        result.unimplemented = nes.cpu.unimplemented;
+        result.fps = frames / elapsed.count();
+        result.hash = Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+        result.message = "";
+        if (!displayed) {
+            // a game waiting for something that is not emulated, or lost in the weeds
+            result.status = Result::Status::Hang;
+            std::ostringstream message;
+            message << "nothing displayed, running at $" << std::hex << std::uppercase << lowestPC << "-$" << highestPC;
+            result.message = message.str();
+        } else if (result.unimplemented != 0) {
+            result.status = Result::Status::Unimplemented;
+        } else {
+            result.status = Result::Status::Ok;
+        }
+    } catch (const std::exception& exception) {
+        result.status = Result::Status::Error;
+        result.message = exception.what();
+    }
+    return result;
+}
+
+std::string Opcodes(const std::set<u8>& opcodes)
+{
+    std::ostringstream text;
+    text << std::hex << std::uppercase << std::setfill('0');
+    for (u8 opcode : opcodes) {
+        text << (text.tellp() > 0 ? " " : "") << std::setw(2) << int(opcode);
+    }
+    return text.str();
+}
+
+std::string Quote(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+std::vector<std::string> SplitCsv(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+            fields.back() += c;
+            ++i;
+        } else if (c == '"') {
+            quoted = !quoted;
+        } else if (!quoted && c == ',') {
+            fields.emplace_back();
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+const char* const CsvHeader = "rom,status,mapper,unimplemented,opcodes,fps,hash,message";
+
+void WriteCsv(const std::string& path, const std::vector<Result>& results)
+{
+    std::ofstream out(path);
+    out << CsvHeader << "\n";
+    for (const Result& result : results) {
+        out << Quote(result.rom) << "," << StatusName(result.status) << "," << result.mapper << ","
+            << result.unimplemented << "," << Opcodes(result.opcodes) << ","
+            << std::fixed << std::setprecision(1) << result.fps << ","
+            << std::hex << std::setw(16) << std::setfill('0') << result.hash << std::dec << std::setfill(' ') << ","
+            << Quote(result.message) << "\n";
+    }
+}
+
+std::string Escape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return escaped;
+}
+
+void WriteJson(const std::string& path, const std::vector<Result>& results, u32 frames)
+{
+    std::ofstream out(path);
+    out << "{\n  \"frames\": " << frames << ",\n  \"roms\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << "    {\"rom\": \"" << Escape(result.rom) << "\", \"status\": \"" << StatusName(result.status)
+            << "\", \"mapper\": " << result.mapper << ", \"unimplemented\": " << result.unimplemented
+            << ", \"opcodes\": \"" << Opcodes(result.opcodes) << "\", \"fps\": "
+            << std::fixed << std::setprecision(1) << result.fps << ", \"hash\": \""
+            << std::hex << std::setw(16) << std::setfill('0') << result.hash << std::dec << std::setfill(' ')
+            << "\", \"message\": \"" << Escape(result.message) << "\"}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+struct Baseline {
+    Result::Status status;
+    double fps;
+    std::string hash;
+};
+
+bool ReadBaseline(const std::string& path, std::map<std::string, Baseline>& baseline)
+{
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != CsvHeader) {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields = SplitCsv(line);
+        if (fields.size() >= 7) {
+            baseline[fields[0]] = Baseline{ ParseStatus(fields[1]), std::atof(fields[5].c_str()), fields[6] };
+        }
+    }
+    return true;
+}
+
+// prints the differences with the baseline, returns the number of regressions
+u32 Compare(const std::vector<Result>& results, const std::map<std::string, Baseline>& baseline, double tolerance)
+{
+    u32 regressions = 0;
+    std::set<std::string> seen;
+    for (const Result& result : results) {
+        seen.insert(result.rom);
+        auto found = baseline.find(result.rom);
+        if (found == baseline.end()) {
+            std::cout << "new       " << result.rom << " (" << StatusName(result.status) << ")" << std::endl;
+            continue;
+        }
+        const Baseline& before = found->second;
+        if (result.status != before.status) {
+            bool worse = result.status > before.status;
+            regressions += worse;
+            std::cout << (worse ? "REGRESSED " : "fixed     ") << result.rom << ": " << StatusName(before.status)
+                      << " -> " << StatusName(result.status) << std::endl;
+            continue;
+        }
+        std::ostringstream hash;
+        hash << std::hex << std::setw(16) << std::setfill('0') << result.hash;
+        if (result.status != Result::Status::Invalid && hash.str() != before.hash) {
+            regressions++;
+            std::cout << "CHANGED   " << result.rom << ": picture of the last frame differs" << std::endl;
+        }
+        if (before.fps > 0 && result.fps < before.fps * (1 - tolerance / 100)) {
+            regressions++;
+            std::cout << "SLOWER    " << result.rom << ": " << std::fixed << std::setprecision(1) << before.fps
+                      << " -> " << result.fps << " fps" << std::endl;
+        }
+    }
+    for (auto& entry : baseline) {
+        if (seen.count(entry.first) == 0) {
+            std::cout << "missing   " << entry.first << std::endl;
+        }
+    }
+    return regressions;
+}
+
+}
+
+/**
+ * Runs every rom of a directory tree for a number of frames and reports the
+ * ones that do not run: unreadable files, unsupported mappers, unimplemented
+ * opcodes and games that never turn the rendering on, with their speed and a
+ * hash of their last picture.
+ *
+ * usage: rom_sweep directory [--frames N] [--threads N] [--csv FILE] [--json FILE]
+ *                  [--baseline FILE] [--tolerance PERCENT]
+ * The baseline is a CSV report of an earlier sweep. Exits with 1 when a rom
+ * regressed against it: a worse status, a different picture, or a speed lower
+ * by more than the tolerance.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " directory [--frames N] [--threads N] [--csv FILE] [--json FILE]"
+                  << " [--baseline FILE] [--tolerance PERCENT]" << std::endl;
+        return 2;
+    }
+
+    std::string root(argv[1]);
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    u32 frames = 600;
+    u32 threads = 0;
+    std::string csvPath;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10;
+    for (int i = 2; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (option == "--csv" && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (option == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (option == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (option == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+        }
+    }
+
+    // read the baseline first, it may be overwritten by the new report
+    std::map<std::string, Baseline> baseline;
+    if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline)) {
+        std::cerr << "cannot read the baseline " << baselinePath << std::endl;
+        return 2;
+    }
+
+    if (nftw(root.c_str(), Collect, 16, FTW_PHYS) != 0) {
+        std::cerr << "cannot read the directory " << root << std::endl;
+        return 2;
+    }
+    std::sort(found.begin(), found.end());
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Result> results(found.size());
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < found.size(); ++i) {
+            pool.Submit([&results, &root, i, frames] { results[i] = Run(root, found[i], frames); });
+        }
+        pool.Wait();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    u32 counts[6] = {};
+    for (const Result& result : results) {
+        counts[static_cast<int>(result.status)]++;
+        if (result.status != Result::Status::Ok) {
+            std::cout << std::left << std::setw(20) << StatusName(result.status) << result.rom;
+            if (!result.opcodes.empty()) {
+                std::cout << " (opcodes " << Opcodes(result.opcodes) << ")";
+            }
+            if (!result.message.empty()) {
+                std::cout << " (" << result.message << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << results.size() << " roms, " << frames << " frames each, in " << std::fixed << std::setprecision(2)
+              << elapsed.count() << " s:";
+    for (int i = 0; i < 6; ++i) {
+        std::cout << " " << counts[i] << " " << StatusNames[i] << (i < 5 ? "," : "\n");
+    }
+
+    u32 regressions = baselinePath.empty() ? 0 : Compare(results, baseline, tolerance);
+
+    if (!csvPath.empty()) {
+        WriteCsv(csvPath, results);
+    }
+    if (!jsonPath.empty()) {
+        WriteJson(jsonPath, results, frames);
+    }
+    if (!baselinePath.empty()) {
+        std::cout << regressions << " regressions against " << baselinePath << std::endl;
+    }
+    return regressions == 0 ? 0 : 1;
+}
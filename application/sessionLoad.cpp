@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "nes.h"
+#include "rom_loader.h"
+#include "session_host.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+struct Result {
+    u32 sessions;
+    double missRate;
+    double load;    // busy fraction of the workers
+};
+
+// runs count sessions pressing buttons for a while, as players would
+Result Run(Rom& rom, u32 count, u32 threads, bool pin, bool video, double seconds)
+{
+    SessionHost host(threads, pin);
+    std::vector<u32> ids;
+    for (u32 i = 0; i < count; ++i) {
+        ids.push_back(host.Add(rom, video));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    for (u32 tick = 0; std::chrono::steady_clock::now() < end; ++tick) {
+        for (u32 i = 0; i < ids.size(); ++i) {
+            u8 buttons = (tick + i) % 8 == 0 ? 1 << Gamepad::Start : (tick / (i % 5 + 2)) % 2 << Gamepad::A;
+            host.SetButtons(ids[i], buttons);
+        }
+        std::this_thread::sleep_for(SessionHost::FramePeriod);
+    }
+
+    SessionHost::Stats totals = host.GetTotals();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    std::chrono::duration<double> busy = totals.emulation;
+
+    Result result;
+    result.sessions = count;
+    result.missRate = totals.frames == 0 ? 1.0 : double(totals.missed + totals.skipped) / (totals.frames + totals.skipped);
+    result.load = busy.count() / (elapsed.count() * host.GetPool().Size());
+    return result;
+}
+
+void Print(const Result& result)
+{
+    std::cout << std::setw(8) << result.sessions << " sessions: "
+              << std::fixed << std::setprecision(2)
+              << std::setw(6) << result.missRate * 100 << "% frames late, workers "
+              << std::setw(5) << result.load * 100 << "% busy" << std::endl;
+}
+
+}
+
+/**
+ * Finds how many sessions of a rom this machine runs at full speed.
+ *
+ * usage: session_load rom [--threads N] [--pin] [--video] [--seconds S] [--tolerance PERCENT]
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " rom [--threads N] [--pin] [--video] [--seconds S] [--tolerance PERCENT]" << std::endl;
+        return 2;
+    }
+
+    u32 threads = 0;
+    bool pin = false;
+    bool video = false;
+    double seconds = 3;
+    double tolerance = 1;
+    for (int i = 2; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (option == "--pin") {
+            pin = true;
+        } else if (option == "--video") {
+            video = true;
+        } else if (option == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (option == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+        }
+    }
+
+    Rom rom(RomLoader::GetRom(argv[1]));
+
+    // double the sessions until too many frames are late, then bisect
+    u32 sustained = 0;
+    u32 failed = 0;
+    for (u32 count = 8; failed == 0; count *= 2) {
+        Result result = Run(rom, count, threads, pin, video, seconds);
+        Print(result);
+        if (result.missRate * 100 <= tolerance) {
+            sustained = count;
+        } else {
+            failed = count;
+        }
+    }
+    while (failed - sustained > std::max(1u, sustained / 16)) {
+        u32 count = (sustained + failed) / 2;
+        Result result = Run(rom, count, threads, pin, video, seconds);
+        Print(result);
+        if (result.missRate * 100 <= tolerance) {
+            sustained = count;
+        } else {
+            failed = count;
+        }
+    }
+
+    Nes nes(rom);
+    if (video) {
+        nes.ppu.AllocateFrameBuffers();
+    }
+    for (u32 i = 0; i < 60; ++i) {
+        nes.RunFrame();
+    }
+    std::cout << "Sustained at real time: " << sustained << " sessions ("
+              << (threads == 0 ? std::thread::hardware_concurrency() : threads) << " threads, "
+              << nes.GetMemoryReport().Total() << " bytes per session)" << std::endl;
+
+    delete[] rom.GetRaw();
+    return 0;
+}
@@ -1,71 +1,219 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 
-#include <bitset>
 #include <chrono>
-#include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <sstream>
 
-#include <mutex>
+#include <memory>
 #include <thread>
 
+#include "battery_saver.h"
+#include "chrome_trace.h"
 #include "cpu.h"
+#include "frame_exchange.h"
 #include "nes.h"
 #include "gamepad.h"
+#include "input_snapshot.h"
+#include "instruction_trace.h"
+#include "movie.h"
+#include "ppu_pipeline.h"
+#include "rewind.h"
 #include "rom_loader.h"
 #include "rom_static.h"
+#include "run_ahead.h"
+#include "seq_lock.h"
+#include "spsc_ring.h"
 
 using Controller = Frankenstein::Gamepad::ButtonIndex;
 
-std::mutex imageMutex;
 sf::Texture screen;
 
-bool isRunning = true;
+// from the window thread to the emulator thread
+enum class Command : u8 {
+    Quit,
+    RewindStart,
+    RewindStop,
+};
+Frankenstein::SpscRing<Command, 64> commands;
 
-void emulatorMain(Frankenstein::Nes &nes)
+#ifdef WithStats
+// from the emulator thread to the window thread, the last frame counted
+Frankenstein::SeqLock<Frankenstein::FrameStats> lastFrameStats;
+
+// F1: the host time of the last frame as bars over the picture, the full
+// width is a 60 Hz period; the counters go to the window title every second
+void drawStatsOverlay(sf::RenderWindow& window, const Frankenstein::FrameStats& stats)
 {
-    std::ofstream out("debug2.txt", std::ios::out | std::ios::binary);
-    out << "EX.TIME|PPU|PC  |SVABDIZC|A |X |Y |Instruction| Hex data" << std::endl;
+    const float period = 16639000.f;
+    sf::RectangleShape cpu(sf::Vector2f(256.f * stats.cpuNanoseconds / period, 4.f));
+    cpu.setPosition(0.f, 0.f);
+    cpu.setFillColor(sf::Color(64, 128, 255, 192));
+    sf::RectangleShape ppu(sf::Vector2f(256.f * stats.ppuNanoseconds / period, 4.f));
+    ppu.setPosition(0.f, 4.f);
+    ppu.setFillColor(sf::Color(64, 255, 128, 192));
+    // the share of the CPU cycles stalled by OAM DMA
+    sf::RectangleShape dma(sf::Vector2f(stats.cpuCycles > 0 ? 256.f * stats.dmaStallCycles / stats.cpuCycles : 0.f, 2.f));
+    dma.setPosition(0.f, 8.f);
+    dma.setFillColor(sf::Color(255, 64, 64, 192));
+    window.draw(cpu);
+    window.draw(ppu);
+    window.draw(dma);
+
+    if (stats.frame % 60 == 0) {
+        std::stringstream title;
+        title << "Frankenstein NES Emulator - " << stats.instructions << " instructions, " << stats.cpuCycles << " cycles, "
+              << stats.statusPolls << " $2002 polls, cpu " << stats.cpuNanoseconds / 1000 << " us, ppu "
+              << stats.ppuNanoseconds / 1000 << " us";
+        window.setTitle(title.str());
+    }
+}
+#endif
+
+// about 10 minutes of gameplay at 60 fps
+static constexpr u32 RewindBudget = 32 * 1024 * 1024;
+
+void printRewindReport(const Frankenstein::Rewind& rewind, std::chrono::nanoseconds pushTime, u64 pushes)
+{
+    auto stats = rewind.GetStats();
+    std::cout << "Rewind: " << stats.used / 1024 << " KB used of " << stats.capacity / 1024 << " KB, "
+              << stats.frames << " frames (" << stats.frames / 60 << " s) with " << stats.keyframes << " keyframes" << std::endl;
+    if (stats.used > 0 && pushes > 0) {
+        std::cout << "Rewind: compression ratio " << double(stats.rawBytes) / stats.used << ", "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(pushTime).count() / pushes
+                  << " us per snapshot" << std::endl;
+    }
+}
+
+void printRunAheadReport(u32 frames, std::chrono::nanoseconds frameTime, u64 count)
+{
+    if (count > 0) {
+        std::cout << "Run-ahead: " << frames << " frames, "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(frameTime).count() / count
+                  << " us per frame" << std::endl;
+    }
+}
+
+void emulatorMain(Frankenstein::Nes &nes, Frankenstein::BatterySaver* saver, u32 runAheadFrames, u32 threads, Frankenstein::Movie* movie,
+                  std::string tracePath, Frankenstein::ChromeTrace* timeline)
+{
+    if (timeline != nullptr) {
+        timeline->NameThread("emulator");
+    }
+    u64 frame = nes.ppu.Frame;
+    Frankenstein::Rewind rewind(nes, RewindBudget);
+    std::chrono::nanoseconds pushTime(0);
+    u64 pushes = 0;
+    bool isRunning = true;
+    bool isRewinding = false;
+
+    auto pollCommands = [&]() {
+        Command command;
+        while (commands.Pop(command)) {
+            switch (command) {
+            case Command::Quit:
+                isRunning = false;
+                break;
+            case Command::RewindStart:
+                isRewinding = true;
+                break;
+            case Command::RewindStop:
+                isRewinding = false;
+                break;
+            }
+        }
+    };
+
+    auto endFrame = [&]() {
+        pollCommands();
+        if (movie->GetMode() == Frankenstein::Movie::Mode::Recording || movie->GetMode() == Frankenstein::Movie::Mode::Playing) {
+            // rewinding would break the movie timeline
+            movie->EndFrame();
+        }
+        // while rewinding, every emulated frame replays the previous snapshot
+        else if (!isRewinding || !rewind.Pop()) {
+            auto pushBegin = std::chrono::steady_clock::now();
+            rewind.Push();
+            pushTime += std::chrono::steady_clock::now() - pushBegin;
+            pushes++;
+        }
+        frame = nes.ppu.Frame;
+#ifdef WithStats
+        lastFrameStats.Store(nes.stats.Last());
+#endif
+
+        if (saver) {
+            saver->Update();
+        }
+    };
+
+    if (runAheadFrames > 0) {
+        // the instruction log would dwarf the frame time, run whole frames instead
+        Frankenstein::RunAhead runAhead(nes, runAheadFrames);
+        std::chrono::nanoseconds frameTime(0);
+        u64 frames = 0;
+
+        while (isRunning) {
+            auto begin = std::chrono::steady_clock::now();
+            runAhead.RunFrame();
+            frameTime += std::chrono::steady_clock::now() - begin;
+            frames++;
+            endFrame();
+            // frame pacing is left to the display loop, keep the emulation near 60 fps
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(16639));
+        }
+
+        printRunAheadReport(runAheadFrames, frameTime, frames);
+        printRewindReport(rewind, pushTime, pushes);
+        return;
+    }
+
+    if (threads > 1) {
+        // the PPU is emulated by a second thread, whole frames as well
+        Frankenstein::PpuPipeline pipeline(nes);
+        while (isRunning) {
+            auto begin = std::chrono::steady_clock::now();
+            pipeline.RunFrame();
+            endFrame();
+            // rewinding replaces the state
+            pipeline.Reload();
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(16639));
+        }
+
+        auto stats = pipeline.GetStats();
+        std::cout << "Pipeline: " << stats.writes << " register writes, " << stats.predictedReads << " reads predicted, "
+                  << stats.blockingReads << " blocking, " << stats.mispredictions << " mispredicted" << std::endl;
+        printRewindReport(rewind, pushTime, pushes);
+        return;
+    }
+
+    if (tracePath.empty()) {
+        while (isRunning) {
+            auto begin = std::chrono::steady_clock::now();
+            nes.RunFrame();
+            endFrame();
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(16639));
+        }
+
+        printRewindReport(rewind, pushTime, pushes);
+        return;
+    }
+
+    // every instruction in a binary trace, decode it with nes_tracedecode
+    Frankenstein::InstructionTrace trace(nes, tracePath);
+    if (!trace.IsOpen()) {
+        std::cerr << "Cannot write " << tracePath << std::endl;
+        return;
+    }
 
     while (isRunning) {
-        std::stringstream instString;
-        auto op = nes.cpu.OpCode();
-        auto instr = nes.cpu.instructions[op];
-        instString << std::setfill('0') << std::setw(3) << std::hex
-                   << (unsigned int)nes.ppu.Cycle << "|";
-        instString << std::setfill('0') << std::setw(4) << std::hex
-                   << (unsigned int)nes.cpu.registers.PC << "|";
-        instString << std::bitset<8>(nes.cpu.registers.P) << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.A << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.X << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.Y << "|";
-        instString << std::setfill(' ') << std::setw(11)
-                   << instr.name << "| ";
-
-        int max = instr.size == 0 ? 3 : instr.size;
-        for (int i = 0; i < max; i++) {
-            instString << std::setfill('0') << std::setw(2) << std::hex << (unsigned int)nes.cpu.Operand(i);
-            instString << " ";
-        }
-
-        auto begin = std::chrono::steady_clock::now();
-        nes.Step();
-        auto end = std::chrono::steady_clock::now();
-
-        out << std::setfill(' ') << std::setw(5) << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "ns|";
-        out << instString.str();
-        out << std::endl;
-
-        if (nes.ppu.vblankOccured) {
-            std::lock_guard<std::mutex> guard(imageMutex);
-            screen.update((const sf::Uint8*)nes.ppu.front);
+        trace.Step();
+        if (nes.ppu.Frame != frame) {
+            endFrame();
         }
     }
+
+    printRewindReport(rewind, pushTime, pushes);
 }
 
 int main(int argc, char* argv[])
@@ -78,10 +226,72 @@ int main(int argc, char* argv[])
     screen.create(256, 240);
 
     std::string file(argv[1]);
+    u32 runAheadFrames = 0;
+    u32 threads = 1;
+    std::string recordPath;
+    std::string playPath;
+    std::string tracePath;
+    std::string timelinePath;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string option(argv[i]);
+        if (option == "--runahead") {
+            runAheadFrames = std::stoul(argv[i + 1]);
+        } else if (option == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else if (option == "--record") {
+            recordPath = argv[i + 1];
+        } else if (option == "--play") {
+            playPath = argv[i + 1];
+        } else if (option == "--trace") {
+            tracePath = argv[i + 1];
+        } else if (option == "--chrome-trace") {
+            timelinePath = argv[i + 1];
+        }
+    }
     //Frankenstein::Rom rom(Frankenstein::StaticRom::raw, Frankenstein::StaticRom::length);// Frankenstein::RomLoader::GetRom(file));
     Frankenstein::Rom rom(Frankenstein::RomLoader::GetRom(file));
     Frankenstein::Nes nes(rom);
-    std::thread emulatorThr(emulatorMain, std::ref(nes));
+    nes.ppu.AllocateFrameBuffers();
+    // the pictures go from the emulator thread to this one
+    Frankenstein::FrameExchange frames(nes.ppu);
+
+    std::unique_ptr<Frankenstein::BatterySaver> saver;
+    if (rom.HasBattery()) {
+        saver.reset(new Frankenstein::BatterySaver(nes, "."));
+        saver->Load();
+    }
+
+    Frankenstein::Movie movie(nes);
+    if (!playPath.empty()) {
+        if (!movie.Play(playPath)) {
+            std::cerr << "Cannot play " << playPath << " with this rom" << std::endl;
+            return 1;
+        }
+    } else if (!recordPath.empty()) {
+        movie.Record();
+    }
+    if (!playPath.empty() || !recordPath.empty()) {
+        // speculative frames would latch the pads too
+        runAheadFrames = 0;
+    }
+
+    // after the movie, which records or replaces the buttons it gives
+    Frankenstein::InputSnapshot input(nes);
+    bool showStats = false;
+
+    // the spans of both threads, for chrome://tracing or Perfetto
+    std::unique_ptr<Frankenstein::ChromeTrace> timeline;
+    if (!timelinePath.empty()) {
+        timeline.reset(new Frankenstein::ChromeTrace(timelinePath));
+        if (!timeline->IsOpen()) {
+            std::cerr << "Cannot write " << timelinePath << std::endl;
+            return 1;
+        }
+        timeline->NameThread("display");
+        nes.tracer = timeline.get();
+    }
+
+    std::thread emulatorThr(emulatorMain, std::ref(nes), saver.get(), runAheadFrames, threads, &movie, tracePath, timeline.get());
 
     while (window.isOpen()) {
         // check all the window's events that were triggered since the last iteration of the loop
@@ -89,34 +299,43 @@ int main(int argc, char* argv[])
         while (window.pollEvent(event)) {
             switch(event.type) {
                 case sf::Event::Closed:
-                    isRunning = false;
+                    commands.Push(Command::Quit);
                     window.close();
                     break;
                 case sf::Event::KeyPressed: 
                     switch (event.key.code) {
                         case sf::Keyboard::Left:
-                            nes.pad1.buttons[Controller::Left] = true;
+                            input.SetButton(0, Controller::Left, true);
                             break;
                         case sf::Keyboard::Right:
-                            nes.pad1.buttons[Controller::Right] = true;
+                            input.SetButton(0, Controller::Right, true);
                             break;
                         case sf::Keyboard::Up:
-                            nes.pad1.buttons[Controller::Up] = true;
+                            input.SetButton(0, Controller::Up, true);
                             break;
                         case sf::Keyboard::Down:
-                            nes.pad1.buttons[Controller::Down] = true;
+                            input.SetButton(0, Controller::Down, true);
                             break;
                         case sf::Keyboard::D:
-                            nes.pad1.buttons[Controller::B] = true;
+                            input.SetButton(0, Controller::B, true);
                             break;
                         case sf::Keyboard::F:
-                            nes.pad1.buttons[Controller::A] = true;
+                            input.SetButton(0, Controller::A, true);
                             break;
                         case sf::Keyboard::S:
-                            nes.pad1.buttons[Controller::Select] = true;
+                            input.SetButton(0, Controller::Select, true);
                             break;
                         case sf::Keyboard::Return:
-                            nes.pad1.buttons[Controller::Start] = true;
+                            input.SetButton(0, Controller::Start, true);
+                            break;
+                        case sf::Keyboard::BackSpace:
+                            commands.Push(Command::RewindStart);
+                            break;
+                        case sf::Keyboard::F1:
+                            showStats = !showStats;
+                            if (!showStats) {
+                                window.setTitle("Frankenstein NES Emulator");
+                            }
                             break;
                         default:
                             break;
@@ -125,28 +344,31 @@ int main(int argc, char* argv[])
                 case sf::Event::KeyReleased: 
                     switch (event.key.code) {
                         case sf::Keyboard::Left:
-                            nes.pad1.buttons[Controller::Left] = false;
+                            input.SetButton(0, Controller::Left, false);
                             break;
                         case sf::Keyboard::Right:
-                            nes.pad1.buttons[Controller::Right] = false;
+                            input.SetButton(0, Controller::Right, false);
                             break;
                         case sf::Keyboard::Up:
-                            nes.pad1.buttons[Controller::Up] = false;
+                            input.SetButton(0, Controller::Up, false);
                             break;
                         case sf::Keyboard::Down:
-                            nes.pad1.buttons[Controller::Down] = false;
+                            input.SetButton(0, Controller::Down, false);
                             break;
                         case sf::Keyboard::D:
-                            nes.pad1.buttons[Controller::B] = false;
+                            input.SetButton(0, Controller::B, false);
                             break;
                         case sf::Keyboard::F:
-                            nes.pad1.buttons[Controller::A] = false;
+                            input.SetButton(0, Controller::A, false);
                             break;
                         case sf::Keyboard::S:
-                            nes.pad1.buttons[Controller::Select] = false;
+                            input.SetButton(0, Controller::Select, false);
                             break;
                         case sf::Keyboard::Return:
-                            nes.pad1.buttons[Controller::Start] = false;
+                            input.SetButton(0, Controller::Start, false);
+                            break;
+                        case sf::Keyboard::BackSpace:
+                            commands.Push(Command::RewindStop);
                             break;
                         default:
                             break;
@@ -155,15 +377,57 @@ int main(int argc, char* argv[])
             }
         }
 
-        {
-            std::lock_guard<std::mutex> guard(imageMutex);
-            tmp.setTexture(screen, true);
-            window.draw(tmp);
+        bool fresh = false;
+        const Frankenstein::Ppu::RGBColor* picture = frames.Acquire(&fresh);
+        if (fresh) {
+            if (timeline) {
+                timeline->Begin(Frankenstein::TraceEvent::TextureUpload, 0);
+            }
+            screen.update((const sf::Uint8*)picture);
+            if (timeline) {
+                timeline->End(Frankenstein::TraceEvent::TextureUpload);
+            }
+        }
+        tmp.setTexture(screen, true);
+        window.draw(tmp);
+#ifdef WithStats
+        if (showStats) {
+            drawStatsOverlay(window, lastFrameStats.Load());
+        }
+#endif
+        if (timeline) {
+            timeline->Begin(Frankenstein::TraceEvent::Present, 0);
         }
         window.display();
+        if (timeline) {
+            timeline->End(Frankenstein::TraceEvent::Present);
+        }
     }
 
     emulatorThr.join();
+    nes.tracer = nullptr;
+    if (timeline && timeline->GetDropped() > 0) {
+        std::cout << "Timeline: " << timeline->GetDropped() << " events dropped" << std::endl;
+    }
+
+    auto frameStats = frames.GetStats();
+    std::cout << "Display: " << frameStats.acquired << " of " << frameStats.published << " frames shown, "
+              << frameStats.dropped << " dropped, " << frameStats.repeated << " repeated" << std::endl;
+
+    if (movie.GetMode() == Frankenstein::Movie::Mode::Recording) {
+        movie.Stop();
+        if (movie.Save(recordPath)) {
+            std::cout << "Movie: " << movie.GetFrame() << " frames recorded in " << recordPath << std::endl;
+        } else {
+            std::cerr << "Cannot write " << recordPath << std::endl;
+        }
+    } else if (!playPath.empty()) {
+        if (movie.GetFirstMismatch() < 0) {
+            std::cout << "Movie: " << movie.GetFrame() << " frames replayed identically" << std::endl;
+        } else {
+            std::cout << "Movie: diverged at frame " << movie.GetFirstMismatch() << std::endl;
+        }
+    }
 
     return 0;
 }
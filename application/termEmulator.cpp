@@ -1,87 +1,213 @@
-#include <fstream>
 #include <iomanip>
-#include <sstream>
-#include <chrono>
-#include <bitset>
+#include <iostream>
+#include <memory>
 
+#include "battery_saver.h"
 #include "nes.h"
 #include "cpu.h"
+#include "instruction_trace.h"
 #include "memory.h"
+#include "movie.h"
 #include "rom_loader.h"
 
+#ifdef WithStats
+// averages of the last frames, per frame
+void printStats(const Frankenstein::NesStats& stats, u32 frames)
+{
+    Frankenstein::FrameStats sum = stats.Sum(frames);
+    std::cout << std::dec << "Frame " << sum.frame << ": " << sum.cpuCycles / frames << " cycles ("
+              << sum.dmaStallCycles / frames << " DMA stall), " << sum.instructions / frames << " instructions, "
+              << double(sum.nmis) / frames << " NMI, " << sum.statusPolls / frames << " $2002 polls, "
+              << double(sum.spriteOverflowLines) / frames << " overflow lines, cpu " << sum.cpuNanoseconds / frames / 1000
+              << " us, ppu " << sum.ppuNanoseconds / frames / 1000 << " us" << std::endl;
+    std::cout << "  reads  $2000-$2007:";
+    for (u32 count : sum.registerReads) {
+        std::cout << " " << count / frames;
+    }
+    std::cout << "\n  writes $2000-$2007:";
+    for (u32 count : sum.registerWrites) {
+        std::cout << " " << count / frames;
+    }
+    std::cout << ", $4014: " << double(sum.oamDmas) / frames << std::endl;
+}
+#endif
+
+// The test status is written to $6000. $80 means the test is running, $81
+// means the test needs the reset button pressed, but delayed by at least
+// 100 msec from now. $00-$7F means the test has completed and given that
+// result code.
+// To allow an emulator to know when one of these tests is running and the
+// data at $6000+ is valid, as opposed to some other NES program, $DE $B0
+// $G1 is written to $6001-$6003.
+class TestStatus : public Frankenstein::BusListener {
+public:
+    bool done = false;
+
+    explicit TestStatus(Frankenstein::Nes& pNes)
+        : nes(pNes)
+        , watch(nes.bus.Watch(0x6000, 0x6003, Frankenstein::Bus::Write, this))
+    {
+    }
+
+    ~TestStatus()
+    {
+        nes.bus.Unwatch(watch);
+    }
+
+    void OnWrite(u16, u8) override
+    {
+        done = nes.ram[0x6000] < 0x80 && nes.ram[0x6001] == 0xDE && nes.ram[0x6002] == 0xB0 && nes.ram[0x6003] == 0x61;
+    }
+
+private:
+    Frankenstein::Nes& nes;
+    s32 watch;
+};
+
 int main(int argc, char* argv[])
 {
     std::string file(argv[1]);
     Frankenstein::Rom rom(Frankenstein::RomLoader::GetRom(file));
     Frankenstein::Nes nes(rom);
 
-    std::ofstream out("debug2.txt", std::ios::out | std::ios::binary);
-    out << "EX.TIME|PC  |SVABDIZC|A |X |Y |Instruction| Hex data" << std::endl;
+    std::unique_ptr<Frankenstein::BatterySaver> saver;
+    if (rom.HasBattery()) {
+        saver.reset(new Frankenstein::BatterySaver(nes, "."));
+        saver->Load();
+    }
+
+    Frankenstein::Movie movie(nes);
+    bool memoryReport = false;
+    std::string tracePath("debug2.trace");
+    bool compress = false;
+#ifdef WithStats
+    bool stats = false;
+#endif
+    std::string cdlPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--play" && i + 1 < argc) {
+            if (!movie.Play(argv[++i])) {
+                std::cerr << "Cannot play " << argv[i] << " with this rom" << std::endl;
+                return 1;
+            }
+        } else if (option == "--memory") {
+            memoryReport = true;
+        } else if (option == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (option == "--compress") {
+            compress = true;
+        } else if (option == "--stats") {
+#ifdef WithStats
+            stats = true;
+#else
+            std::cerr << "--stats needs a build configured with -Dstats=true" << std::endl;
+            return 2;
+#endif
+        } else if (option == "--cdl" && i + 1 < argc) {
+#ifdef WithCdl
+            cdlPath = argv[++i];
+            // the coverage adds up over the runs
+            nes.cdl.Load(cdlPath.c_str());
+#else
+            std::cerr << "--cdl needs a build configured with -Dcdl=true" << std::endl;
+            return 2;
+#endif
+        }
+    }
+    u64 frame = nes.ppu.Frame;
+
+    // every instruction, decode it with nes_tracedecode
+    std::unique_ptr<Frankenstein::InstructionTrace> trace(new Frankenstein::InstructionTrace(nes, tracePath, compress));
+    if (!trace->IsOpen()) {
+        std::cerr << "Cannot write " << tracePath << std::endl;
+        return 1;
+    }
 
+    TestStatus status(nes);
     bool isTestDone = false;
 
     while (!isTestDone)
     {
-        std::stringstream instString;
-        auto op = nes.cpu.OpCode();
-        auto instr = nes.cpu.instructions[op];
-        instString << std::setfill('0') << std::setw(4) << std::hex
-                   << (unsigned int)nes.cpu.registers.PC << "|";
-        instString << std::bitset<8>(nes.cpu.registers.P) << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.A << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.X << "|";
-        instString << std::setfill('0') << std::setw(2) << std::hex
-                   << (unsigned int)nes.cpu.registers.Y << "|";
-        instString << std::setfill(' ') << std::setw(11)
-                   << instr.name << "| ";
-
-        int max = instr.size == 0 ? 3 : instr.size;
-        for(int i = 0; i < max; i++) {
-            instString << std::setfill('0') << std::setw(2) << std::hex << (unsigned int)nes.cpu.Operand(i);
-            instString << " ";
-        }
-
-        auto begin = std::chrono::high_resolution_clock::now();
-        nes.Step();
-        auto end = std::chrono::high_resolution_clock::now();
-
-        out << std::setfill(' ') << std::setw(5) << std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count() << "ns|";
-        out << instString.str();
-        out << std::endl;
+        trace->Step();
 
+        if (nes.ppu.Frame != frame) {
+            frame = nes.ppu.Frame;
+            if (saver) {
+                saver->Update();
+            }
+#ifdef WithStats
+            if (stats && nes.stats.GetFrames() % 60 == 0 && nes.stats.GetFrames() > 0) {
+                printStats(nes.stats, 60);
+            }
+#endif
+            if (movie.GetMode() == Frankenstein::Movie::Mode::Playing) {
+                movie.EndFrame();
+                isTestDone = movie.GetMode() == Frankenstein::Movie::Mode::Finished;
+            }
+        }
 
-        // The test status is written to $6000. $80 means the test is running, $81
-        // means the test needs the reset button pressed, but delayed by at least
-        // 100 msec from now. $00-$7F means the test has completed and given that
-        // result code.
-        // To allow an emulator to know when one of these tests is running and the
-        // data at $6000+ is valid, as opposed to some other NES program, $DE $B0
-        // $G1 is written to $6001-$6003.$DE $B0 $G1 is written to $6001-$6003.
-        if(nes.ram[0x6000] <  0x80 &&
-           nes.ram[0x6001] == 0xDE &&
-           nes.ram[0x6002] == 0xB0 &&
-           nes.ram[0x6003] == 0x61) {
+        if (status.done) {
 
-            out << "Test Done";
-            out << "\nStatus: " << std::setfill('0') << std::setw(2) << std::hex << (unsigned int)(char)nes.ram[0x6000];
-            out << "\n";
+            std::cout << "Test Done";
+            std::cout << "\nStatus: " << std::setfill('0') << std::setw(2) << std::hex << (unsigned int)(char)nes.ram[0x6000];
+            std::cout << "\n";
 
             int i = 0;
             char c;
             do {
                 c = nes.ram[0x6004+i];
-                out << c;
+                std::cout << c;
                 i++;
             }
             while(c != '\0');
+            std::cout << std::dec << std::endl;
 
             isTestDone = true;
         }
     }
-    
+
+    u64 records = trace->GetRecords();
+    trace.reset();
+    std::cout << "Trace: " << records << " instructions in " << tracePath << std::endl;
+
+    int result = 0;
+    if (movie.GetMode() == Frankenstein::Movie::Mode::Finished) {
+        if (movie.GetFirstMismatch() < 0) {
+            std::cout << "Movie: " << movie.GetFrame() << " frames replayed identically" << std::endl;
+        } else {
+            std::cout << "Movie: diverged at frame " << movie.GetFirstMismatch() << std::endl;
+            result = 1;
+        }
+    }
+
+#ifdef WithCdl
+    if (!cdlPath.empty()) {
+        Frankenstein::CodeDataLog::Coverage coverage = nes.cdl.GetCoverage();
+        std::cout << std::dec << "Code/data log: " << coverage.code << " code and " << coverage.data << " data bytes of "
+                  << coverage.prgSize << " PRG, " << coverage.rendered << " of " << coverage.chrSize << " CHR rendered"
+                  << std::endl;
+        if (!nes.cdl.Save(cdlPath.c_str())) {
+            std::cerr << "Cannot write " << cdlPath << std::endl;
+            result = 1;
+        }
+    }
+#endif
+
+    if (memoryReport) {
+        Frankenstein::Nes::MemoryReport report = nes.GetMemoryReport();
+        std::cout << std::dec
+                  << "Memory per instance (bytes):"
+                  << "\n  object:        " << report.object
+                  << "\n  ram:           " << report.ram
+                  << "\n  vram:          " << report.vram
+                  << "\n  frame buffers: " << report.frameBuffers
+                  << "\n  total:         " << report.Total()
+                  << "\n  shared:        " << report.shared << std::endl;
+    }
+
+    saver.reset();
     delete[] rom.GetRaw();
 
-    return 0;
+    return result;
 }
@@ -0,0 +1,294 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "nes.h"
+#include "rom_loader.h"
+#include "thread_pool.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+// NTSC CPU clock
+constexpr u64 CpuFrequency = 1789773;
+
+struct Result {
+    enum class Status { Passed, Failed, Timeout, Error };
+
+    std::string rom;
+    Status status;
+    int code;               // the result code written to $6000, -1 when there is none
+    std::string message;    // the text written from $6004
+    u64 cycles;
+    double seconds;
+    CodeDataLog::Coverage coverage;     // with -Dcdl=true only
+};
+
+const char* StatusName(Result::Status status)
+{
+    switch (status) {
+    case Result::Status::Passed:
+        return "passed";
+    case Result::Status::Failed:
+        return "failed";
+    case Result::Status::Timeout:
+        return "timeout";
+    default:
+        return "error";
+    }
+}
+
+/**
+ * Follows the blargg test status protocol through the cartridge RAM writes.
+ *
+ * The test status is written to $6000. $80 means the test is running, $81
+ * means the test needs the reset button pressed, but delayed by at least
+ * 100 msec from now. $00-$7F means the test has completed and given that
+ * result code. $DE $B0 $61 is written to $6001-$6003 so that the status can
+ * be told from other data, and a text is written from $6004.
+ */
+class BlarggStatus : public BusListener {
+public:
+    bool done = false;
+    bool resetRequested = false;
+    u8 code = 0;
+
+    explicit BlarggStatus(Nes& pNes) : nes(pNes), watch(nes.bus.Watch(0x6000, 0x6003, Bus::Write, this))
+    {
+    }
+
+    ~BlarggStatus()
+    {
+        nes.bus.Unwatch(watch);
+    }
+
+    void OnWrite(u16, u8) override
+    {
+        if (nes.ram[0x6001] != 0xDE || nes.ram[0x6002] != 0xB0 || nes.ram[0x6003] != 0x61) {
+            return;
+        }
+        u8 status = nes.ram[0x6000];
+        if (status < 0x80) {
+            done = true;
+            code = status;
+        } else if (status == 0x81) {
+            resetRequested = true;
+        }
+    }
+
+    std::string Message()
+    {
+        std::string text;
+        for (u16 address = 0x6004; address < 0x8000; ++address) {
+            char c = nes.ram[address];
+            if (c == '\0') {
+                break;
+            }
+            text += c;
+        }
+        return text;
+    }
+
+private:
+    Nes& nes;
+    s32 watch;
+};
+
+Result Run(const std::string& path, u64 timeoutCycles)
+{
+    Result result{ path, Result::Status::Error, -1, "", 0, 0, {} };
+    auto begin = std::chrono::steady_clock::now();
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        result.message = "cannot open the rom";
+        return result;
+    }
+    fclose(file);
+
+    Rom rom(RomLoader::GetRom(path));
+    {
+        Nes nes(rom);
+        BlarggStatus status(nes);
+        u64 resetAt = 0;
+        while (!status.done && result.cycles < timeoutCycles) {
+            nes.Step();
+            result.cycles += nes.cpu.cycles;
+            if (status.resetRequested) {
+                status.resetRequested = false;
+                resetAt = result.cycles + CpuFrequency / 10;
+            }
+            if (resetAt != 0 && result.cycles >= resetAt) {
+                resetAt = 0;
+                nes.cpu.Reset();
+            }
+        }
+
+        if (status.done) {
+            result.code = status.code;
+            result.status = status.code == 0 ? Result::Status::Passed : Result::Status::Failed;
+            result.message = status.Message();
+        } else {
+            result.status = Result::Status::Timeout;
+            result.message = "no result after " + std::to_string(result.cycles) + " cycles";
+        }
+#ifdef WithCdl
+        result.coverage = nes.cdl.GetCoverage();
+#endif
+    }
+    delete[] rom.GetRaw();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+std::string Escape(const std::string& text, bool xml)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (xml && c == '<') {
+            escaped += "&lt;";
+        } else if (xml && c == '>') {
+            escaped += "&gt;";
+        } else if (xml && c == '&') {
+            escaped += "&amp;";
+        } else if (xml && c == '"') {
+            escaped += "&quot;";
+        } else if (!xml && (c == '"' || c == '\\')) {
+            escaped += '\\';
+            escaped += c;
+        } else if (!xml && c == '\n') {
+            escaped += "\\n";
+        } else if (static_cast<unsigned char>(c) < 0x20 && c != '\n') {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void WriteJUnit(const std::string& path, const std::vector<Result>& results, double seconds)
+{
+    u32 failures = 0;
+    u32 errors = 0;
+    for (const Result& result : results) {
+        failures += result.status == Result::Status::Failed;
+        errors += result.status == Result::Status::Timeout || result.status == Result::Status::Error;
+    }
+
+    std::ofstream out(path);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    out << "<testsuites>\n";
+    out << "  <testsuite name=\"nes_testrunner\" tests=\"" << results.size() << "\" failures=\"" << failures
+        << "\" errors=\"" << errors << "\" time=\"" << seconds << "\">\n";
+    for (const Result& result : results) {
+        out << "    <testcase classname=\"roms\" name=\"" << Escape(result.rom, true) << "\" time=\"" << result.seconds << "\"";
+        if (result.status == Result::Status::Passed) {
+            out << "/>\n";
+            continue;
+        }
+        const char* tag = result.status == Result::Status::Failed ? "failure" : "error";
+        out << ">\n      <" << tag << " message=\"" << StatusName(result.status) << " (code " << result.code << ")\">"
+            << Escape(result.message, true) << "</" << tag << ">\n    </testcase>\n";
+    }
+    out << "  </testsuite>\n";
+    out << "</testsuites>\n";
+}
+
+void WriteJson(const std::string& path, const std::vector<Result>& results, double seconds)
+{
+    std::ofstream out(path);
+    out << "{\n  \"seconds\": " << seconds << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << "    {\"rom\": \"" << Escape(result.rom, false) << "\", \"status\": \"" << StatusName(result.status)
+            << "\", \"code\": " << result.code << ", \"cycles\": " << result.cycles << ", \"seconds\": " << result.seconds
+            << ", \"message\": \"" << Escape(result.message, false) << "\"";
+#ifdef WithCdl
+        out << ", \"coverage\": {\"code\": " << result.coverage.code << ", \"data\": " << result.coverage.data
+            << ", \"prg\": " << result.coverage.prgSize << "}";
+#endif
+        out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+}
+
+/**
+ * Runs blargg test roms in parallel and reports their results.
+ *
+ * usage: nes_testrunner [--threads N] [--timeout SECONDS] [--junit FILE] [--json FILE] rom...
+ * The timeout is in emulated seconds. Exits with 1 when a rom does not pass.
+ */
+int main(int argc, char* argv[])
+{
+    u32 threads = 0;
+    double timeout = 60;
+    std::string junitPath;
+    std::string jsonPath;
+    std::vector<std::string> roms;
+    for (int i = 1; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (option == "--timeout" && i + 1 < argc) {
+            timeout = std::atof(argv[++i]);
+        } else if (option == "--junit" && i + 1 < argc) {
+            junitPath = argv[++i];
+        } else if (option == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            roms.push_back(option);
+        }
+    }
+    if (roms.empty()) {
+        std::cerr << "usage: " << argv[0] << " [--threads N] [--timeout SECONDS] [--junit FILE] [--json FILE] rom..." << std::endl;
+        return 2;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Result> results(roms.size());
+    {
+        ThreadPool pool(threads);
+        u64 timeoutCycles = u64(timeout * CpuFrequency);
+        for (size_t i = 0; i < roms.size(); ++i) {
+            pool.Submit([&results, &roms, i, timeoutCycles] { results[i] = Run(roms[i], timeoutCycles); });
+        }
+        pool.Wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    u32 passed = 0;
+    for (const Result& result : results) {
+        passed += result.status == Result::Status::Passed;
+        std::cout << std::left << std::setw(8) << StatusName(result.status) << result.rom
+                  << " (" << std::fixed << std::setprecision(2) << result.seconds << " s)";
+        if (result.status != Result::Status::Passed) {
+            std::istringstream lines(result.message);
+            for (std::string line; std::getline(lines, line);) {
+                if (!line.empty()) {
+                    std::cout << "\n    " << line;
+                }
+            }
+        }
+        std::cout << "\n";
+    }
+    std::cout << passed << "/" << results.size() << " passed in " << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+
+    if (!junitPath.empty()) {
+        WriteJUnit(junitPath, results, seconds);
+    }
+    if (!jsonPath.empty()) {
+        WriteJson(jsonPath, results, seconds);
+    }
+    return passed == results.size() ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "cpu.h"
+#include "instruction_trace.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+using Record = InstructionTrace::Record;
+
+enum class Mode {
+    Implied,
+    Accumulator,
+    Immediate,
+    ZeroPage,
+    ZeroPageX,
+    ZeroPageY,
+    Absolute,
+    AbsoluteX,
+    AbsoluteY,
+    Indirect,
+    IndirectX,
+    IndirectY,
+    Relative,
+};
+
+bool EndsWith(const std::string& text, const char* suffix)
+{
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// from the name of the instruction function, ORA_IND_X, BPL, JSR...
+Mode GetMode(const std::string& name)
+{
+    if (EndsWith(name, "_IND_X")) return Mode::IndirectX;
+    if (EndsWith(name, "_IND_Y")) return Mode::IndirectY;
+    if (EndsWith(name, "_IND")) return Mode::Indirect;
+    if (EndsWith(name, "_ZP_X")) return Mode::ZeroPageX;
+    if (EndsWith(name, "_ZP_Y")) return Mode::ZeroPageY;
+    if (EndsWith(name, "_ZP")) return Mode::ZeroPage;
+    if (EndsWith(name, "_ABS_X")) return Mode::AbsoluteX;
+    if (EndsWith(name, "_ABS_Y")) return Mode::AbsoluteY;
+    if (EndsWith(name, "_ABS") || name == "JSR") return Mode::Absolute;
+    if (EndsWith(name, "_IMM")) return Mode::Immediate;
+    if (EndsWith(name, "_ACC")) return Mode::Accumulator;
+    if (name.size() == 3 && name[0] == 'B' && name != "BRK" && name != "BIT") return Mode::Relative;
+    return Mode::Implied;
+}
+
+u32 GetSize(Mode mode)
+{
+    switch (mode) {
+    case Mode::Implied:
+    case Mode::Accumulator:
+        return 1;
+    case Mode::Absolute:
+    case Mode::AbsoluteX:
+    case Mode::AbsoluteY:
+    case Mode::Indirect:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+// as nestest.log, without the memory values it shows after the operands
+void WriteNestest(FILE* out, const Record& record)
+{
+    std::string name(Cpu::instructions[record.bytes[0]].name);
+    Mode mode = GetMode(name);
+    u32 size = GetSize(mode);
+    u16 word = u16(record.bytes[1] | (record.bytes[2] << 8));
+
+    char bytes[16];
+    int used = 0;
+    for (u32 i = 0; i < size; ++i) {
+        used += snprintf(bytes + used, sizeof(bytes) - used, i == 0 ? "%02X" : " %02X", record.bytes[i]);
+    }
+
+    char text[40];
+    std::string mnemonic = name == "UNIMP" ? "???" : name.substr(0, 3);
+    const char* m = mnemonic.c_str();
+    switch (mode) {
+    case Mode::Implied: snprintf(text, sizeof(text), "%s", m); break;
+    case Mode::Accumulator: snprintf(text, sizeof(text), "%s A", m); break;
+    case Mode::Immediate: snprintf(text, sizeof(text), "%s #$%02X", m, record.bytes[1]); break;
+    case Mode::ZeroPage: snprintf(text, sizeof(text), "%s $%02X", m, record.bytes[1]); break;
+    case Mode::ZeroPageX: snprintf(text, sizeof(text), "%s $%02X,X", m, record.bytes[1]); break;
+    case Mode::ZeroPageY: snprintf(text, sizeof(text), "%s $%02X,Y", m, record.bytes[1]); break;
+    case Mode::Absolute: snprintf(text, sizeof(text), "%s $%04X", m, word); break;
+    case Mode::AbsoluteX: snprintf(text, sizeof(text), "%s $%04X,X", m, word); break;
+    case Mode::AbsoluteY: snprintf(text, sizeof(text), "%s $%04X,Y", m, word); break;
+    case Mode::Indirect: snprintf(text, sizeof(text), "%s ($%04X)", m, word); break;
+    case Mode::IndirectX: snprintf(text, sizeof(text), "%s ($%02X,X)", m, record.bytes[1]); break;
+    case Mode::IndirectY: snprintf(text, sizeof(text), "%s ($%02X),Y", m, record.bytes[1]); break;
+    case Mode::Relative:
+        snprintf(text, sizeof(text), "%s $%04X", m, u16(record.pc + 2 + s8(record.bytes[1])));
+        break;
+    }
+
+    fprintf(out, "%04X  %-8s  %-32sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3u,%3u CYC:%llu\n", record.pc, bytes, text,
+            record.a, record.x, record.y, record.p, record.sp, record.scanLine, record.dot, record.cycle);
+}
+
+// as the debug2.txt term_emulator used to write, the instructions are not timed anymore
+void WriteDebug(FILE* out, const Record& record)
+{
+    const Cpu::InstructionInfo& instruction = Cpu::instructions[record.bytes[0]];
+    char flags[9];
+    for (int bit = 0; bit < 8; ++bit) {
+        flags[bit] = (record.p >> (7 - bit)) & 1 ? '1' : '0';
+    }
+    flags[8] = 0;
+    fprintf(out, "      -|%04x|%s|%02x|%02x|%02x|%11s| ", record.pc, flags, record.a, record.x, record.y, instruction.name);
+    int max = instruction.size == 0 ? 3 : instruction.size;
+    for (int i = 0; i < max; i++) {
+        fprintf(out, "%02x ", record.bytes[i]);
+    }
+    fputc('\n', out);
+}
+
+}
+
+/**
+ * Decodes an instruction trace of term_emulator or sfml_emulator --trace.
+ *
+ * usage: nes_tracedecode trace [--nestest] [--from PC] [--to PC] [--out FILE]
+ * Writes the debug2.txt format, or the nestest.log one with --nestest, of the
+ * instructions whose address is within --from and --to (hexadecimal,
+ * inclusive). Compressed traces (--compress) are read as well.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " trace [--nestest] [--from PC] [--to PC] [--out FILE]" << std::endl;
+        return 2;
+    }
+    bool nestest = false;
+    u32 from = 0;
+    u32 to = 0xFFFF;
+    std::string outPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--nestest") {
+            nestest = true;
+        } else if (option == "--from" && i + 1 < argc) {
+            from = std::strtoul(argv[++i], nullptr, 16);
+        } else if (option == "--to" && i + 1 < argc) {
+            to = std::strtoul(argv[++i], nullptr, 16);
+        } else if (option == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+    }
+
+    InstructionTraceReader reader;
+    if (!reader.Open(argv[1])) {
+        std::cerr << "Cannot read the trace " << argv[1] << std::endl;
+        return 1;
+    }
+    FILE* out = stdout;
+    if (!outPath.empty()) {
+        out = fopen(outPath.c_str(), "w");
+        if (out == nullptr) {
+            std::cerr << "Cannot write " << outPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (!nestest) {
+        fputs("EX.TIME|PC  |SVABDIZC|A |X |Y |Instruction| Hex data\n", out);
+    }
+    Record record;
+    while (reader.Next(record)) {
+        if (record.pc < from || record.pc > to) {
+            continue;
+        }
+        if (nestest) {
+            WriteNestest(out, record);
+        } else {
+            WriteDebug(out, record);
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
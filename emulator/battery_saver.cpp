@@ -0,0 +1,152 @@
+#include "battery_saver.h"
+
+#include "nes.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+using namespace Frankenstein;
+
+static std::string MakeSavePath(const std::string& directory, u64 hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.sav", hash);
+    return directory + "/" + name;
+}
+
+BatterySaver::BatterySaver(Nes& pNes, const std::string& directory, u32 intervalSeconds)
+    : nes(pNes)
+    , path(MakeSavePath(directory, pNes.rom.GetHash()))
+    , interval(std::chrono::seconds(intervalSeconds))
+    , lastStage(Clock::now())
+    , dirtyPages(0)
+    , stagedPages(0)
+    , stagedCount(0)
+    , writtenCount(0)
+    , stopping(false)
+{
+    nes.ram.CopyTo(ADDR_SRAM, image, PRGRAM_BANK_SIZE);
+    writer = std::thread(&BatterySaver::WriterMain, this);
+}
+
+BatterySaver::~BatterySaver()
+{
+    dirtyPages |= nes.ram.TakeDirtySramPages();
+    if (dirtyPages != 0) {
+        Stage();
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writer.join();
+}
+
+bool BatterySaver::Load()
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    u8 data[PRGRAM_BANK_SIZE];
+    bool valid = fread(data, 1, PRGRAM_BANK_SIZE, f) == PRGRAM_BANK_SIZE;
+    fclose(f);
+    if (!valid) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    nes.ram.Copy(data, ADDR_SRAM, PRGRAM_BANK_SIZE);
+    memcpy(image, data, PRGRAM_BANK_SIZE);
+    nes.ram.TakeDirtySramPages();
+    dirtyPages = 0;
+    return true;
+}
+
+void BatterySaver::Update()
+{
+    dirtyPages |= nes.ram.TakeDirtySramPages();
+    if (dirtyPages == 0 || Clock::now() - lastStage < interval) {
+        return;
+    }
+    Stage();
+}
+
+void BatterySaver::Flush()
+{
+    dirtyPages |= nes.ram.TakeDirtySramPages();
+    if (dirtyPages != 0) {
+        Stage();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    written.wait(lock, [this] { return writtenCount == stagedCount; });
+}
+
+const std::string& BatterySaver::GetPath() const
+{
+    return path;
+}
+
+void BatterySaver::Stage()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (u32 page = 0; page < PRGRAM_BANK_SIZE / NES_PAGE_SIZE; ++page) {
+            if (dirtyPages & (1u << page)) {
+                nes.ram.CopyTo(ADDR_SRAM + page * NES_PAGE_SIZE, &staged[page * NES_PAGE_SIZE], NES_PAGE_SIZE);
+            }
+        }
+        stagedPages |= dirtyPages;
+        stagedCount++;
+    }
+    dirtyPages = 0;
+    lastStage = Clock::now();
+    wakeUp.notify_one();
+}
+
+void BatterySaver::WriterMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeUp.wait(lock, [this] { return stagedPages != 0 || stopping; });
+        if (stagedPages == 0) {
+            break;
+        }
+
+        // coalesce everything staged so far in the file image
+        for (u32 page = 0; page < PRGRAM_BANK_SIZE / NES_PAGE_SIZE; ++page) {
+            if (stagedPages & (1u << page)) {
+                memcpy(&image[page * NES_PAGE_SIZE], &staged[page * NES_PAGE_SIZE], NES_PAGE_SIZE);
+            }
+        }
+        stagedPages = 0;
+        u64 generation = stagedCount;
+
+        lock.unlock();
+        WriteFile(image);
+        lock.lock();
+
+        writtenCount = generation;
+        written.notify_all();
+    }
+}
+
+bool BatterySaver::WriteFile(const u8* data)
+{
+    std::string temporary = path + ".tmp";
+    FILE* f = fopen(temporary.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, PRGRAM_BANK_SIZE, f) == PRGRAM_BANK_SIZE;
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
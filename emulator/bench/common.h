@@ -0,0 +1,58 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <nes.h>
+#include <rom_loader.h>
+
+/**
+ * Loads the rom and runs it up to the first gameplay frames once per
+ * process, so that the measured state is representative; every benchmark
+ * then starts from a copy of that state.
+ */
+struct NesFixture : benchmark::Fixture {
+    Frankenstein::Rom* rom = nullptr;
+    Frankenstein::Nes* nes = nullptr;
+
+    void SetUp(const benchmark::State&) override
+    {
+        rom = &SharedRom();
+        nes = new Frankenstein::Nes(*rom);
+        nes->LoadState(WarmState());
+    }
+
+    void TearDown(const benchmark::State&) override
+    {
+        delete nes;
+    }
+
+    void RunFrames(u32 count)
+    {
+        u64 target = nes->ppu.Frame + count;
+        while (nes->ppu.Frame < target) {
+            nes->Step();
+        }
+    }
+
+    // kept for the whole process
+    static Frankenstein::Rom& SharedRom()
+    {
+        static Frankenstein::Rom* shared = new Frankenstein::Rom(Frankenstein::RomLoader::GetRom("roms/Balloon Fight (USA).nes"));
+        return *shared;
+    }
+
+    static const u8* WarmState()
+    {
+        alignas(8) static u8 state[sizeof(Frankenstein::NesState)];
+        static bool ready = false;
+        if (!ready) {
+            Frankenstein::Nes warm(SharedRom());
+            u64 target = warm.ppu.Frame + 120;
+            while (warm.ppu.Frame < target) {
+                warm.Step();
+            }
+            warm.SaveState(state);
+            ready = true;
+        }
+        return state;
+    }
+};
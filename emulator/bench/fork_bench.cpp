@@ -0,0 +1,42 @@
+#include "common.h"
+
+using namespace Frankenstein;
+
+BENCHMARK_DEFINE_F(NesFixture, ForkAndDiscard)(benchmark::State& st)
+{
+    for (auto _ : st) {
+        Nes* fork = nes->Fork();
+        benchmark::DoNotOptimize(fork);
+        delete fork;
+    }
+}
+BENCHMARK_REGISTER_F(NesFixture, ForkAndDiscard);
+
+// a branch running one frame, the pages it writes get copied
+BENCHMARK_DEFINE_F(NesFixture, ForkRunFrame)(benchmark::State& st)
+{
+    u64 ramCopied = 0;
+    u64 vramCopied = 0;
+    for (auto _ : st) {
+        Nes* fork = nes->Fork();
+        fork->RunFrame();
+        ramCopied += fork->ram.PrivatePages();
+        vramCopied += fork->ppu.nameTableData.PrivatePages() + fork->ppu.chrData.PrivatePages();
+        delete fork;
+    }
+    st.counters["ram_pages_copied"] = benchmark::Counter(ramCopied, benchmark::Counter::kAvgIterations);
+    st.counters["vram_pages_copied"] = benchmark::Counter(vramCopied, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_REGISTER_F(NesFixture, ForkRunFrame)->Iterations(300)->Unit(benchmark::kMillisecond);
+
+// the alternative to forking: restore the root state before each branch
+BENCHMARK_DEFINE_F(NesFixture, LoadStateRunFrame)(benchmark::State& st)
+{
+    alignas(8) static u8 root[sizeof(NesState)];
+    nes->SaveState(root);
+    for (auto _ : st) {
+        nes->LoadState(root);
+        nes->RunFrame();
+    }
+}
+BENCHMARK_REGISTER_F(NesFixture, LoadStateRunFrame)->Iterations(300)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,69 @@
+#include "common.h"
+
+#include <instance_groups.h>
+#include <vector>
+
+using namespace Frankenstein;
+
+// every instance gets its own buttons, as rollouts far from their root
+static u8 Divergent(u32 index, u32 frame)
+{
+    return u8(index * 37 + frame / 8);
+}
+
+// instances act in groups of 8, as rollouts close to their root
+static u8 Grouped(u32 index, u32 frame)
+{
+    return Divergent(index / 8, frame);
+}
+
+BENCHMARK_DEFINE_F(NesFixture, IndependentInstances)(benchmark::State& st)
+{
+    std::vector<Nes*> instances;
+    for (s64 i = 0; i < st.range(0); ++i) {
+        instances.push_back(nes->Fork());
+    }
+    u32 frame = 0;
+    for (auto _ : st) {
+        for (u32 i = 0; i < instances.size(); ++i) {
+            instances[i]->pad1.SetButtons(Divergent(i, frame));
+            instances[i]->RunFrame();
+        }
+        frame++;
+    }
+    for (Nes* instance : instances) {
+        delete instance;
+    }
+    st.counters["fps"] = benchmark::Counter(st.iterations() * st.range(0), benchmark::Counter::kIsRate);
+}
+BENCHMARK_REGISTER_F(NesFixture, IndependentInstances)->Arg(8)->Arg(64)->Iterations(30)->Unit(benchmark::kMillisecond);
+
+template <u8 (*Buttons)(u32, u32)>
+static void RunGroups(Nes& root, benchmark::State& st)
+{
+    InstanceGroups groups(root, st.range(0));
+    u64 emulated = 0;
+    u32 frame = 0;
+    for (auto _ : st) {
+        for (u32 i = 0; i < groups.Size(); ++i) {
+            groups.SetButtons(i, Buttons(i, frame));
+        }
+        groups.RunFrame();
+        emulated += groups.GetEmulated();
+        frame++;
+    }
+    st.counters["fps"] = benchmark::Counter(st.iterations() * st.range(0), benchmark::Counter::kIsRate);
+    st.counters["emulated"] = benchmark::Counter(emulated, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK_DEFINE_F(NesFixture, GroupsDivergent)(benchmark::State& st)
+{
+    RunGroups<Divergent>(*nes, st);
+}
+BENCHMARK_REGISTER_F(NesFixture, GroupsDivergent)->Arg(8)->Arg(64)->Iterations(30)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_DEFINE_F(NesFixture, GroupsShared)(benchmark::State& st)
+{
+    RunGroups<Grouped>(*nes, st);
+}
+BENCHMARK_REGISTER_F(NesFixture, GroupsShared)->Arg(8)->Arg(64)->Iterations(30)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,266 @@
+#include "common.h"
+
+using namespace Frankenstein;
+
+// The hot paths of the emulation one at a time, from the state of NesFixture.
+
+namespace {
+
+constexpr u16 ProgramStart = 0x0300;
+constexpr u16 ProgramEnd = 0x0700;
+
+struct OpcodeClass {
+    const char* name;
+    u8 bytes[3];
+    u8 size;
+};
+
+// one instruction of each addressing mode or kind, repeated by CpuStep
+const OpcodeClass OpcodeClasses[] = {
+    { "implied INX", { 0xE8 }, 1 },
+    { "immediate LDA #", { 0xA9, 0x42 }, 2 },
+    { "zero page LDA", { 0xA5, 0x20 }, 2 },
+    { "zero page,X LDA", { 0xB5, 0x20 }, 2 },
+    { "absolute LDA", { 0xAD, 0x00, 0x02 }, 3 },
+    { "absolute,X LDA", { 0xBD, 0x00, 0x02 }, 3 },
+    { "(indirect,X) LDA", { 0xA1, 0x10 }, 2 },
+    { "(indirect),Y LDA", { 0xB1, 0x10 }, 2 },
+    { "read-modify-write INC zp", { 0xE6, 0x20 }, 2 },
+    { "store STA abs", { 0x8D, 0x00, 0x02 }, 3 },
+    { "branch not taken BEQ", { 0xF0, 0x00 }, 2 },
+    { "stack PHA/PLA", { 0x48, 0x68 }, 2 },
+};
+
+struct Region {
+    const char* name;
+    u16 address;
+};
+
+const Region ReadRegions[] = {
+    { "internal RAM", 0x0100 },
+    { "RAM mirror", 0x1100 },
+    { "PPU status", 0x2002 },
+    { "pad", 0x4016 },
+    { "cartridge RAM", 0x6000 },
+    { "PRG-ROM", 0x8000 },
+};
+
+// PRG-ROM is left out, a write there would give the instance its own page
+const Region WriteRegions[] = {
+    { "internal RAM", 0x0100 },
+    { "RAM mirror", 0x1100 },
+    { "PPU OAM address", 0x2003 },
+    { "cartridge RAM", 0x6000 },
+};
+
+struct DotClass {
+    const char* name;
+    u32 firstLine;
+    u32 lastLine;
+    u32 firstCycle;
+    u32 lastCycle;
+};
+
+const DotClass DotClasses[] = {
+    { "visible", 0, 239, 1, 256 },
+    { "sprite and tile fetch", 0, 239, 257, 340 },
+    { "vertical blank", 242, 260, 0, 340 },
+};
+
+}
+
+// one operand fetch per addressing mode, X = 2 and Y = 5 as in CpuStep
+template <Addressing Mode>
+u8 GetOperand(NesMemory& ram);
+
+template <>
+u8 GetOperand<Addressing::Absolute>(NesMemory& ram)
+{
+    return ram.Get<Addressing::Absolute>(0x00, 0x02);
+}
+template <>
+u8 GetOperand<Addressing::ZeroPage>(NesMemory& ram)
+{
+    return ram.Get<Addressing::ZeroPage>(0x20);
+}
+template <>
+u8 GetOperand<Addressing::Indexed>(NesMemory& ram)
+{
+    return ram.Get<Addressing::Indexed>(0x00, 0x02, 0x05);
+}
+template <>
+u8 GetOperand<Addressing::ZeroPageIndexed>(NesMemory& ram)
+{
+    return ram.Get<Addressing::ZeroPageIndexed>(0x20, 0x05);
+}
+template <>
+u8 GetOperand<Addressing::Indirect>(NesMemory& ram)
+{
+    return ram.Get<Addressing::Indirect>(0x10, 0x00);
+}
+template <>
+u8 GetOperand<Addressing::PreIndexedIndirect>(NesMemory& ram)
+{
+    return ram.Get<Addressing::PreIndexedIndirect>(0x10, 0x02);
+}
+template <>
+u8 GetOperand<Addressing::PostIndexedIndirect>(NesMemory& ram)
+{
+    return ram.Get<Addressing::PostIndexedIndirect>(0x10, 0x05);
+}
+
+// one instantiation per mode, so that the loop holds only the fetch
+template <Addressing Mode>
+void MemoryGet(benchmark::State& st)
+{
+    Nes nes(NesFixture::SharedRom());
+    nes.LoadState(NesFixture::WarmState());
+    NesMemory& ram = nes.ram;
+    // ($10) and ($12) point at $0200
+    ram[0x10] = 0x00;
+    ram[0x11] = 0x02;
+    ram[0x12] = 0x00;
+    ram[0x13] = 0x02;
+    u8 value = 0;
+    for (auto _ : st) {
+        value += GetOperand<Mode>(ram);
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::Absolute);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::ZeroPage);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::Indexed);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::ZeroPageIndexed);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::Indirect);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::PreIndexedIndirect);
+BENCHMARK_TEMPLATE(MemoryGet, Addressing::PostIndexedIndirect);
+
+// through NesMemory::Ref, as the CPU does
+BENCHMARK_DEFINE_F(NesFixture, MemoryRead)(benchmark::State& st)
+{
+    const Region& region = ReadRegions[st.range(0)];
+    u16 address = region.address;
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(u8(nes->ram[address]));
+    }
+    st.SetLabel(region.name);
+}
+BENCHMARK_REGISTER_F(NesFixture, MemoryRead)->DenseRange(0, sizeof(ReadRegions) / sizeof(ReadRegions[0]) - 1);
+
+BENCHMARK_DEFINE_F(NesFixture, MemoryWrite)(benchmark::State& st)
+{
+    const Region& region = WriteRegions[st.range(0)];
+    u16 address = region.address;
+    u8 value = 0;
+    for (auto _ : st) {
+        nes->ram[address] = value++;
+        benchmark::ClobberMemory();
+    }
+    st.SetLabel(region.name);
+}
+BENCHMARK_REGISTER_F(NesFixture, MemoryWrite)->DenseRange(0, sizeof(WriteRegions) / sizeof(WriteRegions[0]) - 1);
+
+// the CPU alone, on a RAM program of one instruction repeated, then JMP back
+BENCHMARK_DEFINE_F(NesFixture, CpuStep)(benchmark::State& st)
+{
+    const OpcodeClass& opcode = OpcodeClasses[st.range(0)];
+    NesMemory& ram = nes->ram;
+    u16 address = ProgramStart;
+    while (address + opcode.size + 3 <= ProgramEnd) {
+        for (u8 i = 0; i < opcode.size; ++i) {
+            ram[address++] = opcode.bytes[i];
+        }
+    }
+    ram[address] = 0x4C;
+    ram[address + 1] = ProgramStart & 0xFF;
+    ram[address + 2] = ProgramStart >> 8;
+    // ($10) and, with X = 2, ($12) point at $0200
+    ram[0x10] = 0x00;
+    ram[0x11] = 0x02;
+    ram[0x12] = 0x00;
+    ram[0x13] = 0x02;
+    Cpu& cpu = nes->cpu;
+    cpu.registers.PC = ProgramStart;
+    cpu.registers.X = 2;
+    cpu.registers.Y = 5;
+    cpu.registers.P |= 0x04;
+    cpu.registers.P &= ~0x02;
+    cpu.nmiOccurred = false;
+    cpu.stall = 0;
+
+    for (auto _ : st) {
+        cpu.Step();
+    }
+    st.SetLabel(opcode.name);
+}
+BENCHMARK_REGISTER_F(NesFixture, CpuStep)->DenseRange(0, sizeof(OpcodeClasses) / sizeof(OpcodeClasses[0]) - 1);
+
+// the PPU alone, brought back to the first dot of the class when it leaves it
+BENCHMARK_DEFINE_F(NesFixture, PpuStep)(benchmark::State& st)
+{
+    const DotClass& dots = DotClasses[st.range(0)];
+    Ppu& ppu = nes->ppu;
+    ppu.AllocateFrameBuffers();
+    ppu.ScanLine = dots.firstLine;
+    ppu.Cycle = dots.firstCycle;
+    for (auto _ : st) {
+        ppu.Step();
+        if (ppu.Cycle > dots.lastCycle) {
+            ppu.Cycle = dots.firstCycle;
+            ppu.ScanLine++;
+        } else if (ppu.Cycle < dots.firstCycle) {
+            ppu.Cycle = dots.firstCycle;
+        }
+        if (ppu.ScanLine < dots.firstLine || ppu.ScanLine > dots.lastLine) {
+            ppu.ScanLine = dots.firstLine;
+        }
+    }
+    st.SetLabel(dots.name);
+}
+BENCHMARK_REGISTER_F(NesFixture, PpuStep)->DenseRange(0, sizeof(DotClasses) / sizeof(DotClasses[0]) - 1);
+
+BENCHMARK_F(NesFixture, EvaluateSprites)(benchmark::State& st)
+{
+    Ppu& ppu = nes->ppu;
+    u32 line = 0;
+    for (auto _ : st) {
+        ppu.ScanLine = line;
+        ppu.evaluateSprites();
+        line = line == 239 ? 0 : line + 1;
+    }
+}
+
+BENCHMARK_F(NesFixture, StoreTileData)(benchmark::State& st)
+{
+    Ppu& ppu = nes->ppu;
+    for (auto _ : st) {
+        ppu.storeTileData();
+        benchmark::DoNotOptimize(ppu.tileData);
+    }
+}
+
+BENCHMARK_F(NesFixture, RenderPixel)(benchmark::State& st)
+{
+    Ppu& ppu = nes->ppu;
+    ppu.AllocateFrameBuffers();
+    ppu.ScanLine = 100;
+    ppu.evaluateSprites();
+    u32 cycle = 1;
+    for (auto _ : st) {
+        ppu.Cycle = cycle;
+        ppu.renderPixel();
+        cycle = cycle == 256 ? 1 : cycle + 1;
+    }
+    benchmark::DoNotOptimize(ppu.back);
+}
+
+BENCHMARK_F(NesFixture, WriteDMA)(benchmark::State& st)
+{
+    Ppu& ppu = nes->ppu;
+    for (auto _ : st) {
+        ppu.writeDMA(0x02);
+        nes->cpu.stall = 0;
+        benchmark::ClobberMemory();
+    }
+    st.SetBytesProcessed(st.iterations() * 256);
+}
@@ -0,0 +1,28 @@
+#include "common.h"
+
+#include <ppu_pipeline.h>
+
+using namespace Frankenstein;
+
+BENCHMARK_DEFINE_F(NesFixture, SingleThreadFrame)(benchmark::State& st)
+{
+    nes->ppu.AllocateFrameBuffers();
+    for (auto _ : st) {
+        nes->RunFrame();
+    }
+}
+BENCHMARK_REGISTER_F(NesFixture, SingleThreadFrame)->Iterations(120)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// the CPU and the PPU on two threads, only faster with two free cores
+BENCHMARK_DEFINE_F(NesFixture, PipelinedFrame)(benchmark::State& st)
+{
+    nes->ppu.AllocateFrameBuffers();
+    PpuPipeline pipeline(*nes);
+    for (auto _ : st) {
+        pipeline.RunFrame();
+    }
+    PpuPipeline::Stats stats = pipeline.GetStats();
+    st.counters["blocking_reads"] = benchmark::Counter(stats.blockingReads, benchmark::Counter::kAvgIterations);
+    st.counters["predicted_reads"] = benchmark::Counter(stats.predictedReads, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_REGISTER_F(NesFixture, PipelinedFrame)->Iterations(120)->Unit(benchmark::kMillisecond)->UseRealTime();
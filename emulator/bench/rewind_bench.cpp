@@ -0,0 +1,39 @@
+#include "common.h"
+
+#include <rewind.h>
+
+using namespace Frankenstein;
+
+BENCHMARK_DEFINE_F(NesFixture, RewindPush)(benchmark::State& st)
+{
+    Rewind rewind(*nes, 32 * 1024 * 1024);
+    for (auto _ : st) {
+        st.PauseTiming();
+        RunFrames(1);
+        st.ResumeTiming();
+        rewind.Push();
+    }
+    Rewind::Stats stats = rewind.GetStats();
+    st.counters["frames"] = stats.frames;
+    st.counters["bytes_per_frame"] = double(stats.used) / stats.frames;
+    st.counters["ratio"] = double(stats.rawBytes) / stats.used;
+}
+// every iteration emulates a whole frame, keep the run short
+BENCHMARK_REGISTER_F(NesFixture, RewindPush)->Iterations(600);
+
+BENCHMARK_DEFINE_F(NesFixture, RewindPop)(benchmark::State& st)
+{
+    Rewind rewind(*nes, 32 * 1024 * 1024);
+    for (auto _ : st) {
+        st.PauseTiming();
+        if (rewind.GetStats().frames == 0) {
+            for (u32 i = 0; i < 60; ++i) {
+                rewind.Push();
+                RunFrames(1);
+            }
+        }
+        st.ResumeTiming();
+        rewind.Pop();
+    }
+}
+BENCHMARK_REGISTER_F(NesFixture, RewindPop)->Iterations(600);
@@ -0,0 +1,47 @@
+#include "common.h"
+
+#include <run_ahead.h>
+
+using namespace Frankenstein;
+
+namespace {
+
+// frames shown from the warm state between pressing Start and the first picture that differs
+u32 StartLatency(Rom& rom, const u8* state, u32 frames)
+{
+    Nes nes(rom);
+    nes.LoadState(state);
+    nes.ppu.AllocateFrameBuffers();
+    RunAhead runAhead(nes, frames);
+    // the buffers keep a few pixels of the pictures before the load for some frames
+    for (u32 i = 0; i < 5; ++i) {
+        runAhead.RunFrame();
+    }
+    u64 before = Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+
+    nes.pad1.buttons[Gamepad::Start] = true;
+    for (u32 latency = 1; latency < 60; ++latency) {
+        runAhead.RunFrame();
+        if (Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor)) != before) {
+            return latency;
+        }
+    }
+    return 60;
+}
+
+}
+
+// cost of one displayed frame, range(0) frames ahead, and the latency it measures
+BENCHMARK_DEFINE_F(NesFixture, RunAheadFrame)(benchmark::State& st)
+{
+    u32 latency = StartLatency(*rom, WarmState(), st.range(0));
+    u32 plain = StartLatency(*rom, WarmState(), 0);
+
+    RunAhead runAhead(*nes, st.range(0));
+    for (auto _ : st) {
+        runAhead.RunFrame();
+    }
+    st.counters["latency_frames"] = latency;
+    st.counters["latency_saved_frames"] = double(plain) - latency;
+}
+BENCHMARK_REGISTER_F(NesFixture, RunAheadFrame)->DenseRange(0, 3)->Iterations(120)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,24 @@
+#include "common.h"
+
+using namespace Frankenstein;
+
+BENCHMARK_F(NesFixture, SaveState)(benchmark::State& st)
+{
+    alignas(8) static u8 buffer[sizeof(NesState)];
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(nes->SaveState(buffer));
+        benchmark::ClobberMemory();
+    }
+    st.SetBytesProcessed(st.iterations() * sizeof(NesState));
+}
+
+BENCHMARK_F(NesFixture, LoadState)(benchmark::State& st)
+{
+    alignas(8) static u8 buffer[sizeof(NesState)];
+    nes->SaveState(buffer);
+    for (auto _ : st) {
+        benchmark::DoNotOptimize(nes->LoadState(buffer));
+        benchmark::ClobberMemory();
+    }
+    st.SetBytesProcessed(st.iterations() * sizeof(NesState));
+}
@@ -0,0 +1,209 @@
+#include "bus.h"
+
+#include "dependencies.h"
+#include "nes.h"
+
+using namespace Frankenstein;
+
+constexpr u32 Bus::MaxWatches;
+constexpr u32 Bus::MaxBreakpoints;
+
+Bus::Bus(Nes& pNes)
+    : nes(pNes)
+    , notifying(false)
+{
+    memset(pages, 0, sizeof(pages));
+    memset(breakPages, 0, sizeof(breakPages));
+    memset(watches, 0, sizeof(watches));
+    memset(breakpoints, 0, sizeof(breakpoints));
+}
+
+s32 Bus::Watch(u16 first, u16 last, u8 access, BusListener* listener)
+{
+    if (access == 0 || listener == nullptr || first > last) {
+        return -1;
+    }
+    for (u32 i = 0; i < MaxWatches; ++i) {
+        if (watches[i].access == 0) {
+            watches[i] = Range{ first, last, access, listener };
+            UpdatePages();
+            return s32(i);
+        }
+    }
+    return -1;
+}
+
+void Bus::Unwatch(s32 id)
+{
+    if (id >= 0 && u32(id) < MaxWatches) {
+        watches[id].access = 0;
+        UpdatePages();
+    }
+}
+
+s32 Bus::AddBreakpoint(u16 pc, const Condition& condition)
+{
+    for (u32 i = 0; i < MaxBreakpoints; ++i) {
+        if (!breakpoints[i].used) {
+            breakpoints[i] = Breakpoint{ pc, true, condition };
+            UpdatePages();
+            return s32(i);
+        }
+    }
+    return -1;
+}
+
+void Bus::RemoveBreakpoint(s32 id)
+{
+    if (id >= 0 && u32(id) < MaxBreakpoints) {
+        breakpoints[id].used = false;
+        UpdatePages();
+    }
+}
+
+bool Bus::RunToBreakpoint(u32 cycles)
+{
+    Cpu& cpu = nes.cpu;
+    bool resuming = true;
+    u32 elapsed = 0;
+    while (elapsed < cycles) {
+        // stall cycles and the NMI come before the instruction at PC
+        if (cpu.stall == 0 && !cpu.nmiOccurred) {
+            if (!resuming && breakPages[cpu.registers.PC >> 8] != 0 && IsBreakpoint(cpu.registers.PC)) {
+                return true;
+            }
+            resuming = false;
+        }
+        nes.Step();
+        elapsed += cpu.cycles;
+    }
+    return false;
+}
+
+// a listener reading its own range through Nes::ram would call itself again
+void Bus::NotifyRead(u16 address, u8 value)
+{
+    if (notifying) {
+        return;
+    }
+    notifying = true;
+    for (const Range& watch : watches) {
+        if ((watch.access & Read) != 0 && Covers(watch, address)) {
+            watch.listener->OnRead(address, value);
+        }
+    }
+    notifying = false;
+}
+
+void Bus::NotifyWrite(u16 address, u8 value)
+{
+    if (notifying) {
+        return;
+    }
+    notifying = true;
+    for (const Range& watch : watches) {
+        if ((watch.access & Write) != 0 && Covers(watch, address)) {
+            watch.listener->OnWrite(address, value);
+        }
+    }
+    notifying = false;
+}
+
+void Bus::NotifyExecute(u16 address)
+{
+    if (notifying) {
+        return;
+    }
+    notifying = true;
+    for (const Range& watch : watches) {
+        if ((watch.access & Execute) != 0 && Covers(watch, address)) {
+            watch.listener->OnExecute(address);
+        }
+    }
+    notifying = false;
+}
+
+void Bus::UpdatePages()
+{
+    memset(pages, 0, sizeof(pages));
+    memset(breakPages, 0, sizeof(breakPages));
+    for (const Range& watch : watches) {
+        if (watch.access != 0) {
+            for (u32 page = watch.first >> 8; page <= u32(watch.last >> 8); ++page) {
+                pages[page] |= watch.access;
+                if (page < 0x20) {
+                    // the same 256 bytes of internal RAM in the other mirrors
+                    for (u32 mirror = page & 0x07; mirror < 0x20; mirror += 0x08) {
+                        pages[mirror] |= watch.access;
+                    }
+                } else if (page < 0x40) {
+                    // every page holds all the PPU registers
+                    for (u32 mirror = 0x20; mirror < 0x40; ++mirror) {
+                        pages[mirror] |= watch.access;
+                    }
+                }
+            }
+        }
+    }
+    for (const Breakpoint& breakpoint : breakpoints) {
+        if (breakpoint.used) {
+            breakPages[breakpoint.pc >> 8] = 1;
+        }
+    }
+}
+
+bool Bus::Covers(const Range& watch, u16 address)
+{
+    if (address >= watch.first && address <= watch.last) {
+        return true;
+    }
+    if (address >= 0x4000) {
+        return false;
+    }
+    // the mirrors of address in its region: the internal RAM or the PPU registers
+    u16 base = address & 0x2000;
+    u16 size = base == 0 ? 0x0800 : 0x0008;
+    u16 low = watch.first > base ? watch.first : base;
+    u16 high = watch.last < base + 0x1FFF ? watch.last : base + 0x1FFF;
+    if (low > high) {
+        return false;
+    }
+    // whether the range, folded into size bytes, holds the offset of address
+    u16 mask = size - 1;
+    return high - low >= mask || u16((address - low) & mask) <= high - low;
+}
+
+bool Bus::IsBreakpoint(u16 pc) const
+{
+    const Cpu::Registers& registers = nes.cpu.registers;
+    for (const Breakpoint& breakpoint : breakpoints) {
+        if (!breakpoint.used || breakpoint.pc != pc) {
+            continue;
+        }
+        const Condition& condition = breakpoint.condition;
+        u8 value = 0;
+        switch (condition.reg) {
+        case Condition::Register::None:
+            return true;
+        case Condition::Register::A:
+            value = registers.A;
+            break;
+        case Condition::Register::X:
+            value = registers.X;
+            break;
+        case Condition::Register::Y:
+            value = registers.Y;
+            break;
+        case Condition::Register::P:
+            value = registers.P;
+            break;
+        case Condition::Register::SP:
+            value = registers.SP;
+            break;
+        }
+        if ((value & condition.mask) == condition.value) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,204 @@
+#include "chrome_trace.h"
+
+#include <cstdlib>
+#include <new>
+
+using namespace Frankenstein;
+
+namespace {
+
+const char* const EventNames[] = { "frame", "run", "scanlines", "DMA stall", "NMI", "texture upload", "present" };
+static_assert(sizeof(EventNames) / sizeof(EventNames[0]) == u32(TraceEvent::Count), "a name per event");
+
+// the spans which nest in the others of their thread, the other ones get an async track each
+bool IsNested(TraceEvent event)
+{
+    return event == TraceEvent::Run || event == TraceEvent::TextureUpload || event == TraceEvent::Present;
+}
+
+std::atomic<u64> nextId(1);
+
+// the ring of the calling thread in the last instance it traced to
+struct CachedThread {
+    u64 instance;
+    void* thread;
+};
+thread_local CachedThread cached = { 0, nullptr };
+
+}
+
+constexpr u32 ChromeTrace::Capacity;
+
+void* ChromeTrace::Thread::operator new(size_t size)
+{
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, alignof(Thread), size) != 0) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void ChromeTrace::Thread::operator delete(void* pointer)
+{
+    free(pointer);
+}
+
+ChromeTrace::ChromeTrace(const std::string& path)
+    : id(nextId++)
+    , start(Clock::now())
+    , file(fopen(path.c_str(), "w"))
+    , first(true)
+    , dropped(0)
+    , stopping(false)
+{
+    if (file != nullptr) {
+        fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", file);
+        writer = std::thread(&ChromeTrace::WriterMain, this);
+    }
+}
+
+ChromeTrace::~ChromeTrace()
+{
+    if (file == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writer.join();
+
+    Drain();
+    for (auto& thread : threads) {
+        if (!thread->name.empty()) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", thread->id, thread->name.c_str());
+            first = false;
+        }
+    }
+    fputs("\n]}\n", file);
+    fclose(file);
+}
+
+bool ChromeTrace::IsOpen() const
+{
+    return file != nullptr;
+}
+
+void ChromeTrace::Begin(TraceEvent event, u32 argument)
+{
+    Push(Record{ u64(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()), argument, event, true });
+}
+
+void ChromeTrace::End(TraceEvent event)
+{
+    Push(Record{ u64(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()), 0, event, false });
+}
+
+void ChromeTrace::NameThread(const char* name)
+{
+    Thread& thread = GetThread();
+    std::lock_guard<std::mutex> guard(mutex);
+    thread.name = name;
+}
+
+u64 ChromeTrace::GetDropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+ChromeTrace::Thread& ChromeTrace::GetThread()
+{
+    if (cached.instance == id) {
+        return *static_cast<Thread*>(cached.thread);
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    std::thread::id self = std::this_thread::get_id();
+    Thread* found = nullptr;
+    for (auto& thread : threads) {
+        if (thread->owner == self) {
+            found = thread.get();
+        }
+    }
+    if (found == nullptr) {
+        threads.emplace_back(new Thread());
+        found = threads.back().get();
+        found->owner = self;
+        found->id = u32(threads.size());
+        for (u32& open : found->open) {
+            open = 0;
+        }
+    }
+    cached.instance = id;
+    cached.thread = found;
+    return *found;
+}
+
+void ChromeTrace::Push(const Record& record)
+{
+    if (file == nullptr) {
+        return;
+    }
+    if (!GetThread().ring.Push(record)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ChromeTrace::WriterMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wakeUp.wait_for(lock, std::chrono::milliseconds(10));
+        lock.unlock();
+        Drain();
+        lock.lock();
+    }
+}
+
+void ChromeTrace::Drain()
+{
+    std::vector<Thread*> current;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (auto& thread : threads) {
+            current.push_back(thread.get());
+        }
+    }
+    for (Thread* thread : current) {
+        Record record;
+        while (thread->ring.Pop(record)) {
+            Write(*thread, record);
+        }
+    }
+    fflush(file);
+}
+
+void ChromeTrace::Write(Thread& thread, const Record& record)
+{
+    u32& open = thread.open[u32(record.event)];
+    if (!record.begin) {
+        if (open == 0) {
+            return;
+        }
+        open--;
+    } else {
+        open++;
+    }
+
+    const char* name = EventNames[u32(record.event)];
+    double microseconds = record.time / 1000.0;
+    if (IsNested(record.event)) {
+        fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u", first ? "" : ",\n",
+                name, record.begin ? 'B' : 'E', microseconds, thread.id);
+    } else {
+        fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"nes\", \"ph\": \"%c\", \"id\": %u, \"ts\": %.3f, \"pid\": 1, \"tid\": %u",
+                first ? "" : ",\n", name, record.begin ? 'b' : 'e', thread.id * 16 + u32(record.event), microseconds, thread.id);
+    }
+    if (record.begin) {
+        fprintf(file, ", \"args\": {\"value\": %u}}", record.argument);
+    } else {
+        fputs("}", file);
+    }
+    first = false;
+}
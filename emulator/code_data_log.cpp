@@ -0,0 +1,133 @@
+#include "code_data_log.h"
+
+#include "dependencies.h"
+#include "rom.h"
+
+#ifndef NotNative
+    #include <cstdio>
+#endif
+
+using namespace Frankenstein;
+
+constexpr u8 CodeDataLog::Code;
+constexpr u8 CodeDataLog::Data;
+constexpr u8 CodeDataLog::IndirectCode;
+constexpr u8 CodeDataLog::IndirectData;
+constexpr u8 CodeDataLog::Opcode;
+constexpr u8 CodeDataLog::Rendered;
+constexpr u8 CodeDataLog::Read;
+
+CodeDataLog::CodeDataLog(const Rom& rom)
+    : prgSize(rom.GetHeader().prgRomBanks * 0x4000)
+    , chrSize(rom.GetHeader().vRomBanks * 0x2000)
+{
+    if (prgSize == 0) {
+        prgSize = 0x4000;
+    }
+    // 16 KB mirrored at $C000 or 32 KB, as mapper 0
+    prgMask = (prgSize < 0x8000 ? prgSize : 0x8000) - 1;
+    chrMask = 0x1FFF;
+    prg = new u8[prgSize];
+    chr = new u8[chrSize > 0 ? chrSize : 1];
+    Clear();
+}
+
+CodeDataLog::~CodeDataLog()
+{
+    delete[] prg;
+    delete[] chr;
+}
+
+const u8* CodeDataLog::GetPrg() const
+{
+    return prg;
+}
+
+u32 CodeDataLog::GetPrgSize() const
+{
+    return prgSize;
+}
+
+const u8* CodeDataLog::GetChr() const
+{
+    return chr;
+}
+
+u32 CodeDataLog::GetChrSize() const
+{
+    return chrSize;
+}
+
+CodeDataLog::Coverage CodeDataLog::GetCoverage() const
+{
+    Coverage coverage;
+    memset(&coverage, 0, sizeof(coverage));
+    coverage.prgSize = prgSize;
+    coverage.chrSize = chrSize;
+    for (u32 i = 0; i < prgSize; ++i) {
+        if (prg[i] & (Code | IndirectCode)) {
+            coverage.code++;
+        } else if (prg[i] & (Data | IndirectData)) {
+            coverage.data++;
+        }
+    }
+    for (u32 i = 0; i < chrSize; ++i) {
+        if (chr[i] & Rendered) {
+            coverage.rendered++;
+        } else if (chr[i] & Read) {
+            coverage.read++;
+        }
+    }
+    return coverage;
+}
+
+void CodeDataLog::Clear()
+{
+    memset(prg, 0, prgSize);
+    memset(chr, 0, chrSize > 0 ? chrSize : 1);
+}
+
+#ifndef NotNative
+bool CodeDataLog::Save(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = true;
+    for (u32 i = 0; i < prgSize && written; ++i) {
+        written = fputc(prg[i] & ~Opcode, file) != EOF;
+    }
+    written = written && fwrite(chr, 1, chrSize, file) == chrSize;
+    return fclose(file) == 0 && written;
+}
+
+bool CodeDataLog::Load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size != long(prgSize + chrSize)) {
+        fclose(file);
+        return false;
+    }
+    for (u32 i = 0; i < prgSize + chrSize; ++i) {
+        int flags = fgetc(file);
+        if (flags == EOF) {
+            fclose(file);
+            return false;
+        }
+        if (i < prgSize) {
+            prg[i] |= u8(flags & ~Opcode);
+        } else {
+            chr[i - prgSize] |= u8(flags);
+        }
+    }
+    fclose(file);
+    return true;
+}
+#endif
@@ -0,0 +1,8 @@
+#include "cow_memory.h"
+
+namespace Frankenstein {
+
+// constant initialised: the count starts at one so that it never drops to zero
+CowPage ZeroPage = { { 0 }, 1 };
+
+}
@@ -0,0 +1,85 @@
+#include "frame_exchange.h"
+
+#include <cstring>
+
+using namespace Frankenstein;
+
+constexpr u8 FrameExchange::Fresh;
+
+FrameExchange::FrameExchange(Ppu& pPpu)
+    : ppu(pPpu)
+    , ownFront(pPpu.front)
+    , ownBack(pPpu.back)
+    , drawing(0)
+    , middle(1)
+    , displayed(2)
+    , published(0)
+    , dropped(0)
+    , acquired(0)
+    , repeated(0)
+{
+    for (auto& buffer : buffers) {
+        buffer = new Ppu::RGBColor[256 * 240]();
+    }
+    if (ownFront != nullptr) {
+        // the picture shown until the first vertical blank
+        std::memcpy(buffers[1], ownFront, 256 * 240 * sizeof(Ppu::RGBColor));
+        std::memcpy(buffers[2], ownFront, 256 * 240 * sizeof(Ppu::RGBColor));
+    }
+    ppu.back = buffers[drawing];
+    ppu.front = buffers[1];
+    ppu.frames = this;
+}
+
+FrameExchange::~FrameExchange()
+{
+    ppu.frames = nullptr;
+    const Ppu::RGBColor* last = ppu.front;
+    if (ownFront == nullptr) {
+        ppu.front = new Ppu::RGBColor[256 * 240];
+        ppu.back = new Ppu::RGBColor[256 * 240];
+    } else {
+        ppu.front = ownFront;
+        ppu.back = ownBack;
+    }
+    std::memcpy(ppu.front, last, 256 * 240 * sizeof(Ppu::RGBColor));
+    for (auto buffer : buffers) {
+        delete[] buffer;
+    }
+}
+
+Ppu::RGBColor* FrameExchange::Publish()
+{
+    u8 previous = middle.exchange(drawing | Fresh, std::memory_order_acq_rel);
+    if (previous & Fresh) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    published.fetch_add(1, std::memory_order_relaxed);
+    drawing = previous & ~Fresh;
+    return buffers[drawing];
+}
+
+const Ppu::RGBColor* FrameExchange::Acquire(bool* fresh)
+{
+    bool isFresh = (middle.load(std::memory_order_relaxed) & Fresh) != 0;
+    if (isFresh) {
+        displayed = middle.exchange(displayed, std::memory_order_acq_rel) & ~Fresh;
+        acquired++;
+    } else {
+        repeated++;
+    }
+    if (fresh != nullptr) {
+        *fresh = isFresh;
+    }
+    return buffers[displayed];
+}
+
+FrameExchange::Stats FrameExchange::GetStats() const
+{
+    Stats stats;
+    stats.published = published.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.acquired = acquired;
+    stats.repeated = repeated;
+    return stats;
+}
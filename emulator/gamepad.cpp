@@ -5,28 +5,71 @@ namespace Frankenstein {
 Gamepad::Gamepad()
     : index(0)
     , strobe(0)
+    , latched(0)
     , buttons{false}
+    , listener(nullptr)
 {
 }
 
 u8 Gamepad::Read()
 {
-    u8 value = buttons[index];
+    // while the strobe is high the shift register keeps reloading
+    if ((strobe & 1) == 1) {
+        return buttons[A];
+    }
+    u8 value = (latched >> index) & 1;
     index++;
     if (index >= 8) {
         index = 0;
     }
-    if ((strobe & 1) == 1) {
-        index = 0;
-    }
     return value;
 }
 
 void Gamepad::Write(u8 value)
 {
+    bool falling = (strobe & 1) == 1 && (value & 1) == 0;
     strobe = value;
     if ((strobe & 1) == 1) {
         index = 0;
     }
+    // the buttons are latched when the strobe goes low, games poll once per frame
+    if (falling) {
+        if (listener) {
+            listener->OnLatch(*this);
+        }
+        latched = GetButtons();
+    }
+}
+
+u8 Gamepad::GetButtons() const
+{
+    u8 mask = 0;
+    for (u8 i = 0; i < 8; ++i) {
+        mask |= u8(buttons[i]) << i;
+    }
+    return mask;
+}
+
+void Gamepad::SetButtons(u8 mask)
+{
+    for (u8 i = 0; i < 8; ++i) {
+        buttons[i] = (mask >> i) & 1;
+    }
+}
+
+void Gamepad::Save(NesState::GamepadBlock& block) const
+{
+    block.index = index;
+    block.strobe = strobe;
+    block.buttons = GetButtons();
+    block.latched = latched;
+}
+
+void Gamepad::Load(const NesState::GamepadBlock& block)
+{
+    index = block.index;
+    strobe = block.strobe;
+    SetButtons(block.buttons);
+    latched = block.latched;
 }
 }
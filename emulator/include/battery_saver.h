@@ -0,0 +1,84 @@
+#pragma once
+
+#include "util.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Persists the battery backed PRG-RAM of a cartridge in <directory>/<rom hash>.sav
+ *
+ * The emulator thread only copies the 256 bytes pages written since the last
+ * snapshot, at most once per interval. A background thread merges them in its
+ * own image of the file and replaces the file atomically (temporary file then
+ * rename), so saving never stalls a frame.
+ */
+class BatterySaver {
+public:
+    BatterySaver(Nes& pNes, const std::string& directory, u32 intervalSeconds = 5);
+
+    /**
+     * Writes the pages still pending and stops the writer thread.
+     */
+    ~BatterySaver();
+
+    /**
+     * Restores the cartridge RAM from the save file. Must be called before
+     * the emulation starts.
+     * @return false when there is no valid save file for this rom
+     */
+    bool Load();
+
+    /**
+     * Collects the dirty pages and hands them to the writer thread once the
+     * interval has elapsed. Call it from the emulator thread once per frame.
+     */
+    void Update();
+
+    /**
+     * Hands all the dirty pages to the writer thread and waits until they
+     * are on disk.
+     */
+    void Flush();
+
+    const std::string& GetPath() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void Stage();
+    void WriterMain();
+    bool WriteFile(const u8* data);
+
+    Nes& nes;
+    const std::string path;
+    const Clock::duration interval;
+    Clock::time_point lastStage;
+
+    // pages written by the game but not yet handed to the writer (emulator thread only)
+    u32 dirtyPages;
+
+    // shared with the writer thread, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable written;
+    u8 staged[PRGRAM_BANK_SIZE];
+    u32 stagedPages;
+    u64 stagedCount;
+    u64 writtenCount;
+    bool stopping;
+
+    // writer thread only: current content of the save file
+    u8 image[PRGRAM_BANK_SIZE];
+
+    std::thread writer;
+};
+
+}
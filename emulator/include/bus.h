@@ -1,29 +1,131 @@
 #pragma once
 
+#include "util.h"
+
 namespace Frankenstein {
 
-template <typename AddressingType>
-class IIRQListener
-{
-public:
-    virtual void processIRQ() = 0;
-};
+class Nes;
 
-template <typename AddressingType>
-class IMemoryListener
-{
+/**
+ * Told about the CPU accesses to the address ranges it watches, see
+ * Bus::Watch. The callbacks run in the middle of the instruction: they may
+ * read the machine through Nes::ram but must not step it or load a state.
+ * The accesses made from a callback are not reported.
+ */
+class BusListener {
 public:
-    virtual void read() = 0;
-    virtual void write() = 0;
+    // a read of address, value is what the device returned
+    virtual void OnRead(u16 /*address*/, u8 /*value*/) {}
+
+    // a write of address, once the device took it
+    virtual void OnWrite(u16 /*address*/, u8 /*value*/) {}
+
+    // the instruction at address is about to execute
+    virtual void OnExecute(u16 /*address*/) {}
+
+protected:
+    ~BusListener() {}
 };
 
-template <typename AddressingType>
+/**
+ * Watchpoints and breakpoints on the CPU bus.
+ *
+ * Each 256 bytes page of the address space has a mask of the accesses
+ * watched in it. NesMemory and Cpu::Step test that mask and only call into
+ * the bus for a watched page: the other pages keep the plain dispatch, and
+ * the machine runs as fast as without a bus when nothing is watched.
+ * Watches are folded through the mirrors of the internal RAM ($0000-$07FF
+ * up to $1FFF) and of the PPU registers ($2000-$2007 up to $3FFF): a watch
+ * of $0000 is told about $0800 and the reverse, with the address the CPU
+ * issued. Breakpoints compare PC as it is.
+ *
+ * Breakpoints are only tested by RunToBreakpoint, Nes::Step and RunFrame do
+ * not stop on them. Forks start with an empty bus.
+ */
 class Bus {
 public:
-    void register(IIRQListener listener);
-    void register(IMemoryListener listener, AddressingType address);
-};
+    static constexpr u32 MaxWatches = 32;
+    static constexpr u32 MaxBreakpoints = 32;
 
-}
+    enum Access : u8 {
+        Read = 1,
+        Write = 2,
+        Execute = 4,
+    };
+
+    /**
+     * Breaks when (register & mask) == value, always with Register::None.
+     */
+    struct Condition {
+        enum class Register : u8 { None, A, X, Y, P, SP };
+
+        Register reg;
+        u8 mask;
+        u8 value;
+    };
+
+    explicit Bus(Nes& pNes);
 
+    Bus(const Bus&) = delete;
+    Bus& operator=(const Bus&) = delete;
 
+    /**
+     * Tells listener about the accesses of the kinds in access (Access bits)
+     * to first-last, inclusive.
+     * @return an id for Unwatch, -1 when MaxWatches are set already
+     */
+    s32 Watch(u16 first, u16 last, u8 access, BusListener* listener);
+    void Unwatch(s32 id);
+
+    /**
+     * @return an id for RemoveBreakpoint, -1 when MaxBreakpoints are set already
+     */
+    s32 AddBreakpoint(u16 pc, const Condition& condition = Condition());
+    void RemoveBreakpoint(s32 id);
+
+    /**
+     * Steps the machine until the next instruction has a breakpoint whose
+     * condition holds or at least cycles CPU cycles have elapsed. The
+     * instruction at PC when called runs even if it has a breakpoint, so
+     * that a stopped machine resumes.
+     * @return true when stopped on a breakpoint, before the instruction at PC
+     */
+    bool RunToBreakpoint(u32 cycles);
+
+    bool IsWatched(u16 address, Access access) const
+    {
+        return (pages[address >> 8] & access) != 0;
+    }
+
+    // called by NesMemory and the Cpu for the watched pages only
+    void NotifyRead(u16 address, u8 value);
+    void NotifyWrite(u16 address, u8 value);
+    void NotifyExecute(u16 address);
+
+private:
+    struct Range {
+        u16 first;
+        u16 last;
+        u8 access;              // 0 when unused
+        BusListener* listener;
+    };
+
+    struct Breakpoint {
+        u16 pc;
+        bool used;
+        Condition condition;
+    };
+
+    void UpdatePages();
+    bool IsBreakpoint(u16 pc) const;
+    static bool Covers(const Range& watch, u16 address);
+
+    Nes& nes;
+    u8 pages[256];              // Access bits watched in each page
+    u8 breakPages[256];         // breakpoints in each page
+    Range watches[MaxWatches];
+    Breakpoint breakpoints[MaxBreakpoints];
+    bool notifying;             // a listener is being called
+};
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "spsc_ring.h"
+#include "trace.h"
+#include "util.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Frankenstein {
+
+/**
+ * Writes the timeline in the trace event JSON format, for chrome://tracing
+ * or https://ui.perfetto.dev.
+ *
+ * Each thread calling Begin or End gets its own ring, registered under a
+ * lock on its first event only; after that a span costs a clock read and
+ * a push. A background thread drains the rings into the file every few
+ * milliseconds. When a ring is full the event is dropped and counted.
+ *
+ * Run and the frontend spans nest on the track of their thread; frames,
+ * scanlines, DMA stalls and NMIs overlap them and get a track each.
+ */
+class ChromeTrace : public TraceSink {
+public:
+    /**
+     * Creates path and starts the writer thread, see IsOpen.
+     */
+    explicit ChromeTrace(const std::string& path);
+
+    /**
+     * Writes the events left and completes the file. No thread may trace
+     * anymore.
+     */
+    ~ChromeTrace();
+
+    ChromeTrace(const ChromeTrace&) = delete;
+    ChromeTrace& operator=(const ChromeTrace&) = delete;
+
+    bool IsOpen() const;
+
+    void Begin(TraceEvent event, u32 argument) override;
+    void End(TraceEvent event) override;
+
+    /**
+     * Names the track of the calling thread, which may trace later.
+     */
+    void NameThread(const char* name);
+
+    /**
+     * @return the events lost because a ring was full
+     */
+    u64 GetDropped() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Record {
+        u64 time;               // nanoseconds since the trace started
+        u32 argument;
+        TraceEvent event;
+        bool begin;
+    };
+
+    // about 7 seconds of emulation with every span traced, 75 events per frame
+    static constexpr u32 Capacity = 1 << 15;
+
+    struct Thread {
+        std::thread::id owner;
+        u32 id;
+        std::string name;                   // guarded by mutex
+        SpscRing<Record, Capacity> ring;
+        u32 open[u32(TraceEvent::Count)];   // writer thread only: spans begun and not ended
+
+        // the ring is aligned on cache lines, which plain new ignores before C++17
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer);
+    };
+
+    Thread& GetThread();
+    void Push(const Record& record);
+    void WriterMain();
+    void Drain();
+    void Write(Thread& thread, const Record& record);
+
+    const u64 id;                   // tells the instances apart in the thread local cache
+    const Clock::time_point start;
+    FILE* file;
+    bool first;                     // writer thread only: no event written yet
+    std::atomic<u64> dropped;
+
+    std::mutex mutex;               // guards threads and stopping
+    std::condition_variable wakeUp;
+    std::vector<std::unique_ptr<Thread>> threads;
+    bool stopping;
+    std::thread writer;
+};
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+class Rom;
+
+/**
+ * Marks how each byte of PRG-ROM and CHR-ROM is used, in the layout of the
+ * code/data logger files of FCEUX, which Mesen, disassemblers and ROM hacking
+ * tools read: a byte of flags per PRG-ROM byte, then one per CHR-ROM byte.
+ *
+ * PRG flags: Code, Data, the 8 KB window ($8000, $A000, $C000 or $E000) the
+ * byte was last used through in bits 2-3, IndirectCode (the target of a
+ * JMP ($xxxx)) and IndirectData (read through a ($zp),Y or ($zp,X) pointer).
+ * Opcode, in the bit FCEUX leaves unused, tells the first byte of an
+ * instruction from its operands; it is kept in memory and not written.
+ * CHR flags: Rendered (fetched by the PPU to draw) and Read (through $2007).
+ *
+ * The CPU, the bus and the PPU mark the bytes only with -DWithCdl (meson
+ * configure -Dcdl=true): Nes::cdl does not exist otherwise and the
+ * emulation is left as it is. The addresses are translated as mapper 0 maps
+ * them, CHR-RAM is not logged.
+ */
+class CodeDataLog {
+public:
+    // PRG flags
+    static constexpr u8 Code = 0x01;
+    static constexpr u8 Data = 0x02;
+    static constexpr u8 IndirectCode = 0x10;
+    static constexpr u8 IndirectData = 0x20;
+    static constexpr u8 Opcode = 0x80;
+
+    // CHR flags
+    static constexpr u8 Rendered = 0x01;
+    static constexpr u8 Read = 0x02;
+
+    /**
+     * Bytes of each kind, see GetCoverage.
+     */
+    struct Coverage {
+        u32 prgSize;
+        u32 code;
+        u32 data;           // data only, code also read as data counts as code
+        u32 chrSize;        // 0 for CHR-RAM
+        u32 rendered;
+        u32 read;           // read through $2007 and never drawn
+    };
+
+    explicit CodeDataLog(const Rom& rom);
+    ~CodeDataLog();
+
+    CodeDataLog(const CodeDataLog&) = delete;
+    CodeDataLog& operator=(const CodeDataLog&) = delete;
+
+    /**
+     * Adds flags to the PRG-ROM byte mapped at address, nothing below $8000.
+     */
+    void MarkPrg(u16 address, u8 flags)
+    {
+        if (address >= 0x8000) {
+            prg[(address - 0x8000) & prgMask] |= flags | (((address >> 13) & 3) << 2);
+        }
+    }
+
+    /**
+     * Adds flags to the CHR-ROM byte mapped at address of the PPU.
+     */
+    void MarkChr(u16 address, u8 flags)
+    {
+        if (chrSize > 0 && address < 0x2000) {
+            chr[address & chrMask] |= flags;
+        }
+    }
+
+    const u8* GetPrg() const;
+    u32 GetPrgSize() const;
+    const u8* GetChr() const;
+    u32 GetChrSize() const;
+
+    Coverage GetCoverage() const;
+
+    void Clear();
+
+#ifndef NotNative
+    /**
+     * Writes the log as a .cdl file, Opcode bits excluded.
+     */
+    bool Save(const char* path) const;
+
+    /**
+     * Adds the flags of a .cdl file of the same rom to the log, to sum
+     * the coverage of several runs.
+     * @return false when the file cannot be read or its size does not match
+     */
+    bool Load(const char* path);
+#endif
+
+private:
+    u8* prg;
+    u32 prgSize;
+    u32 prgMask;
+    u8* chr;
+    u32 chrSize;
+    u32 chrMask;
+};
+
+}
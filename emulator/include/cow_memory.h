@@ -0,0 +1,175 @@
+#pragma once
+
+#include "dependencies.h"
+#include "util.h"
+
+namespace Frankenstein {
+
+struct CowPage {
+    u8 data[NES_PAGE_SIZE];
+    u32 refs;
+};
+
+// every page never written references this one, it is never freed
+extern CowPage ZeroPage;
+
+/**
+ * Byte array made of NES_PAGE_SIZE pages that forked instances share.
+ *
+ * A page is only copied the first time an instance writes to it while
+ * another instance still references it, so forking costs one pointer and
+ * one reference count increment per page. Pages never written all reference
+ * ZeroPage, so only the written pages take memory. The reference counts are
+ * atomic: forks may run on other threads than their parent, but copying a
+ * CowMemory must not race with writes to it.
+ */
+template <u32 Size>
+class CowMemory {
+public:
+    static constexpr u32 PageCount = Size / NES_PAGE_SIZE;
+
+    CowMemory()
+    {
+        for (u32 i = 0; i < PageCount; ++i) {
+            pages[i] = Acquire(&ZeroPage);
+        }
+    }
+
+    ~CowMemory()
+    {
+        for (u32 i = 0; i < PageCount; ++i) {
+            Release(pages[i]);
+        }
+    }
+
+    /**
+     * References the pages of other instead of copying them.
+     */
+    CowMemory(const CowMemory& other)
+    {
+        for (u32 i = 0; i < PageCount; ++i) {
+            pages[i] = Acquire(other.pages[i]);
+        }
+    }
+
+    CowMemory& operator=(const CowMemory&) = delete;
+
+    /**
+     * Replaces the pages from address with the pages of other.
+     */
+    template <u32 OtherSize>
+    void Share(const CowMemory<OtherSize>& other, const u32 address)
+    {
+        for (u32 i = 0; i < CowMemory<OtherSize>::PageCount; ++i) {
+            CowPage*& page = pages[address / NES_PAGE_SIZE + i];
+            Release(page);
+            page = Acquire(other.pages[i]);
+        }
+    }
+
+    u8 operator[](const u32 address) const
+    {
+        return pages[address / NES_PAGE_SIZE]->data[address % NES_PAGE_SIZE];
+    }
+
+    void Write(const u32 address, const u8 value)
+    {
+        Own(address / NES_PAGE_SIZE)->data[address % NES_PAGE_SIZE] = value;
+    }
+
+    /**
+     * Copies size bytes to address. Pages whose content does not change
+     * stay shared.
+     * @return the mask of the modified pages, bit n is the nth page from
+     *         address, only the first 32 pages are reported
+     */
+    u32 Copy(const u8* source, const u32 address, const u32 size)
+    {
+        u32 modified = 0;
+        for (u32 offset = 0; offset < size;) {
+            u32 page = (address + offset) / NES_PAGE_SIZE;
+            u32 begin = (address + offset) % NES_PAGE_SIZE;
+            u32 count = NES_PAGE_SIZE - begin < size - offset ? NES_PAGE_SIZE - begin : size - offset;
+            if (memcmp(&pages[page]->data[begin], &source[offset], count) != 0) {
+                memcpy(&Own(page)->data[begin], &source[offset], count);
+                modified |= offset / NES_PAGE_SIZE < 32 ? 1u << (offset / NES_PAGE_SIZE) : 0;
+            }
+            offset += count;
+        }
+        return modified;
+    }
+
+    void CopyTo(const u32 address, u8* destination, const u32 size) const
+    {
+        for (u32 offset = 0; offset < size;) {
+            u32 page = (address + offset) / NES_PAGE_SIZE;
+            u32 begin = (address + offset) % NES_PAGE_SIZE;
+            u32 count = NES_PAGE_SIZE - begin < size - offset ? NES_PAGE_SIZE - begin : size - offset;
+            if (count == NES_PAGE_SIZE) {
+                memcpy(&destination[offset], pages[page]->data, NES_PAGE_SIZE);
+            } else {
+                memcpy(&destination[offset], &pages[page]->data[begin], count);
+            }
+            offset += count;
+        }
+    }
+
+    /**
+     * @return the number of written pages also referenced by another instance
+     */
+    u32 SharedPages() const
+    {
+        u32 count = 0;
+        for (u32 i = 0; i < PageCount; ++i) {
+            count += pages[i] != &ZeroPage && __atomic_load_n(&pages[i]->refs, __ATOMIC_RELAXED) > 1;
+        }
+        return count;
+    }
+
+    /**
+     * @return the number of pages only referenced by this instance
+     */
+    u32 PrivatePages() const
+    {
+        u32 count = 0;
+        for (u32 i = 0; i < PageCount; ++i) {
+            count += __atomic_load_n(&pages[i]->refs, __ATOMIC_RELAXED) == 1;
+        }
+        return count;
+    }
+
+private:
+    template <u32 OtherSize>
+    friend class CowMemory;
+
+    static CowPage* Acquire(CowPage* page)
+    {
+        __atomic_add_fetch(&page->refs, 1, __ATOMIC_RELAXED);
+        return page;
+    }
+
+    static void Release(CowPage* page)
+    {
+        if (__atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+            delete page;
+        }
+    }
+
+    CowPage* Own(const u32 index)
+    {
+        CowPage* page = pages[index];
+        // only this instance can add references to a page it owns alone
+        if (__atomic_load_n(&page->refs, __ATOMIC_ACQUIRE) != 1) {
+            CowPage* copy = new CowPage;
+            memcpy(copy->data, page->data, NES_PAGE_SIZE);
+            copy->refs = 1;
+            Release(page);
+            pages[index] = page = copy;
+        }
+        return page;
+    }
+
+    CowPage* pages[PageCount];
+};
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ppu.h"
+#include "util.h"
+
+#include <atomic>
+
+namespace Frankenstein {
+
+/**
+ * Hands the pictures of a Ppu over to another thread without locks (triple
+ * buffering).
+ *
+ * Of the three buffers, the Ppu draws in one, the display thread reads
+ * another, and the third holds the newest completed picture. At the start of
+ * each vertical blank the Ppu swaps the picture it completed with the third
+ * one; Acquire swaps the displayed buffer with it when it holds a picture
+ * not acquired yet. Neither side ever waits for the other: a picture replaced
+ * before it was acquired is dropped, an Acquire without a new picture repeats
+ * the previous one.
+ *
+ * While attached, Ppu::front is the last picture completed, which the Ppu
+ * thread can still read.
+ */
+class FrameExchange {
+public:
+    struct Stats {
+        u64 published;      // pictures completed by the Ppu
+        u64 acquired;       // pictures taken by Acquire
+        u64 dropped;        // pictures replaced before being acquired
+        u64 repeated;       // Acquire calls without a new picture
+    };
+
+    /**
+     * Attaches to ppu, which draws in the buffers of the exchange from now.
+     */
+    explicit FrameExchange(Ppu& pPpu);
+
+    /**
+     * Gives ppu its own buffers back, with the last picture in front.
+     */
+    ~FrameExchange();
+
+    FrameExchange(const FrameExchange&) = delete;
+    FrameExchange& operator=(const FrameExchange&) = delete;
+
+    /**
+     * Ppu thread: offers the picture completed in the drawing buffer.
+     * @return the buffer to draw the next picture in
+     */
+    Ppu::RGBColor* Publish();
+
+    /**
+     * Display thread: takes the newest picture.
+     * @param fresh set to whether it is a picture not acquired before
+     * @return the picture, valid until the next Acquire
+     */
+    const Ppu::RGBColor* Acquire(bool* fresh = nullptr);
+
+    Stats GetStats() const;
+
+private:
+    static constexpr u8 Fresh = 4;   // set in middle when it holds a picture not acquired
+
+    Ppu& ppu;
+    Ppu::RGBColor* ownFront;
+    Ppu::RGBColor* ownBack;
+    Ppu::RGBColor* buffers[3];
+
+    u8 drawing;                 // Ppu thread
+    std::atomic<u8> middle;     // index | Fresh
+    u8 displayed;               // display thread
+
+    std::atomic<u64> published;
+    std::atomic<u64> dropped;
+    u64 acquired;
+    u64 repeated;
+};
+
+}
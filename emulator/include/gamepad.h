@@ -1,9 +1,22 @@
 #pragma once
 
+#include "nes_state.h"
 #include "util.h"
 
 namespace Frankenstein {
 
+class Gamepad;
+
+/**
+ * Notified when a pad latches its buttons. The listener may read the buttons
+ * (to record them) or replace them (to play them back) before they are latched.
+ */
+class LatchListener {
+public:
+    virtual void OnLatch(Gamepad& pad) = 0;
+    virtual ~LatchListener() = default;
+};
+
 class Gamepad {
 public:
     enum ButtonIndex : u8 {
@@ -19,10 +32,21 @@ public:
     
     u8 index;
     u8 strobe;
+    u8 latched;             // shift register loaded from buttons, bit n is ButtonIndex n
     bool buttons[8];
+    LatchListener* listener;
 
     u8 Read();
     void Write(u8 value);
+
+    /**
+     * @return the buttons as a bitmask, bit n is ButtonIndex n
+     */
+    u8 GetButtons() const;
+    void SetButtons(u8 mask);
+
+    void Save(NesState::GamepadBlock& block) const;
+    void Load(const NesState::GamepadBlock& block);
     
     Gamepad();
 };
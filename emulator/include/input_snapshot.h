@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gamepad.h"
+#include "seq_lock.h"
+#include "util.h"
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * The buttons of both pads as the frontend sees them, handed to the game
+ * when it strobes $4016.
+ *
+ * The frontend (an event loop, the USB interrupt handler of the kernel)
+ * sets the buttons whenever they change, without locking and without
+ * touching the Nes. The pads take them when the game latches them, the
+ * latest possible moment, rather than once per frame before it runs.
+ *
+ * While attached, it is the latch listener of both pads and forwards to the
+ * listeners it replaced, so attach it after a Movie to record or replay the
+ * buttons it gives.
+ */
+class InputSnapshot : public LatchListener {
+public:
+    InputSnapshot(Nes& pNes);
+    ~InputSnapshot() override;
+
+    InputSnapshot(const InputSnapshot&) = delete;
+    InputSnapshot& operator=(const InputSnapshot&) = delete;
+
+    /**
+     * Frontend: sets the buttons of pad 0 or 1, bit n is Gamepad::ButtonIndex n.
+     * Only one thread may set them.
+     */
+    void SetButtons(u8 pad, u8 buttons);
+    void SetButton(u8 pad, Gamepad::ButtonIndex button, bool pressed);
+
+    /**
+     * @return the buttons of pad 0 or 1 the next latch will take
+     */
+    u8 GetButtons(u8 pad) const;
+
+    void OnLatch(Gamepad& pad) override;
+
+private:
+    struct Pads {
+        u8 buttons[2];
+    };
+
+    Nes& nes;
+    LatchListener* next[2];
+    Pads written;       // the writer's copy
+    SeqLock<Pads> shared;
+};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "util.h"
+
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Many instances of the same cartridge, forked from one root and advanced
+ * one frame at a time, which emulates each distinct machine once.
+ *
+ * Instances in the same state that receive the same buttons stay identical,
+ * so each group of such instances is emulated once: only its leader owns a
+ * Nes, the followers read it. When the buttons of a follower differ, it
+ * gets its own fork of the leader and progresses independently from then
+ * on. The rom and tile pages stay shared through the forks.
+ *
+ * This only pays while instances share their inputs, rollouts close to a
+ * common root for instance. Instances with different inputs cost the same
+ * as independent Nes instances: every machine is still a whole Nes stepped
+ * one instruction at a time, there is no vectorised step across instances.
+ */
+class InstanceGroups {
+public:
+    /**
+     * @param root  the state every instance starts from, it is not modified
+     * @param count number of instances
+     */
+    InstanceGroups(Nes& root, u32 count);
+    ~InstanceGroups();
+
+    InstanceGroups(const InstanceGroups&) = delete;
+    InstanceGroups& operator=(const InstanceGroups&) = delete;
+
+    u32 Size() const;
+
+    /**
+     * Sets the buttons of an instance for the next frames, bit n is Gamepad::ButtonIndex n.
+     */
+    void SetButtons(u32 index, u8 pad1, u8 pad2 = 0);
+
+    /**
+     * Emulates one frame on every instance.
+     */
+    void RunFrame();
+
+    /**
+     * @return the machine an instance is in, shared with the instances of its
+     *         group; valid until the next RunFrame
+     */
+    const Nes& Get(u32 index) const;
+
+    /**
+     * @return the number of distinct machines emulated by the last RunFrame
+     */
+    u32 GetEmulated() const;
+
+private:
+    void Regroup();
+
+    std::vector<Nes*> instances;    // owned, nullptr for the followers
+    std::vector<u32> leaders;       // the instance whose machine an instance reads
+    std::vector<u8> pad1Buttons;
+    std::vector<u8> pad2Buttons;
+    u32 emulated;
+};
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "util.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Binary log of the instructions a Nes executes.
+ *
+ * Step records the registers, the bytes at PC and the PPU position before
+ * each instruction, then runs it. Records are appended to a block of the
+ * emulator thread; a full block is handed to a background thread which
+ * writes it, optionally compressed, while the emulator fills the next one.
+ * The emulator only waits when every block is queued.
+ *
+ * File layout: Header, then blocks made of a BlockHeader and its records.
+ * Compressed blocks hold the records XORed with the previous one, split in
+ * byte planes (byte 0 of every record, then byte 1...) and PackBits packed:
+ * the fields which do not change become long runs of zeros.
+ */
+class InstructionTrace {
+public:
+    static constexpr u32 Magic = 0x5254534E; // "NSTR"
+    static constexpr u32 Version = 1;
+
+    struct Record {
+        u64 cycle;          // CPU cycles elapsed before the instruction, see Step
+        u16 pc;
+        u16 scanLine;
+        u16 dot;
+        u8 bytes[3];        // the opcode and the two bytes after it
+        u8 a;
+        u8 x;
+        u8 y;
+        u8 p;
+        u8 sp;
+        u8 reserved[2];     // 0
+    };
+
+    struct Header {
+        u32 magic;
+        u32 version;
+        u64 romHash;
+        u32 recordSize;
+        u32 compressed;     // 1 when the blocks are compressed
+    };
+
+    struct BlockHeader {
+        u32 records;
+        u32 size;           // bytes following the header
+    };
+
+    /**
+     * Creates path and starts the writer thread, see IsOpen.
+     * @param cycle counted before the first instruction
+     * @param blockRecords records per block, the emulator thread owns one
+     */
+    InstructionTrace(Nes& pNes, const std::string& path, bool compress = false, u64 cycle = 0, u32 blockRecords = 1 << 16);
+
+    /**
+     * Writes the records left and closes the file.
+     */
+    ~InstructionTrace();
+
+    InstructionTrace(const InstructionTrace&) = delete;
+    InstructionTrace& operator=(const InstructionTrace&) = delete;
+
+    bool IsOpen() const;
+
+    /**
+     * Records the next instruction and executes it with Nes::Step. OAM DMA
+     * stalls and NMIs run without a record.
+     */
+    void Step();
+
+    /**
+     * @return the instructions recorded so far
+     */
+    u64 GetRecords() const;
+
+    /**
+     * @return how many times the emulator thread waited for the writer
+     */
+    u64 GetWaits() const;
+
+    /**
+     * Compresses count records in destination, at least Bound(count) bytes.
+     * @return the compressed size
+     */
+    static u32 Compress(const Record* records, u32 count, u8* destination);
+
+    /**
+     * @return the records decompressed, 0 when the block is invalid
+     */
+    static u32 Decompress(const u8* source, u32 size, Record* records, u32 capacity);
+
+    static u32 Bound(u32 count);
+
+private:
+    using Block = std::vector<Record>;
+
+    void Submit();
+    void WriterMain();
+
+    Nes& nes;
+    FILE* file;
+    const bool compress;
+    const u32 blockRecords;
+    u64 cycle;
+    u64 records;
+    u64 waits;
+
+    // emulator thread only
+    std::unique_ptr<Block> current;
+
+    // shared with the writer thread, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable released;
+    std::deque<std::unique_ptr<Block>> full;
+    std::vector<std::unique_ptr<Block>> spare;
+    u32 blocks;             // allocated so far, at most MaxBlocks
+    bool stopping;
+
+    std::thread writer;
+
+    static constexpr u32 MaxBlocks = 4;
+};
+
+/**
+ * Reads the records of an InstructionTrace file in order.
+ */
+class InstructionTraceReader {
+public:
+    InstructionTraceReader();
+    ~InstructionTraceReader();
+
+    InstructionTraceReader(const InstructionTraceReader&) = delete;
+    InstructionTraceReader& operator=(const InstructionTraceReader&) = delete;
+
+    /**
+     * @return false when path is not an instruction trace of this version
+     */
+    bool Open(const std::string& path);
+
+    /**
+     * @return false at the end of the file or on a truncated or invalid block
+     */
+    bool Next(InstructionTrace::Record& record);
+
+    const InstructionTrace::Header& GetHeader() const;
+
+private:
+    bool ReadBlock();
+
+    FILE* file;
+    InstructionTrace::Header header;
+    std::vector<InstructionTrace::Record> block;
+    std::vector<u8> packed;
+    u32 position;
+};
+
+}
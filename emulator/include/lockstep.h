@@ -0,0 +1,188 @@
+#pragma once
+
+#include "instruction_trace.h"
+#include "nes_state.h"
+#include "ppu_pipeline.h"
+#include "util.h"
+
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * A way to run a Nes, compared by Lockstep with the plain Nes::Step. This
+ * one is Nes::Step itself, a Nes configured differently (Ppu::skipRender)
+ * runs through it; faster execution modes derive from it.
+ */
+class LockstepCore {
+public:
+    explicit LockstepCore(Nes& pNes);
+    virtual ~LockstepCore();
+
+    LockstepCore(const LockstepCore&) = delete;
+    LockstepCore& operator=(const LockstepCore&) = delete;
+
+    Nes& GetNes();
+
+    /**
+     * Executes one instruction, as Nes::Step. The CPU registers are up to
+     * date when it returns.
+     */
+    virtual void Step();
+
+    /**
+     * Brings the whole Nes up to date before it is saved.
+     */
+    virtual void Sync();
+
+protected:
+    Nes& nes;
+};
+
+/**
+ * Runs the Nes through a PpuPipeline, attached for the lifetime of the core.
+ */
+class PipelineCore : public LockstepCore {
+public:
+    explicit PipelineCore(Nes& pNes);
+
+    void Step() override;
+    void Sync() override;
+
+private:
+    PpuPipeline pipeline;
+};
+
+/**
+ * Runs a reference Nes with Nes::Step and a candidate core side by side,
+ * one instruction each, and compares their states (Nes::SaveState) at the
+ * end of every instruction, scanline or frame of the reference. Both must
+ * start from the same state, with the same input: the same pad buttons or
+ * a Movie playing the same file on each.
+ *
+ * The comparison stops at the first difference. The states are split in
+ * parts, hashed separately, and the divergence tells which parts differ and
+ * the first byte which does, along with the last instructions of both
+ * machines. With a scanline or frame granularity the divergence happened
+ * after lastMatch: run the same input again at the Instruction granularity
+ * from lastMatch to find the instruction.
+ */
+class Lockstep {
+public:
+    enum class Granularity : u8 {
+        Instruction,
+        ScanLine,
+        Frame,
+    };
+
+    enum Part : u8 {
+        Registers = 1,          // CPU registers, stall and interrupt
+        Ram = 2,                // internal RAM, pads, I/O registers and cartridge RAM
+        Ppu = 4,                // PPU registers, palette, name tables, OAM and pattern tables
+    };
+
+    struct Hashes {
+        u64 registers;
+        u64 ram;
+        u64 ppu;
+    };
+
+    struct Divergence {
+        u64 instruction;        // instructions run by each machine when compared
+        u64 lastMatch;          // instructions run at the last comparison which matched
+        u64 frame;              // position of the reference
+        u32 scanLine;
+        u32 dot;
+        u8 parts;               // Part bits which differ
+        u32 offset;             // in NesState, of the first byte which differs
+        Hashes reference;
+        Hashes candidate;
+    };
+
+    /**
+     * @param from instructions to run before the first comparison
+     * @param window instructions kept for the divergence, see GetWindow
+     */
+    Lockstep(Nes& pReference, LockstepCore& pCandidate, Granularity pGranularity, u64 from = 0, u32 window = 16);
+
+    Lockstep(const Lockstep&) = delete;
+    Lockstep& operator=(const Lockstep&) = delete;
+
+    /**
+     * Executes one instruction on each machine and compares them at the end
+     * of a granularity unit.
+     * @return false once they diverged, they are not run anymore
+     */
+    bool Step();
+
+    /**
+     * Steps until the reference starts the next frame, the candidate is
+     * synchronised then (LockstepCore::Sync).
+     * @return false once they diverged
+     */
+    bool RunFrame();
+
+    bool HasDiverged() const;
+    const Divergence& GetDivergence() const;
+
+    /**
+     * @return the instructions run by both machines so far
+     */
+    u64 GetInstructions() const;
+
+    /**
+     * @return the comparisons made so far
+     */
+    u64 GetComparisons() const;
+
+    /**
+     * The last instructions, oldest first, as InstructionTrace records them
+     * before executing each one. The candidate records hold the position of
+     * the reference PPU, the candidate one may not be up to date.
+     */
+    std::vector<InstructionTrace::Record> GetWindow(bool fromCandidate) const;
+
+    static Hashes Hash(const NesState& state);
+
+    /**
+     * Builds an iNES image of a mapper 0 cartridge running a random program
+     * of the official instructions: instructions in the main loop, with the
+     * rendering and the NMI on, and a shorter one in the NMI handler. Their
+     * operands target the RAM, the PPU registers, the OAM DMA and the pads;
+     * branches only jump forward, over whole instructions. The same seed
+     * always builds the same image.
+     */
+    static std::vector<u8> MakeFuzzRom(u64 seed, u32 instructions = 64);
+
+private:
+    // the last instructions of one machine
+    struct Ring {
+        std::vector<InstructionTrace::Record> records;
+        u64 count;              // recorded so far
+    };
+
+    void Capture(Nes& nes, Ring& ring);
+    bool Compare();
+
+    Nes& reference;
+    LockstepCore& candidate;
+    const Granularity granularity;
+    const u64 from;
+
+    u64 instructions;
+    u64 comparisons;
+    u64 frame;                  // of the reference at the previous instruction
+    u32 scanLine;
+    bool diverged;
+    Divergence divergence;
+
+    Ring referenceRing;
+    Ring candidateRing;
+
+    alignas(8) u8 referenceState[sizeof(NesState)];
+    alignas(8) u8 candidateState[sizeof(NesState)];
+};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "cow_memory.h"
+#include "nes_state.h"
 #include "util.h"
 
 namespace Frankenstein {
@@ -31,10 +33,15 @@ class Nes;
 template <typename DataType, typename AddressingType, unsigned int Size>
 class Memory {
 private:
-    DataType raw[Size];
+    CowMemory<Size> raw;
     Nes& nes;
 
+    // one bit per 256 bytes page of battery RAM written since the last TakeDirtySramPages
+    u32 dirtySramPages;
+
+    // Read tells the bus about the reads of watched pages, ReadDevice does not
     DataType Read(const AddressingType address);
+    DataType ReadDevice(const AddressingType address);
     void Write(const AddressingType address, const DataType val);
 
 public:
@@ -64,9 +71,55 @@ public:
 
     explicit Memory(Nes& nes);
 
+    /**
+     * Shares the pages of parent, they are copied on the first write.
+     */
+    Memory(Nes& nes, const Memory& parent);
+
     Ref operator[](const AddressingType);
 
+    /**
+     * Reads an instruction byte for the CPU: the value the Ref reads, not
+     * logged as a data read by the CodeDataLog nor seen by read watchpoints.
+     */
+    DataType Fetch(const AddressingType);
+
     void Copy(const DataType* source, const AddressingType destination, const unsigned int size);
+    void CopyTo(const AddressingType source, DataType* destination, const unsigned int size) const;
+
+    /**
+     * Maps the pages of pages from destination instead of copying them, used
+     * to share the rom between every instance.
+     */
+    template <u32 PagesSize>
+    void Share(const CowMemory<PagesSize>& pages, const AddressingType destination)
+    {
+        raw.Share(pages, destination);
+    }
+
+    /**
+     * @return the number of written pages shared with a parent or a fork
+     */
+    u32 SharedPages() const;
+
+    /**
+     * @return the number of pages owned by this instance alone
+     */
+    u32 PrivatePages() const;
+
+    /**
+     * Fetch and clear the set of battery RAM pages written since the last call.
+     * Bit n is set when the page starting at ADDR_SRAM + n * NES_PAGE_SIZE was
+     * modified.
+     * @return the dirty pages mask
+     */
+    u32 TakeDirtySramPages();
+
+    /**
+     * Copy the internal RAM, the I/O registers and the cartridge RAM to/from state
+     */
+    void Save(NesState& state) const;
+    void Load(const NesState& state);
 
     template <Addressing N>
     Ref Get(const DataType);
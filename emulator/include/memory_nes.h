@@ -5,18 +5,45 @@ namespace Frankenstein {
 template<>
 Memory<u8, u16, 0x10000>::Memory(Nes& pNes);
 
+template<>
+Memory<u8, u16, 0x10000>::Memory(Nes& pNes, const Memory<u8, u16, 0x10000>& parent);
+
 template <>
 Memory<u8, u16, 0x10000>::Ref Memory<u8, u16, 0x10000>::operator[](const u16 addr);
 
+template <>
+u8 Memory<u8, u16, 0x10000>::Fetch(const u16 address);
+
 template <>
 u8 Memory<u8, u16, 0x10000>::Read(const u16 address);
 
+template <>
+u8 Memory<u8, u16, 0x10000>::ReadDevice(const u16 address);
+
 template <>
 void Memory<u8, u16, 0x10000>::Write(const u16 address, const u8 val);
 
 template <>
 void Memory<u8, u16, 0x10000>::Copy(const u8* source, const u16 destination, const unsigned int size);
 
+template <>
+void Memory<u8, u16, 0x10000>::CopyTo(const u16 source, u8* destination, const unsigned int size) const;
+
+template <>
+u32 Memory<u8, u16, 0x10000>::SharedPages() const;
+
+template <>
+u32 Memory<u8, u16, 0x10000>::PrivatePages() const;
+
+template <>
+u32 Memory<u8, u16, 0x10000>::TakeDirtySramPages();
+
+template <>
+void Memory<u8, u16, 0x10000>::Save(NesState& state) const;
+
+template <>
+void Memory<u8, u16, 0x10000>::Load(const NesState& state);
+
 template <>
 bool Memory<u8, u16, 0x10000>::IsPageCrossed(u16 startAddress, u16 endAddress);
 
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "gamepad.h"
+#include "nes_state.h"
+#include "util.h"
+
+#include <string>
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Deterministic input movie.
+ *
+ * A movie starts from a save state and stores, for every frame, the buttons
+ * of each pad latch (the $4016 strobe going low) in the order they happen,
+ * plus a hash of the picture every CheckpointInterval frames. Replaying the
+ * latches from the same state reproduces the same frames, which the
+ * checkpoints verify.
+ *
+ * File layout: Header, then the PackBits compressed initial state, the
+ * PackBits compressed input stream and the checkpoint hashes. The input
+ * stream holds one record per frame: the number of latches, then one
+ * buttons byte per latch.
+ */
+class Movie : public LatchListener {
+public:
+    static constexpr u32 Magic = 0x4D53454E; // "NESM"
+    static constexpr u32 Version = 1;
+    static constexpr u32 CheckpointInterval = 60;
+
+    struct Header {
+        u32 magic;
+        u32 version;
+        u64 romHash;
+        u32 frames;
+        u32 stateSize;      // compressed size of the initial state
+        u32 inputSize;      // compressed size of the input stream
+        u32 inputRawSize;   // size of the input stream
+        u32 checkpoints;
+        u32 reserved;
+    };
+
+    enum class Mode {
+        Idle,
+        Recording,
+        Playing,
+        Finished,       // playback reached the end of the movie
+    };
+
+    explicit Movie(Nes& pNes);
+    ~Movie();
+
+    Movie(const Movie&) = delete;
+    Movie& operator=(const Movie&) = delete;
+
+    /**
+     * Snapshots the Nes and starts recording its pads.
+     */
+    void Record();
+
+    /**
+     * Writes the recorded movie.
+     * @return false when the file cannot be written
+     */
+    bool Save(const std::string& path) const;
+
+    /**
+     * Loads a movie, restores its initial state and starts playing it back.
+     * @return false when the file is not a valid movie of the current rom
+     */
+    bool Play(const std::string& path);
+
+    /**
+     * Stops recording or playing, the pads are left to the user again.
+     */
+    void Stop();
+
+    /**
+     * Closes the current frame. Call it from the emulator thread every time
+     * ppu.Frame changes.
+     */
+    void EndFrame();
+
+    void OnLatch(Gamepad& pad) override;
+
+    Mode GetMode() const;
+
+    /**
+     * @return the frames recorded, or played back so far
+     */
+    u32 GetFrame() const;
+
+    /**
+     * @return the frames in the movie being played back
+     */
+    u32 GetLength() const;
+
+    /**
+     * @return the first frame whose picture did not match its checkpoint, or -1
+     */
+    s32 GetFirstMismatch() const;
+
+private:
+    u64 PictureHash() const;
+
+    Nes& nes;
+    Mode mode;
+    u32 frame;
+    s32 firstMismatch;
+
+    alignas(8) u8 initialState[sizeof(NesState)];
+    std::vector<u8> input;
+    std::vector<u8> latches;            // buttons latched during the current frame (recording)
+    std::vector<u64> checkpoints;
+
+    u32 length;
+    u32 position;                       // next latch of the current frame in input (playing)
+    u32 remaining;                      // latches left in the current frame (playing)
+};
+
+}
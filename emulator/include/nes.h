@@ -5,27 +5,131 @@
 #include "ppu.h"
 #include "memory_nes.h"
 #include "gamepad.h"
+#include "nes_state.h"
+#include "nes_stats.h"
+#include "code_data_log.h"
+#include "bus.h"
+#include "trace.h"
 
 class CScreenDevice;
 
 namespace Frankenstein {
 
+class Nes;
+
+/**
+ * Notified when the PPU completes a picture, at the start of the vertical
+ * blank, from the thread stepping the Ppu. Pictures not drawn (Ppu::skipRender,
+ * the speculative frames of RunAhead) are not notified. The listener may read
+ * the machine but must not run it or load a state.
+ */
+class FrameListener {
+public:
+    virtual void OnFrame(Nes& nes) = 0;
+
+protected:
+    ~FrameListener() {}
+};
+
 class Nes
 {
 public:
+    /**
+     * Bytes used by one instance, see GetMemoryReport.
+     */
+    struct MemoryReport {
+        u32 object;         // the Nes itself: registers, OAM, palette and page tables
+        u32 ram;            // CPU address space pages owned by this instance
+        u32 vram;           // name and pattern table pages owned by this instance
+        u32 frameBuffers;   // 0 until Ppu::AllocateFrameBuffers
+        u32 shared;         // written pages also referenced by the rom or another instance
+
+        /**
+         * @return the bytes freed by deleting this instance, shared excluded
+         */
+        u32 Total() const;
+    };
+
     Gamepad pad1;
     Gamepad pad2;
     NesMemory ram;
     const Rom &rom;
+#ifdef WithCdl
+    // logged from power on or the fork, not part of the state; before cpu,
+    // which reads the reset vector when it is built
+    CodeDataLog cdl;
+#endif
+    // watchpoints and breakpoints, empty in forks; before cpu, which reads
+    // the reset vector when it is built
+    Bus bus;
     Cpu cpu;
     Ppu ppu;
     
     CScreenDevice* screen;
+
+    // the pictures completed go to frameListener, the buttons are asked to
+    // the listeners of the pads when the game latches them (LatchListener)
+    FrameListener* frameListener;
+
+    // when set, receives the spans of the timeline (frames, runs, scanlines,
+    // DMA stalls and NMI handlers)
+    TraceSink* tracer;
+
+#ifdef WithStats
+    // counted from power on or the fork, not part of the state
+    NesStats stats;
+#endif
     
     explicit Nes(Rom &rom);
     explicit Nes(Rom &rom, CScreenDevice* pScreen);
+
+    Nes(const Nes&) = delete;
+    Nes& operator=(const Nes&) = delete;
+
+    /**
+     * Branches the machine. The fork shares the rom and, until either side
+     * writes to them, every memory page (RAM, cartridge RAM, name and pattern
+     * tables). It has no frame buffers, see Ppu::AllocateFrameBuffers, and no
+     * frame listener, tracer, pad latch listener or bus watch. Do not run this instance while forking it.
+     * @return a new instance to delete once the branch is discarded
+     */
+    Nes* Fork();
     
     void Step();
+
+    /**
+     * Executes instructions until the PPU starts the next frame.
+     */
+    void RunFrame();
+
+    /**
+     * Executes instructions until at least cycles CPU cycles have elapsed.
+     * @return the cycles elapsed, the last instruction may end past cycles
+     */
+    u32 RunCycles(u32 cycles);
+
+    /**
+     * Serialises the whole machine in buffer, without allocating.
+     * @param buffer at least sizeof(NesState) bytes, aligned on 8 bytes
+     * @return the number of bytes written
+     */
+    u32 SaveState(u8* buffer) const;
+
+    /**
+     * Restores a machine serialised with SaveState.
+     * @param buffer at least sizeof(NesState) bytes, aligned on 8 bytes
+     * @return false when the buffer is not a state of the current version
+     */
+    bool LoadState(const u8* buffer);
+
+    /**
+     * Breakdown of the memory used by this instance. The rom, the tables
+     * shared by every instance and pages never written are not counted.
+     */
+    MemoryReport GetMemoryReport() const;
+
+private:
+    Nes(Nes& parent, const Rom& pRom);
 };
 
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * Flat binary image of a whole Nes, used by Nes::SaveState and Nes::LoadState.
+ *
+ * Every block only holds naturally aligned fixed size integers ordered by size,
+ * so each field sits at the same offset on every (little endian) host. Bump
+ * Version whenever the layout changes.
+ */
+struct NesState {
+    static constexpr u32 Magic = 0x5453454E; // "NEST"
+    static constexpr u32 Version = 2;
+
+    struct Header {
+        u32 magic;
+        u32 version;
+        u32 size;
+        u32 reserved;
+    };
+
+    struct CpuBlock {
+        u16 PC;
+        u16 stall;
+        u16 previousPC;
+        u8 SP;
+        u8 A;
+        u8 X;
+        u8 Y;
+        u8 P;
+        u8 cycles;
+        u8 nmiOccurred;
+        u8 currentOpcode;
+        u8 nextOpcode;
+        u8 reserved;
+    };
+
+    struct PpuBlock {
+        u64 Frame;
+        u64 tileData;
+        u32 Cycle;
+        u32 ScanLine;
+        u32 spriteCount;
+        u32 spritePatterns[8];
+        u16 v;
+        u16 t;
+        u8 x;
+        u8 w;
+        u8 f;
+        u8 reg;
+        u8 nmiOccurred;
+        u8 nmiOutput;
+        u8 nmiPrevious;
+        u8 vblankOccured;
+        u8 nmiDelay;
+        u8 nameTableByte;
+        u8 attributeTableByte;
+        u8 lowTileByte;
+        u8 highTileByte;
+        u8 spritePositions[8];
+        u8 spritePriorities[8];
+        u8 spriteIndexes[8];
+        u8 control;             // flagNameTable .. nmiOutput packed as written to $2000
+        u8 mask;                // flagGrayscale .. flagBlueTint packed as written to $2001
+        u8 flagSpriteZeroHit;
+        u8 flagSpriteOverflow;
+        u8 oamAddress;
+        u8 bufferedData;
+        u8 reserved[5];
+    };
+
+    struct GamepadBlock {
+        u8 index;
+        u8 strobe;
+        u8 buttons;             // bit n is ButtonIndex n
+        u8 latched;
+    };
+
+    Header header;              // 0x0000
+    CpuBlock cpu;               // 0x0010
+    PpuBlock ppu;               // 0x0020
+    GamepadBlock pads[2];       // 0x0090
+    u8 ram[0x800];              // 0x0098 internal RAM $0000-$07FF
+    u8 io[0x20];                // 0x0898 APU and I/O registers $4000-$401F
+    u8 sram[PRGRAM_BANK_SIZE];  // 0x08B8 cartridge RAM $6000-$7FFF
+    u8 paletteData[32];         // 0x28B8
+    u8 nameTableData[2048];     // 0x28D8
+    u8 oamData[256];            // 0x30D8
+    u8 chrData[0x2000];         // 0x31D8 pattern tables (CHR-ROM copy or CHR-RAM)
+};
+
+static_assert(sizeof(NesState::CpuBlock) == 0x10, "NesState layout changed, bump NesState::Version");
+static_assert(sizeof(NesState::PpuBlock) == 0x70, "NesState layout changed, bump NesState::Version");
+static_assert(__builtin_offsetof(NesState, chrData) == 0x31D8, "NesState layout changed, bump NesState::Version");
+static_assert(sizeof(NesState) == 0x51D8, "NesState layout changed, bump NesState::Version");
+
+}
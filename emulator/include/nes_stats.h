@@ -0,0 +1,124 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * What the machine did during one frame, from a vertical blank to the next.
+ */
+struct FrameStats {
+    u64 frame;                  // Ppu::Frame when the frame ended
+    u32 instructions;           // NMIs and DMA stalls excluded
+    u32 cpuCycles;              // stall cycles included
+    u32 dmaStallCycles;         // CPU cycles stalled by OAM DMA ($4014)
+    u32 registerReads[8];       // CPU reads of $2000-$2007, mirrors folded
+    u32 registerWrites[8];      // CPU writes of $2000-$2007, mirrors folded
+    u32 oamDmas;                // writes of $4014
+    u32 statusPolls;            // reads of $2002 that found the vertical blank flag clear
+    u32 nmis;                   // NMIs taken by the CPU
+    u32 spriteOverflowLines;    // lines with more than 8 sprites
+    u64 cpuNanoseconds;         // host time in Cpu::Step, estimated, see NesStats
+    u64 ppuNanoseconds;         // host time in Ppu::Step, estimated, see NesStats
+};
+
+/**
+ * Counts what each frame costs, from the CPU, the PPU and the host clock.
+ *
+ * The counters are only compiled in with -DWithStats (meson configure
+ * -Dstats=true): Nes::stats does not exist otherwise and the emulation is
+ * left as it is. The counters alone cost little. The host times are
+ * estimated from a sample: Nes::Step reads the clock around one step in
+ * SampleInterval on average, at pseudo random intervals so that the loops
+ * of a game do not alias with them, and EndFrame scales the sampled times
+ * up to every step of the frame. With the clock read around every step
+ * the emulation ran 35-40 % slower, with the sample a few percent. On the
+ * Pi the clock is Circle's CTimer, which counts microseconds: a sampled
+ * step mostly reads 0 or 1, the frame estimate is only good on average.
+ *
+ * The CPU counters (instructions, cycles, OAM DMAs, NMIs) are in current,
+ * written by the thread stepping the Cpu; the PPU ones (register accesses,
+ * $2002 polls, sprite overflows) in
+ * ppuCurrent, written by the thread stepping the Ppu. EndFrame adds them
+ * up: the Ppu calls it at the vertical blank when one thread steps the
+ * machine. With a PpuPipeline, PpuPipeline::Sync calls it once the render
+ * thread is idle, for the frames the CPU left since the last Sync; its
+ * RunFrame syncs every frame, and no host time is measured.
+ */
+class NesStats {
+public:
+    static constexpr u32 History = 64;
+    static constexpr u32 SampleInterval = 16;
+
+    // the frame being counted, CPU side
+    FrameStats current;
+
+    // the frame being counted, PPU side
+    FrameStats ppuCurrent;
+
+    NesStats();
+
+    /**
+     * Ends the current frame: it becomes Last(0) and counting starts over.
+     */
+    void EndFrame(u64 frame);
+
+    /**
+     * Counts a Nes::Step.
+     * @return true when the step is to be timed, see AddSample
+     */
+    bool SampleStep()
+    {
+        steps++;
+        if (--countdown != 0) {
+            return false;
+        }
+        seed = seed * 1103515245 + 12345;
+        countdown = SampleInterval / 2 + (seed >> 16) % SampleInterval;
+        return true;
+    }
+
+    void AddSample(u64 cpuNanoseconds, u64 ppuNanoseconds)
+    {
+        sampledCpu += cpuNanoseconds;
+        sampledPpu += ppuNanoseconds;
+        sampledSteps++;
+    }
+
+    /**
+     * @return the number of frames ended, at most History are kept
+     */
+    u64 GetFrames() const;
+
+    /**
+     * @param age 0 for the last frame ended, up to min(GetFrames(), History) - 1
+     */
+    const FrameStats& Last(u32 age = 0) const;
+
+    /**
+     * Sums the last frames ended, frame is the last one's.
+     * @param count at most min(GetFrames(), History)
+     */
+    FrameStats Sum(u32 count) const;
+
+    /**
+     * @return a monotonic host time in nanoseconds, in microsecond steps on the Pi
+     */
+    static u64 Now();
+
+private:
+    static void Add(FrameStats& sum, const FrameStats& frame);
+
+    FrameStats frames[History];
+    u64 ended;
+
+    // the sample of the current frame
+    u64 sampledCpu;
+    u64 sampledPpu;
+    u32 sampledSteps;
+    u32 steps;
+    u32 countdown;              // steps before the next sample
+    u32 seed;
+};
+
+}
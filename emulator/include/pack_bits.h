@@ -0,0 +1,46 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * PackBits byte oriented run length codec.
+ *
+ * The stream is a sequence of packets starting with a control byte c:
+ * - c < 0x80: c + 1 literal bytes follow
+ * - c >= 0x80: the next byte is repeated c - 0x7D times (3 to 130)
+ *
+ * It is meant for save states and their XOR deltas, which are mostly made of
+ * long runs of identical (often zero) bytes.
+ */
+struct PackBits {
+    /**
+     * Worst case size of the compressed form of size bytes.
+     */
+    static constexpr u32 Bound(u32 size)
+    {
+        return size + (size + 127) / 128;
+    }
+
+    /**
+     * Largest decompressed size of size compressed bytes, all runs of 130.
+     */
+    static constexpr u64 ExpandedBound(u32 size)
+    {
+        return u64(size / 2) * 130;
+    }
+
+    /**
+     * @param destination at least Bound(size) bytes
+     * @return the compressed size
+     */
+    static u32 Compress(const u8* source, u32 size, u8* destination);
+
+    /**
+     * @return the decompressed size, or 0 when the stream does not fit in capacity
+     */
+    static u32 Decompress(const u8* source, u32 size, u8* destination, u32 capacity);
+};
+
+}
@@ -1,11 +1,27 @@
 #pragma once
 
+#include "cow_memory.h"
+#include "nes_state.h"
 #include "rom.h"
 
 namespace Frankenstein {
 
+class FrameExchange;
 class Nes;
 
+/**
+ * Takes the CPU accesses to the PPU registers ($2000-$2007, $4014) in place
+ * of the Ppu, see PpuPipeline.
+ */
+class PpuRegisterPort {
+public:
+    virtual u8 ReadRegister(u16 address) = 0;
+    virtual void WriteRegister(u16 address, u8 value) = 0;
+
+protected:
+    ~PpuRegisterPort() {}
+};
+
 class Ppu {
 public:
     struct BytePair {
@@ -50,13 +66,8 @@ public:
         FlipVertical = 7        //Indicates whether to flip the sprite vertically.
     };
 
-    const u16 MirrorLookup[5][4]{
-        { 0, 0, 1, 1 },
-        { 0, 1, 0, 1 },
-        { 0, 0, 0, 0 },
-        { 1, 1, 1, 1 },
-        { 0, 1, 2, 3 },
-    };
+    // tables shared by every instance
+    static const u16 MirrorLookup[5][4];
 
 #ifndef NotNative
     struct RGBColor {
@@ -65,10 +76,10 @@ public:
             blue : 8, 
             alpha : 8;
         
-        RGBColor(): red(0), green(0), blue(0), alpha(0xFF) {
+        constexpr RGBColor(): red(0), green(0), blue(0), alpha(0xFF) {
         }
         
-        RGBColor(u8 red, u8 green, u8 blue) : red(red), green(green), blue(blue), alpha(0xFF) {
+        constexpr RGBColor(u8 red, u8 green, u8 blue) : red(red), green(green), blue(blue), alpha(0xFF) {
         }
     };
 #else
@@ -79,84 +90,38 @@ public:
             alpha : 8;
             
         
-        RGBColor(): blue(0), green(0), red(0), alpha(0) {
+        constexpr RGBColor(): blue(0), green(0), red(0), alpha(0) {
         }
         
-        RGBColor(u8 red, u8 green, u8 blue) : blue(blue), green(green), red(red),  alpha(0) {
+        constexpr RGBColor(u8 red, u8 green, u8 blue) : blue(blue), green(green), red(red),  alpha(0) {
         }
     };
 #endif
 
-    const RGBColor systemPalette[0x40] = {
-        { 0x80, 0x80, 0x80 },
-        { 0x00, 0x3D, 0xA6 },
-        { 0x00, 0x12, 0xB0 },
-        { 0x44, 0x00, 0x96 },
-        { 0xA1, 0x00, 0x5E },
-        { 0xC7, 0x00, 0x28 },
-        { 0xBA, 0x06, 0x00 },
-        { 0x8C, 0x17, 0x00 },
-        { 0x5C, 0x2F, 0x00 },
-        { 0x10, 0x45, 0x00 },
-        { 0x05, 0x4A, 0x00 },
-        { 0x00, 0x47, 0x2E },
-        { 0x00, 0x41, 0x66 },
-        { 0x00, 0x00, 0x00 },
-        { 0x05, 0x05, 0x05 },
-        { 0x05, 0x05, 0x05 },
-        { 0xC7, 0xC7, 0xC7 },
-        { 0x00, 0x77, 0xFF },
-        { 0x21, 0x55, 0xFF },
-        { 0x82, 0x37, 0xFA },
-        { 0xEB, 0x2F, 0xB5 },
-        { 0xFF, 0x29, 0x50 },
-        { 0xFF, 0x22, 0x00 },
-        { 0xD6, 0x32, 0x00 },
-        { 0xC4, 0x62, 0x00 },
-        { 0x35, 0x80, 0x00 },
-        { 0x05, 0x8F, 0x00 },
-        { 0x00, 0x8A, 0x55 },
-        { 0x00, 0x99, 0xCC },
-        { 0x21, 0x21, 0x21 },
-        { 0x09, 0x09, 0x09 },
-        { 0x09, 0x09, 0x09 },
-        { 0xFF, 0xFF, 0xFF },
-        { 0x0F, 0xD7, 0xFF },
-        { 0x69, 0xA2, 0xFF },
-        { 0xD4, 0x80, 0xFF },
-        { 0xFF, 0x45, 0xF3 },
-        { 0xFF, 0x61, 0x8B },
-        { 0xFF, 0x88, 0x33 },
-        { 0xFF, 0x9C, 0x12 },
-        { 0xFA, 0xBC, 0x20 },
-        { 0x9F, 0xE3, 0x0E },
-        { 0x2B, 0xF0, 0x35 },
-        { 0x0C, 0xF0, 0xA4 },
-        { 0x05, 0xFB, 0xFF },
-        { 0x5E, 0x5E, 0x5E },
-        { 0x0D, 0x0D, 0x0D },
-        { 0x0D, 0x0D, 0x0D },
-        { 0xFF, 0xFF, 0xFF },
-        { 0xA6, 0xFC, 0xFF },
-        { 0xB3, 0xEC, 0xFF },
-        { 0xDA, 0xAB, 0xEB },
-        { 0xFF, 0xA8, 0xF9 },
-        { 0xFF, 0xAB, 0xB3 },
-        { 0xFF, 0xD2, 0xB0 },
-        { 0xFF, 0xEF, 0xA6 },
-        { 0xFF, 0xF7, 0x9C },
-        { 0xD7, 0xE8, 0x95 },
-        { 0xA6, 0xED, 0xAF },
-        { 0xA2, 0xF2, 0xDA },
-        { 0x99, 0xFF, 0xFC },
-        { 0xDD, 0xDD, 0xDD },
-        { 0x11, 0x11, 0x11 },
-        { 0x11, 0x11, 0x11 }
-    };
+    static const RGBColor systemPalette[0x40];
     Nes& nes;
 
+    // nullptr until AllocateFrameBuffers is called
     RGBColor* front;
     RGBColor* back;
+
+    // when set, pixels are not drawn and the frame buffers are not swapped,
+    // everything else (sprite zero hit, timings) is still emulated
+    bool skipRender;
+
+    // when set, the palette indexes of each picture are hashed, with
+    // skipRender and without frame buffers too, see TakePictureHashes; the
+    // dots drawn with the rendering off are hashed as the backdrop
+    bool hashPictures;
+
+    // when set, the CPU accesses the registers through port, which also
+    // raises the NMI instead of this Ppu (signalNmi cleared)
+    PpuRegisterPort* port;
+    bool signalNmi;
+
+    // when set, the completed pictures are handed over to frames instead of
+    // swapping front and back, see FrameExchange
+    FrameExchange* frames;
     
     u32 Cycle;      // 0-340
     u32 ScanLine;   // 0-261, 0-239=visible, 240=post, 241-260=vblank, 261=pre
@@ -164,9 +129,9 @@ public:
 
     // storage variables
     u8 paletteData[32];
-    u8 nameTableData[2048];
+    CowMemory<2048> nameTableData;
     u8 oamData[256];
-    u8 chrData[0x2000];
+    CowMemory<0x2000> chrData;
 
     // PPU registers
     u16 v;      // current vram address (15 bit)
@@ -226,9 +191,51 @@ public:
     // $2007 PPUDATA
     u8 bufferedData;  // for buffered reads
 
+    // picture hashes, not part of the state
+    static constexpr u32 PictureHashHistory = 64;
+    u64 pictureHash;                            // FNV-1a of the picture being drawn
+    u64 pictureHashes[PictureHashHistory];      // of the last pictures completed
+    u64 picturesHashed;
+    u64 picturesTaken;
+
     explicit Ppu(Nes& pNes);
 
+    /**
+     * Copies the registers of parent and shares its name and pattern tables.
+     * The fork has no frame buffers.
+     */
+    Ppu(Nes& pNes, const Ppu& parent);
+    ~Ppu();
+
+    Ppu(const Ppu&) = delete;
+    Ppu& operator=(const Ppu&) = delete;
+
     void Reset();
+
+    /**
+     * Allocates the front and back buffers if needed, a Ppu without them
+     * emulates everything but the pixels.
+     */
+    void AllocateFrameBuffers();
+    bool HasFrameBuffers() const;
+
+    /**
+     * Copy the registers, latches and memories to/from state. The frame
+     * buffers are not part of the state.
+     */
+    void Save(NesState& state) const;
+    void Load(const NesState& state);
+    void Save(NesState::PpuBlock& block) const;
+    void Load(const NesState::PpuBlock& block);
+
+    /**
+     * Copies the hashes of the pictures completed since the last call,
+     * oldest first, while hashPictures was set. Only the last
+     * PictureHashHistory are kept. Call it from the thread stepping the Ppu.
+     * @return the number of hashes copied, at most capacity
+     */
+    u32 TakePictureHashes(u64* hashes, u32 capacity);
+
     u8 Read(u16 address);
     void Write(u16 address, u8 value);
     u16 MirrorAddress(u8 mode, u16 address);
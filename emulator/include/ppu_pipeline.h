@@ -0,0 +1,183 @@
+#pragma once
+
+#include "ppu.h"
+#include "util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Runs the PPU of a Nes on its own thread while the CPU runs on the caller's.
+ *
+ * The CPU thread keeps a model of the PPU timing only (dots, scanlines, odd
+ * frames, vertical blank and NMI), enough to raise the NMI at the same cycle
+ * as Nes::Step. The register writes are stamped with the PPU dot they happen
+ * at and appended to a single producer single consumer ring; the render
+ * thread steps the real Ppu up to each stamp, applies the write and draws
+ * the scanlines in between.
+ *
+ * Reads have to be answered at once:
+ * - $2002 comes from the model when it can tell the sprite flags: before
+ *   any rendering in the frame, or from the flags the render thread
+ *   published when they cannot change anymore. The render thread checks the
+ *   answer against the real Ppu: a wrong one is a bug of the prediction,
+ *   the CPU already used it and the run differs from Nes::Step. Debug builds
+ *   stop on an assertion, release builds count it and resynchronise.
+ * - other $2002 reads (sprite zero polling) and $2004/$2007 block until the
+ *   render thread reaches the read and answers it from the real Ppu. The
+ *   model then resynchronises its timing with the real one if they differ.
+ *
+ * Pictures and states are the same as with Nes::Step. While attached, only
+ * this class runs the Nes, and its Ppu is up to date after Sync. The render
+ * thread sleeps on a condition variable when it has caught up with the CPU
+ * for a while, the CPU thread wakes it when it runs again.
+ */
+class PpuPipeline : public PpuRegisterPort {
+public:
+    struct Stats {
+        u64 writes;             // register writes logged
+        u64 predictedReads;     // $2002 reads answered by the model
+        u64 blockingReads;      // reads answered by the render thread
+        u64 mispredictions;     // model answers the real Ppu disagreed with, always 0 in debug builds
+        u64 resyncs;            // model timings corrected after a blocking read
+    };
+
+    /**
+     * Attaches to the Ppu of nes and starts the render thread.
+     * @param capacity of the write log in entries, a power of two
+     */
+    explicit PpuPipeline(Nes& pNes, u32 capacity = 1 << 16);
+
+    /**
+     * Waits for the render thread, stops it and gives the Ppu back to nes.
+     */
+    ~PpuPipeline();
+
+    PpuPipeline(const PpuPipeline&) = delete;
+    PpuPipeline& operator=(const PpuPipeline&) = delete;
+
+    /**
+     * Executes one instruction, as Nes::Step.
+     */
+    void Step();
+
+    /**
+     * Executes instructions until the next frame starts, as Nes::RunFrame,
+     * then waits for the render thread to finish the frame.
+     */
+    void RunFrame();
+
+    /**
+     * Waits until the render thread has applied every logged access. With
+     * -DWithStats, ends the frames of Nes::stats the CPU left since the
+     * last Sync, now that the render thread counts no more.
+     */
+    void Sync();
+
+    /**
+     * Takes the timing of the Ppu again after the state of nes was replaced
+     * (Nes::LoadState). Call it after Sync only.
+     */
+    void Reload();
+
+    /**
+     * @return the frame the CPU is in, the Ppu may not be there yet
+     */
+    u64 GetFrame() const;
+
+    Stats GetStats() const;
+
+    u8 ReadRegister(u16 address) override;
+    void WriteRegister(u16 address, u8 value) override;
+
+private:
+    enum class Kind : u8 {
+        Write,          // register write
+        OamByte,        // a byte copied by the $4014 DMA
+        Read,           // blocking read, answered in reply
+        Status,         // $2002 read answered by the model, value is the answer
+    };
+
+    struct Event {
+        u64 dot;
+        u16 address;
+        u8 value;
+        Kind kind;
+    };
+
+    // the part of the Ppu state the CPU depends on
+    struct Timing {
+        u32 Cycle;
+        u32 ScanLine;
+        u64 Frame;
+        u8 f;
+        u8 reg;
+        u8 nmiDelay;
+        bool nmiOccurred;
+        bool nmiOutput;
+        bool nmiPrevious;
+        bool rendering;
+
+        void Load(const Ppu& ppu);
+        bool operator==(const Timing& other) const;
+    };
+
+    void StepModel();
+    void NmiChange();
+    bool PredictFlags(u8& flags) const;
+    u8 BlockingRead(u16 address);
+    void Push(const Event& event);
+
+    void Wake();
+
+    void RenderMain();
+    void Sleep();
+    void StepTo(u64 target);
+    void Apply(const Event& event);
+    void Publish();
+
+    Nes& nes;
+
+    // CPU thread
+    Timing model;
+    u64 dot;                    // PPU dots run since attached
+    u64 clearDot;               // dot after the last sprite flags clear
+    u64 finalDot;               // dot after which the flags of this frame are final
+    bool renderedSinceClear;    // the flags may have been set since clearDot
+    u64 requests;
+    Stats stats;
+#ifdef WithStats
+    u64 statsFrame;             // the frame Nes::stats counts, see Sync
+#endif
+
+    // write log, written by the CPU thread, read by the render thread
+    std::vector<Event> log;
+    const u64 mask;
+    std::atomic<u64> head;
+    std::atomic<u64> tail;
+    std::atomic<u64> cpuDot;    // the render thread may step the Ppu up to it
+
+    // render thread
+    u64 renderDot;
+    std::atomic<u64> published;     // renderDot << 2 | sprite flags
+    std::atomic<u64> replies;       // number of the last blocking read answered
+    u8 replyValue;
+    Timing replyTiming;
+    std::atomic<u64> mispredictions;
+    std::atomic<bool> resync;
+    std::atomic<bool> stopping;
+    std::atomic<bool> sleeping;     // the render thread waits on idle
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    std::thread renderer;
+};
+
+}
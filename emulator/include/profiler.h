@@ -0,0 +1,142 @@
+#pragma once
+
+#include "util.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Names of the addresses of a game, for Profiler reports.
+ */
+class SymbolTable {
+public:
+    /**
+     * Reads the labels of a ca65/ld65 debug file (--dbgfile, the "sym" lines
+     * of type lab), a VICE label file (ld65 -Ln, "al 00C000 .reset") or a
+     * plain list of "C000 reset" or "reset = $C000" lines.
+     * @return false when the file cannot be read or holds no label
+     */
+    bool Load(const std::string& path);
+
+    void Add(u16 address, const std::string& name);
+
+    /**
+     * @return the label at address, or $XXXX
+     */
+    std::string GetName(u16 address) const;
+
+    /**
+     * @return the closest label at or before address with the offset from it
+     * (reset+3), or $XXXX
+     */
+    std::string Locate(u16 address) const;
+
+    u32 GetCount() const;
+
+private:
+    std::map<u16, std::string> labels;
+};
+
+/**
+ * Counts the CPU cycles each instruction address and each call stack costs.
+ *
+ * Step runs one instruction with Nes::Step and adds its cycles to a flat
+ * histogram indexed by PC: an array update per instruction. The call stack
+ * is rebuilt from JSR, BRK and the NMI, which enter a function, and RTS and
+ * RTI, which leave every function entered at a stack pointer at or below the
+ * one they return to; a game pushing its own return addresses (RTS jump
+ * tables) is followed as well. Each stack is a node of a tree, so a call or
+ * a return costs a hash lookup at most. The cycles of OAM DMA stalls go to
+ * the stack they interrupt, under a "[OAM DMA]" frame.
+ *
+ * The banks are the 16 KB windows of PRG-ROM, as mapped for mapper 0, and
+ * the internal and cartridge RAM; they come from the histogram when asked.
+ */
+class Profiler {
+public:
+    static constexpr u32 MaxDepth = 64;
+
+    struct Bank {
+        std::string name;   // RAM, SRAM, PRG0, PRG1...
+        u64 cycles;
+    };
+
+    explicit Profiler(Nes& pNes);
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /**
+     * Executes and accounts one instruction.
+     */
+    void Step();
+
+    /**
+     * Steps until the PPU starts the next frame.
+     */
+    void RunFrame();
+
+    /**
+     * Clears the counts, the call stack is kept.
+     */
+    void Reset();
+
+    u64 GetCycles() const;
+    u64 GetCycles(u16 pc) const;
+    std::vector<Bank> GetBanks() const;
+
+    /**
+     * The addresses which cost the most cycles, most expensive first.
+     */
+    std::vector<std::pair<u16, u64>> GetHottest(u32 count) const;
+
+    /**
+     * Writes one line per call stack, "[top];main;update 1234" (the functions
+     * from the outermost, then the cycles), the format of flamegraph.pl,
+     * inferno or speedscope. [top] is the code no call was seen entering.
+     */
+    void WriteFoldedStacks(std::ostream& out, const SymbolTable& symbols) const;
+
+    /**
+     * Writes the histogram as a 256x256 PGM picture, one pixel per address
+     * ($xx00-$xxFF on a row), the brightness growing with the log of the cycles.
+     */
+    void WriteHeatmap(std::ostream& out) const;
+
+private:
+    static constexpr u32 DmaFrame = 0x10000;    // not an address, the DMA pseudo function
+    static constexpr u32 Root = 0;
+
+    struct Node {
+        u32 parent;
+        u32 function;       // entry address, or DmaFrame
+        u64 cycles;         // spent in this function itself
+    };
+
+    struct Frame {
+        u32 node;
+        u8 sp;              // the stack pointer before the call
+    };
+
+    void Enter(u32 function, u8 sp);
+    void Leave(u8 sp);
+    u32 GetChild(u32 parent, u32 function);
+
+    Nes& nes;
+    std::vector<u64> histogram;     // cycles per PC
+    u64 dmaCycles;
+
+    std::vector<Node> nodes;
+    std::unordered_map<u64, u32> children;  // parent << 32 | function -> node
+    Frame stack[MaxDepth];
+    u32 depth;
+};
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "nes_state.h"
+#include "util.h"
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Rewind history of a Nes, kept in a fixed size ring.
+ *
+ * Every Push stores the current state either as a keyframe or as the XOR
+ * delta against the last keyframe, compressed with PackBits. A delta only
+ * depends on its keyframe, so restoring any frame costs at most two
+ * decompressions. When the ring is full, the oldest keyframe is dropped
+ * together with the deltas that depend on it.
+ */
+class Rewind {
+public:
+    struct Stats {
+        u32 capacity;       // bytes reserved for the compressed snapshots
+        u32 used;           // bytes currently used by the snapshots
+        u32 frames;         // snapshots that can be restored
+        u32 keyframes;      // snapshots stored without delta
+        u64 rawBytes;       // uncompressed size of the stored snapshots
+    };
+
+    /**
+     * @param capacity         memory budget for the compressed snapshots, in bytes
+     * @param keyframeInterval maximum number of deltas stored after a keyframe
+     */
+    Rewind(Nes& pNes, u32 capacity, u32 keyframeInterval = 60);
+    ~Rewind();
+
+    Rewind(const Rewind&) = delete;
+    Rewind& operator=(const Rewind&) = delete;
+
+    /**
+     * Snapshots the current state of the Nes. Call it once per frame.
+     */
+    void Push();
+
+    /**
+     * Restores the most recent snapshot and removes it from the history.
+     * @return false when there is nothing left to rewind
+     */
+    bool Pop();
+
+    /**
+     * Drops every snapshot.
+     */
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        u32 offset;
+        u32 size;
+        bool keyframe;
+    };
+
+    Entry& At(u32 sequence) const;
+    u32 Allocate(u32 size);
+    void DropOldest();
+    void Restore(const Entry& entry);
+    void ReloadKeyframe();
+
+    Nes& nes;
+    const u32 capacity;
+    const u32 keyframeInterval;
+    const u32 maxEntries;
+
+    u8* data;               // ring of compressed snapshots
+    Entry* entries;         // ring of snapshot descriptors, indexed by sequence % maxEntries
+    u32 first;              // sequence of the oldest snapshot
+    u32 count;              // number of snapshots
+    u32 head;               // where the next snapshot is written in data
+    u32 used;
+    u32 keyframes;
+    u32 sinceKeyframe;      // deltas pushed since the newest keyframe
+
+    alignas(8) u8 current[sizeof(NesState)];
+    alignas(8) u8 keyframe[sizeof(NesState)];
+    u8* packed;             // scratch buffer of PackBits::Bound(sizeof(NesState)) bytes
+};
+
+}
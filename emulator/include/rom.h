@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cow_memory.h"
 #include "util.h"
 
 namespace Frankenstein {
@@ -33,7 +34,29 @@ public:
     u8* GetCHR() const;
     u8* GetSRAM() const;
 
+    /**
+     * PRG-ROM as mapped at $8000-$FFFF and CHR-ROM as mapped at $0000-$1FFF
+     * of the PPU. Every instance shares these pages instead of copying them.
+     */
+    const CowMemory<0x8000>& GetPRGPages() const;
+    const CowMemory<0x2000>& GetCHRPages() const;
+
+    /**
+     * Whether the cartridge keeps its PRG-RAM ($6000-$7FFF) alive with a battery.
+     */
+    bool HasBattery() const;
+
+    /**
+     * Hash of the PRG and CHR data, used to identify a game independently of
+     * the file name (battery saves, movies).
+     */
+    u64 GetHash() const;
+
     Rom(const u8* const data, u64 size);
+    Rom(Rom&& other);
+    Rom(const Rom&) = delete;
+    Rom& operator=(const Rom&) = delete;
+    ~Rom();
     
 private:
     const u8* const raw;
@@ -43,10 +66,14 @@ private:
     u8* PRG;
     u8* CHR;
     u8* SRAM;
+    u64 hash;
+    CowMemory<0x8000> prgPages;
+    CowMemory<0x2000> chrPages;
 
     iNesHeader MakeHeader() const;
     u8* MakePRG() const;
     u8* MakeCHR() const;
     u8* MakeSRAM() const;
+    void MapPages();
 };
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "nes_state.h"
+#include "util.h"
+
+namespace Frankenstein {
+
+class Nes;
+
+/**
+ * Run-ahead input latency reduction.
+ *
+ * Every frame, the real frame is emulated without drawing and saved, then
+ * the next frames are speculatively emulated with the current input and
+ * only the last one is drawn, before the saved state is restored. The frame
+ * shown is thus the one the game would only display frames later, hiding
+ * that many frames of the game's own input lag.
+ */
+class RunAhead {
+public:
+    RunAhead(Nes& pNes, u32 pFrames);
+
+    RunAhead(const RunAhead&) = delete;
+    RunAhead& operator=(const RunAhead&) = delete;
+
+    /**
+     * Emulates one frame and draws the frame that is `frames` frames ahead.
+     * Without run-ahead frames, this is the same as Nes::RunFrame.
+     */
+    void RunFrame();
+
+    u32 GetFrames() const;
+    void SetFrames(u32 pFrames);
+
+private:
+    Nes& nes;
+    u32 frames;
+    alignas(8) u8 state[sizeof(NesState)];
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * A value written by one thread and read by others without locks.
+ *
+ * The writer makes the sequence odd, copies the value and makes it even
+ * again; a reader retries when the sequence was odd or changed during its
+ * copy. The writer never waits, which suits an interrupt handler, and a
+ * reader only retries while a write is in progress. T must be trivially
+ * copyable; its bytes are copied with relaxed atomic accesses so that a
+ * torn copy is discarded rather than undefined.
+ */
+template <typename T>
+class SeqLock {
+public:
+    SeqLock()
+        : sequence(0)
+        , bytes{ 0 }
+    {
+    }
+
+    explicit SeqLock(const T& value)
+        : SeqLock()
+    {
+        Store(value);
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /**
+     * Writer: replaces the value. Only one thread may write.
+     */
+    void Store(const T& value)
+    {
+        u32 current = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+        __atomic_store_n(&sequence, current + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        const u8* source = reinterpret_cast<const u8*>(&value);
+        for (u32 i = 0; i < sizeof(T); ++i) {
+            __atomic_store_n(&bytes[i], source[i], __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&sequence, current + 2, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Reader: copies the last value stored.
+     */
+    T Load() const
+    {
+        T value;
+        u8* target = reinterpret_cast<u8*>(&value);
+        u32 before;
+        u32 after;
+        do {
+            before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+            for (u32 i = 0; i < sizeof(T); ++i) {
+                target[i] = __atomic_load_n(&bytes[i], __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+        } while ((before & 1) != 0 || before != after);
+        return value;
+    }
+
+    /**
+     * @return the number of values stored so far
+     */
+    u32 GetVersion() const
+    {
+        return __atomic_load_n(&sequence, __ATOMIC_ACQUIRE) / 2;
+    }
+
+private:
+    u32 sequence;
+    u8 bytes[sizeof(T)];
+};
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "ppu.h"
+#include "thread_pool.h"
+#include "util.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Frankenstein {
+
+class Nes;
+class Rom;
+
+/**
+ * Runs many game sessions in real time on a shared ThreadPool.
+ *
+ * Each session is a Nes whose frames are tasks: a scheduler thread submits
+ * the next frame of a session when its frame period starts, and the frame
+ * must be emulated before the period ends, its deadline. A frame finished
+ * after its deadline is counted as missed; a session more than a whole
+ * period late restarts its periods from the end of the late frame instead of
+ * running the frames it is behind back to back, so it slows down rather
+ * than stutters.
+ *
+ * Sessions are independent: they can be added, removed and fed from any
+ * thread while the others run.
+ */
+class SessionHost {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // NTSC frame rate, 60.0988 Hz
+    static constexpr std::chrono::nanoseconds FramePeriod{ 16639267 };
+
+    struct Stats {
+        u64 frames;         // frames emulated
+        u64 missed;         // frames finished after their deadline
+        u64 skipped;        // periods given up when more than a frame late
+        Clock::duration worstLateness;
+        Clock::duration emulation;  // time spent emulating, for the load per session
+    };
+
+    /**
+     * @param threads workers of the pool, 0 for one per hardware thread
+     * @param pin     bind each worker to a CPU
+     */
+    explicit SessionHost(u32 threads = 0, bool pin = false);
+
+    /**
+     * Stops the scheduler and waits for the frames being emulated.
+     */
+    ~SessionHost();
+
+    SessionHost(const SessionHost&) = delete;
+    SessionHost& operator=(const SessionHost&) = delete;
+
+    /**
+     * Starts a session, its first frame period begins now.
+     * @param rom   kept referenced until the session is removed
+     * @param video whether the session draws pictures for CollectFrame
+     * @return the id of the session
+     */
+    u32 Add(Rom& rom, bool video = true);
+
+    /**
+     * Stops a session, a frame being emulated is finished before.
+     */
+    void Remove(u32 id);
+
+    u32 Size() const;
+
+    /**
+     * Sets the buttons used from the next frame, bit n is Gamepad::ButtonIndex n.
+     */
+    void SetButtons(u32 id, u8 pad1, u8 pad2 = 0);
+
+    /**
+     * Copies the last picture of a video session.
+     * @param picture 256x240 pixels
+     * @return the frame number of the picture, 0 when there is none yet
+     */
+    u64 CollectFrame(u32 id, Ppu::RGBColor* picture);
+
+    Stats GetStats(u32 id) const;
+
+    /**
+     * @return the stats of every current session added up
+     */
+    Stats GetTotals() const;
+
+    ThreadPool& GetPool();
+
+private:
+    struct Session;
+
+    // the start of the next frame period of a session
+    struct Timer {
+        Clock::time_point start;
+        std::shared_ptr<Session> session;
+
+        bool operator>(const Timer& other) const
+        {
+            return start > other.start;
+        }
+    };
+
+    void SchedulerMain();
+    void RunFrame(const std::shared_ptr<Session>& session);
+    std::shared_ptr<Session> Find(u32 id) const;
+
+    ThreadPool pool;
+
+    // guarded by mutex
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;     // a timer earlier than wakeAt was added
+    std::condition_variable finished;   // a frame task ended
+    std::map<u32, std::shared_ptr<Session>> sessions;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    Clock::time_point wakeAt;
+    u32 nextId;
+    bool stopping;
+
+    std::thread scheduler;
+};
+
+}
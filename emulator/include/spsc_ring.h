@@ -0,0 +1,75 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * Fixed size queue between one producer thread and one consumer thread.
+ *
+ * Push and Pop never wait: they fail when the ring is full or empty. Each
+ * side only writes its own index, published with release semantics, so
+ * neither needs a lock or a read-modify-write. Built on the GCC atomic
+ * builtins like CowMemory, it is usable from an interrupt handler of the
+ * kernel as well as from a thread.
+ */
+template <typename T, u32 Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing()
+        : head(0)
+        , tail(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * Producer: appends value.
+     * @return false when the ring is full, value is not queued
+     */
+    bool Push(const T& value)
+    {
+        u32 next = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        if (next - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) == Capacity) {
+            return false;
+        }
+        items[next & (Capacity - 1)] = value;
+        __atomic_store_n(&head, next + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * Consumer: takes the oldest value.
+     * @return false when the ring is empty
+     */
+    bool Pop(T& value)
+    {
+        u32 next = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        if (next == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        value = items[next & (Capacity - 1)];
+        __atomic_store_n(&tail, next + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * @return the number of values queued, exact from either side only
+     */
+    u32 Size() const
+    {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+
+private:
+    // on separate cache lines, each is written by one side only
+    alignas(64) u32 head;
+    alignas(64) u32 tail;
+    alignas(64) T items[Capacity];
+};
+
+}
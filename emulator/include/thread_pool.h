@@ -0,0 +1,80 @@
+#pragma once
+
+#include "util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Frankenstein {
+
+/**
+ * Fixed set of worker threads running short tasks.
+ *
+ * Every worker has its own queue: tasks submitted by a worker go to its own
+ * queue and it runs them last in first out, while the tasks submitted from
+ * other threads are spread over the queues. An idle worker steals the
+ * oldest task of another queue, so a worker stuck on a long task does not
+ * delay the ones queued behind it.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @param threads number of workers, 0 for one per hardware thread
+     * @param pin     bind worker n to the nth CPU (Linux only)
+     */
+    explicit ThreadPool(u32 threads = 0, bool pin = false);
+
+    /**
+     * Runs the queued tasks, then stops the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(Task task);
+
+    /**
+     * Blocks until every submitted task has run.
+     */
+    void Wait();
+
+    u32 Size() const;
+
+    /**
+     * @return the number of tasks run by another worker than the one they were queued on
+     */
+    u64 GetSteals() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void WorkerMain(u32 index, bool pin);
+    bool Pop(u32 index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<u32> nextQueue;
+    std::atomic<u64> steals;
+
+    // sleeping workers and Wait, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable idle;
+    u64 pending;        // submitted and not finished yet
+    u64 queued;         // submitted and not started yet
+    bool stopping;
+};
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "util.h"
+
+namespace Frankenstein {
+
+/**
+ * The spans of the timeline, see TraceSink.
+ */
+enum class TraceEvent : u8 {
+    Frame,          // from a vertical blank to the next, the argument is Ppu::Frame
+    Run,            // Nes::RunFrame, Nes::RunCycles or PpuPipeline::RunFrame on the calling thread
+    ScanLines,      // 8 scanlines stepped by the Ppu, the argument is the first one
+    DmaStall,       // the CPU stalled by an OAM DMA, the argument is the page copied
+    Nmi,            // from the NMI to the next RTI
+    TextureUpload,  // frontend: the picture copied to the display
+    Present,        // frontend: the picture shown
+    Count
+};
+
+/**
+ * Receives the spans of the timeline from the thread they happen on, which
+ * takes the time. Begin and End of a span come from the same thread; an End
+ * without its Begin (the first frame, an RTI from BRK) is possible. Called
+ * from the emulation loops, a sink must return quickly and never wait.
+ */
+class TraceSink {
+public:
+    virtual void Begin(TraceEvent event, u32 argument) = 0;
+    virtual void End(TraceEvent event) = 0;
+
+protected:
+    ~TraceSink() {}
+};
+
+}
@@ -120,6 +120,21 @@ inline bool CheckZero(T src){
     return src == 0;
 }
 
+static constexpr u64 FnvOffsetBasis = 0xCBF29CE484222325ULL;
+static constexpr u64 FnvPrime = 0x100000001B3ULL;
+
+/**
+ * 64 bits FNV-1a hash of size bytes starting at data.
+ * Pass a previous result as hash to chain several buffers.
+ */
+inline u64 Fnv1a64(const u8* data, u32 size, u64 hash = FnvOffsetBasis) {
+    for (u32 i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= FnvPrime;
+    }
+    return hash;
+}
+
 
 //sizes related to hardware (in bytes) :
 const u16 NES_PAGE_SIZE = 256;
@@ -0,0 +1,47 @@
+#include "input_snapshot.h"
+
+#include "nes.h"
+
+using namespace Frankenstein;
+
+InputSnapshot::InputSnapshot(Nes& pNes)
+    : nes(pNes)
+    , next{ pNes.pad1.listener, pNes.pad2.listener }
+    , written{ { pNes.pad1.GetButtons(), pNes.pad2.GetButtons() } }
+    , shared(written)
+{
+    nes.pad1.listener = this;
+    nes.pad2.listener = this;
+}
+
+InputSnapshot::~InputSnapshot()
+{
+    nes.pad1.listener = next[0];
+    nes.pad2.listener = next[1];
+}
+
+void InputSnapshot::SetButtons(u8 pad, u8 buttons)
+{
+    written.buttons[pad & 1] = buttons;
+    shared.Store(written);
+}
+
+void InputSnapshot::SetButton(u8 pad, Gamepad::ButtonIndex button, bool pressed)
+{
+    u8 buttons = written.buttons[pad & 1];
+    SetButtons(pad, pressed ? buttons | (1 << button) : buttons & ~(1 << button));
+}
+
+u8 InputSnapshot::GetButtons(u8 pad) const
+{
+    return shared.Load().buttons[pad & 1];
+}
+
+void InputSnapshot::OnLatch(Gamepad& pad)
+{
+    u8 index = &pad == &nes.pad1 ? 0 : 1;
+    pad.SetButtons(shared.Load().buttons[index]);
+    if (next[index] != nullptr) {
+        next[index]->OnLatch(pad);
+    }
+}
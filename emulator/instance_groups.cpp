@@ -0,0 +1,80 @@
+#include "instance_groups.h"
+
+#include "nes.h"
+
+#include <unordered_map>
+
+using namespace Frankenstein;
+
+InstanceGroups::InstanceGroups(Nes& root, u32 count)
+    : instances(count, nullptr)
+    , leaders(count, 0)
+    , pad1Buttons(count, 0)
+    , pad2Buttons(count, 0)
+    , emulated(0)
+{
+    if (count > 0) {
+        instances[0] = root.Fork();
+    }
+}
+
+InstanceGroups::~InstanceGroups()
+{
+    for (Nes* nes : instances) {
+        delete nes;
+    }
+}
+
+u32 InstanceGroups::Size() const
+{
+    return instances.size();
+}
+
+void InstanceGroups::SetButtons(u32 index, u8 pad1, u8 pad2)
+{
+    pad1Buttons[index] = pad1;
+    pad2Buttons[index] = pad2;
+}
+
+void InstanceGroups::RunFrame()
+{
+    Regroup();
+
+    emulated = 0;
+    for (u32 i = 0; i < instances.size(); ++i) {
+        if (leaders[i] == i) {
+            Nes& nes = *instances[i];
+            nes.pad1.SetButtons(pad1Buttons[i]);
+            nes.pad2.SetButtons(pad2Buttons[i]);
+            nes.RunFrame();
+            emulated++;
+        }
+    }
+}
+
+const Nes& InstanceGroups::Get(u32 index) const
+{
+    return *instances[leaders[index]];
+}
+
+u32 InstanceGroups::GetEmulated() const
+{
+    return emulated;
+}
+
+void InstanceGroups::Regroup()
+{
+    // a group splits by buttons, the first instance with new buttons leads the others
+    std::unordered_map<u64, u32> groups;
+    for (u32 i = 0; i < instances.size(); ++i) {
+        u32 previous = leaders[i];
+        u64 key = (u64(previous) << 16) | (u32(pad1Buttons[i]) << 8) | pad2Buttons[i];
+        auto group = groups.emplace(key, i).first;
+        u32 leader = group->second;
+        if (leader == i && previous != i) {
+            // the machines are still identical, the new leader starts from a fork
+            instances[i] = instances[previous]->Fork();
+        }
+        leaders[i] = leader;
+    }
+}
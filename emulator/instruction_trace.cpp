@@ -0,0 +1,265 @@
+#include "instruction_trace.h"
+
+#include "nes.h"
+#include "pack_bits.h"
+
+#include <cstring>
+
+using namespace Frankenstein;
+
+static_assert(sizeof(InstructionTrace::Record) == 24, "the records are written as they are");
+
+constexpr u32 InstructionTrace::Magic;
+constexpr u32 InstructionTrace::Version;
+constexpr u32 InstructionTrace::MaxBlocks;
+
+InstructionTrace::InstructionTrace(Nes& pNes, const std::string& path, bool pCompress, u64 pCycle, u32 pBlockRecords)
+    : nes(pNes)
+    , file(fopen(path.c_str(), "wb"))
+    , compress(pCompress)
+    , blockRecords(pBlockRecords > 0 ? pBlockRecords : 1)
+    , cycle(pCycle)
+    , records(0)
+    , waits(0)
+    , current(new Block())
+    , blocks(1)
+    , stopping(false)
+{
+    current->reserve(blockRecords);
+    if (file == nullptr) {
+        return;
+    }
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.romHash = nes.rom.GetHash();
+    header.recordSize = sizeof(Record);
+    header.compressed = compress ? 1 : 0;
+    fwrite(&header, sizeof(header), 1, file);
+    writer = std::thread(&InstructionTrace::WriterMain, this);
+}
+
+InstructionTrace::~InstructionTrace()
+{
+    if (file == nullptr) {
+        return;
+    }
+    if (!current->empty()) {
+        Submit();
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    writer.join();
+    fclose(file);
+}
+
+bool InstructionTrace::IsOpen() const
+{
+    return file != nullptr;
+}
+
+void InstructionTrace::Step()
+{
+    Cpu& cpu = nes.cpu;
+    if (file != nullptr && cpu.stall == 0 && !cpu.nmiOccurred) {
+        Record record;
+        record.cycle = cycle;
+        record.pc = cpu.registers.PC;
+        record.scanLine = u16(nes.ppu.ScanLine);
+        record.dot = u16(nes.ppu.Cycle);
+        for (int i = 0; i < 3; ++i) {
+            record.bytes[i] = cpu.Operand(i);
+        }
+        record.a = cpu.registers.A;
+        record.x = cpu.registers.X;
+        record.y = cpu.registers.Y;
+        record.p = cpu.registers.P;
+        record.sp = cpu.registers.SP;
+        record.reserved[0] = 0;
+        record.reserved[1] = 0;
+        current->push_back(record);
+        records++;
+        if (current->size() == blockRecords) {
+            Submit();
+        }
+    }
+    nes.Step();
+    cycle += cpu.cycles;
+}
+
+u64 InstructionTrace::GetRecords() const
+{
+    return records;
+}
+
+u64 InstructionTrace::GetWaits() const
+{
+    return waits;
+}
+
+u32 InstructionTrace::Bound(u32 count)
+{
+    return PackBits::Bound(count * sizeof(Record));
+}
+
+u32 InstructionTrace::Compress(const Record* records, u32 count, u8* destination)
+{
+    const u32 size = sizeof(Record);
+    std::vector<u8> planes(count * size);
+    u8 previous[size] = { 0 };
+    for (u32 i = 0; i < count; ++i) {
+        const u8* bytes = reinterpret_cast<const u8*>(&records[i]);
+        for (u32 b = 0; b < size; ++b) {
+            planes[b * count + i] = bytes[b] ^ previous[b];
+            previous[b] = bytes[b];
+        }
+    }
+    return PackBits::Compress(planes.data(), count * size, destination);
+}
+
+u32 InstructionTrace::Decompress(const u8* source, u32 size, Record* records, u32 capacity)
+{
+    const u32 recordSize = sizeof(Record);
+    std::vector<u8> planes(capacity * recordSize);
+    u32 unpacked = PackBits::Decompress(source, size, planes.data(), capacity * recordSize);
+    if (unpacked == 0 || unpacked % recordSize != 0) {
+        return 0;
+    }
+    u32 count = unpacked / recordSize;
+    u8 previous[recordSize] = { 0 };
+    for (u32 i = 0; i < count; ++i) {
+        u8* bytes = reinterpret_cast<u8*>(&records[i]);
+        for (u32 b = 0; b < recordSize; ++b) {
+            bytes[b] = planes[b * count + i] ^ previous[b];
+            previous[b] = bytes[b];
+        }
+    }
+    return count;
+}
+
+void InstructionTrace::Submit()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    full.push_back(std::move(current));
+    wakeUp.notify_one();
+    if (spare.empty() && blocks < MaxBlocks) {
+        current.reset(new Block());
+        current->reserve(blockRecords);
+        blocks++;
+        return;
+    }
+    if (spare.empty()) {
+        waits++;
+        released.wait(lock, [this] { return !spare.empty(); });
+    }
+    current = std::move(spare.back());
+    spare.pop_back();
+}
+
+void InstructionTrace::WriterMain()
+{
+    std::vector<u8> packed;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeUp.wait(lock, [this] { return !full.empty() || stopping; });
+        if (full.empty()) {
+            break;
+        }
+        std::unique_ptr<Block> block = std::move(full.front());
+        full.pop_front();
+        lock.unlock();
+
+        BlockHeader header;
+        header.records = u32(block->size());
+        if (compress) {
+            packed.resize(Bound(header.records));
+            header.size = Compress(block->data(), header.records, packed.data());
+            fwrite(&header, sizeof(header), 1, file);
+            fwrite(packed.data(), 1, header.size, file);
+        } else {
+            header.size = header.records * sizeof(Record);
+            fwrite(&header, sizeof(header), 1, file);
+            fwrite(block->data(), sizeof(Record), header.records, file);
+        }
+        block->clear();
+
+        lock.lock();
+        spare.push_back(std::move(block));
+        released.notify_one();
+    }
+}
+
+InstructionTraceReader::InstructionTraceReader()
+    : file(nullptr)
+    , position(0)
+{
+}
+
+InstructionTraceReader::~InstructionTraceReader()
+{
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool InstructionTraceReader::Open(const std::string& path)
+{
+    if (file != nullptr) {
+        fclose(file);
+    }
+    block.clear();
+    position = 0;
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != InstructionTrace::Magic
+        || header.version != InstructionTrace::Version || header.recordSize != sizeof(InstructionTrace::Record)) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool InstructionTraceReader::Next(InstructionTrace::Record& record)
+{
+    while (position == block.size()) {
+        if (!ReadBlock()) {
+            return false;
+        }
+    }
+    record = block[position++];
+    return true;
+}
+
+const InstructionTrace::Header& InstructionTraceReader::GetHeader() const
+{
+    return header;
+}
+
+bool InstructionTraceReader::ReadBlock()
+{
+    InstructionTrace::BlockHeader blockHeader;
+    if (file == nullptr || fread(&blockHeader, sizeof(blockHeader), 1, file) != 1) {
+        return false;
+    }
+    // a writer never makes blocks of more than 16M records
+    if (blockHeader.records > (1u << 24) || blockHeader.size > InstructionTrace::Bound(blockHeader.records)) {
+        return false;
+    }
+    block.resize(blockHeader.records);
+    position = 0;
+    if (header.compressed == 0) {
+        return blockHeader.size == blockHeader.records * sizeof(InstructionTrace::Record)
+            && fread(block.data(), sizeof(InstructionTrace::Record), blockHeader.records, file) == blockHeader.records;
+    }
+    packed.resize(blockHeader.size);
+    if (fread(packed.data(), 1, blockHeader.size, file) != blockHeader.size) {
+        return false;
+    }
+    return InstructionTrace::Decompress(packed.data(), blockHeader.size, block.data(), blockHeader.records) == blockHeader.records;
+}
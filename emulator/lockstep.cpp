@@ -0,0 +1,429 @@
+#include "lockstep.h"
+
+#include "cpu.h"
+#include "nes.h"
+
+#include <cstddef>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace Frankenstein;
+
+namespace {
+
+// the parts of a NesState in order, the header is not compared
+struct Range {
+    u32 offset;
+    u32 size;
+    Lockstep::Part part;
+};
+
+const Range Ranges[] = {
+    { offsetof(NesState, cpu), sizeof(NesState::CpuBlock), Lockstep::Registers },
+    { offsetof(NesState, ppu), sizeof(NesState::PpuBlock), Lockstep::Ppu },
+    { offsetof(NesState, pads), offsetof(NesState, paletteData) - offsetof(NesState, pads), Lockstep::Ram },
+    { offsetof(NesState, paletteData), sizeof(NesState) - offsetof(NesState, paletteData), Lockstep::Ppu },
+};
+
+u32 FirstDifference(const u8* a, const u8* b, u32 size)
+{
+    for (u32 i = 0; i < size; ++i) {
+        if (a[i] != b[i]) {
+            return i;
+        }
+    }
+    return size;
+}
+
+//
+// Random programs
+//
+
+const u16 ResetAddress = 0xC000;
+const u16 NmiAddress = 0xD000;
+const u16 IrqAddress = 0xE000;
+const u32 PrgSize = 0x4000;     // one bank, mirrored at $8000 and $C000
+const u32 ChrSize = 0x2000;
+
+const u8 NOP = 0xEA;
+const u8 RTI = 0x40;
+const u8 JMP_ABS = 0x4C;
+
+enum class Operand : u8 {
+    None,
+    Byte,                       // immediate or zero page
+    Address,                    // absolute
+    Branch,
+};
+
+struct Instruction {
+    u8 opcode;
+    Operand operand;
+    u8 value;                   // Byte
+    u16 address;                // Address
+    u32 target;                 // Branch, index of the instruction to jump to
+};
+
+bool EndsWith(const std::string& text, const char* suffix)
+{
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+Operand GetOperand(const std::string& name)
+{
+    if (EndsWith(name, "_ABS") || EndsWith(name, "_ABS_X") || EndsWith(name, "_ABS_Y")) {
+        return Operand::Address;
+    }
+    if (EndsWith(name, "_IMM") || EndsWith(name, "_ZP") || EndsWith(name, "_ZP_X") || EndsWith(name, "_ZP_Y")
+        || EndsWith(name, "_IND_X") || EndsWith(name, "_IND_Y")) {
+        return Operand::Byte;
+    }
+    if (name.size() == 3 && name[0] == 'B' && name != "BRK") {
+        return Operand::Branch;
+    }
+    return Operand::None;
+}
+
+u32 GetSize(Operand operand)
+{
+    switch (operand) {
+    case Operand::None:
+        return 1;
+    case Operand::Address:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+// the official opcodes which neither leave the program nor move the stack
+// pointer, the stack ones too when stack is set
+std::vector<u8> GetOpcodes(bool stack)
+{
+    std::vector<u8> opcodes;
+    for (u32 opcode = 0; opcode < 256; ++opcode) {
+        std::string name(Cpu::instructions[opcode].name);
+        bool flow = name == "BRK" || name.compare(0, 3, "JMP") == 0 || name == "JSR" || name == "RTS" || name == "RTI";
+        bool pushes = name == "PHA" || name == "PHP" || name == "PLA" || name == "PLP";
+        if (name == "UNIMP" || (name == "NOP" && opcode != NOP) || flow || name == "TXS" || (pushes && !stack)) {
+            continue;
+        }
+        opcodes.push_back(u8(opcode));
+    }
+    return opcodes;
+}
+
+u16 RandomAddress(std::mt19937_64& random)
+{
+    u32 kind = random() % 16;
+    if (kind < 9) {
+        return u16(0x0200 + random() % 0x600);
+    }
+    if (kind < 13) {
+        return u16(0x2000 + random() % 8);
+    }
+    if (kind == 13) {
+        return 0x4014;
+    }
+    if (kind == 14) {
+        return 0x4016;
+    }
+    return u16(0x6000 + random() % 0x2000);
+}
+
+std::vector<Instruction> RandomBody(std::mt19937_64& random, const std::vector<u8>& opcodes, u32 count)
+{
+    std::vector<Instruction> body(count);
+    for (u32 i = 0; i < count; ++i) {
+        Instruction& instruction = body[i];
+        instruction.opcode = opcodes[random() % opcodes.size()];
+        instruction.operand = GetOperand(Cpu::instructions[instruction.opcode].name);
+        instruction.value = u8(random());
+        instruction.address = RandomAddress(random);
+        // forward, over at most 8 instructions of 3 bytes: always in range
+        instruction.target = i + 1 + u32(random() % 8);
+        if (instruction.target > count) {
+            instruction.target = count;
+        }
+    }
+    return body;
+}
+
+// assembles body at address
+// @return the offset in prg after the body
+u32 Assemble(const std::vector<Instruction>& body, u8* prg, u16 address)
+{
+    std::vector<u32> offsets(body.size() + 1);
+    u32 offset = address & (PrgSize - 1);
+    for (size_t i = 0; i < body.size(); ++i) {
+        offsets[i] = offset;
+        offset += GetSize(body[i].operand);
+    }
+    offsets[body.size()] = offset;
+
+    for (size_t i = 0; i < body.size(); ++i) {
+        const Instruction& instruction = body[i];
+        u8* bytes = prg + offsets[i];
+        bytes[0] = instruction.opcode;
+        switch (instruction.operand) {
+        case Operand::None:
+            break;
+        case Operand::Byte:
+            bytes[1] = instruction.value;
+            break;
+        case Operand::Address:
+            bytes[1] = u8(instruction.address);
+            bytes[2] = u8(instruction.address >> 8);
+            break;
+        case Operand::Branch:
+            bytes[1] = u8(offsets[instruction.target] - (offsets[i] + 2));
+            break;
+        }
+    }
+    return offset;
+}
+
+}
+
+LockstepCore::LockstepCore(Nes& pNes)
+    : nes(pNes)
+{
+}
+
+LockstepCore::~LockstepCore()
+{
+}
+
+Nes& LockstepCore::GetNes()
+{
+    return nes;
+}
+
+void LockstepCore::Step()
+{
+    nes.Step();
+}
+
+void LockstepCore::Sync()
+{
+}
+
+PipelineCore::PipelineCore(Nes& pNes)
+    : LockstepCore(pNes)
+    , pipeline(pNes)
+{
+}
+
+void PipelineCore::Step()
+{
+    pipeline.Step();
+}
+
+void PipelineCore::Sync()
+{
+    pipeline.Sync();
+}
+
+Lockstep::Lockstep(Nes& pReference, LockstepCore& pCandidate, Granularity pGranularity, u64 pFrom, u32 window)
+    : reference(pReference)
+    , candidate(pCandidate)
+    , granularity(pGranularity)
+    , from(pFrom)
+    , instructions(0)
+    , comparisons(0)
+    , frame(pReference.ppu.Frame)
+    , scanLine(pReference.ppu.ScanLine)
+    , diverged(false)
+{
+    memset(&divergence, 0, sizeof(divergence));
+    referenceRing.records.resize(window > 0 ? window : 1);
+    referenceRing.count = 0;
+    candidateRing.records.resize(referenceRing.records.size());
+    candidateRing.count = 0;
+    memset(referenceState, 0, sizeof(referenceState));
+    memset(candidateState, 0, sizeof(candidateState));
+}
+
+bool Lockstep::Step()
+{
+    if (diverged) {
+        return false;
+    }
+    Capture(reference, referenceRing);
+    Capture(candidate.GetNes(), candidateRing);
+    reference.Step();
+    candidate.Step();
+    instructions++;
+
+    bool end = true;
+    switch (granularity) {
+    case Granularity::Instruction:
+        break;
+    case Granularity::ScanLine:
+        end = reference.ppu.ScanLine != scanLine || reference.ppu.Frame != frame;
+        break;
+    case Granularity::Frame:
+        end = reference.ppu.Frame != frame;
+        break;
+    }
+    frame = reference.ppu.Frame;
+    scanLine = reference.ppu.ScanLine;
+    if (end && instructions > from) {
+        return Compare();
+    }
+    return true;
+}
+
+bool Lockstep::RunFrame()
+{
+    u64 start = reference.ppu.Frame;
+    while (reference.ppu.Frame == start) {
+        if (!Step()) {
+            return false;
+        }
+    }
+    candidate.Sync();
+    return true;
+}
+
+bool Lockstep::HasDiverged() const
+{
+    return diverged;
+}
+
+const Lockstep::Divergence& Lockstep::GetDivergence() const
+{
+    return divergence;
+}
+
+u64 Lockstep::GetInstructions() const
+{
+    return instructions;
+}
+
+u64 Lockstep::GetComparisons() const
+{
+    return comparisons;
+}
+
+std::vector<InstructionTrace::Record> Lockstep::GetWindow(bool fromCandidate) const
+{
+    const Ring& ring = fromCandidate ? candidateRing : referenceRing;
+    u64 size = ring.records.size();
+    u64 count = ring.count < size ? ring.count : size;
+    std::vector<InstructionTrace::Record> records;
+    records.reserve(count);
+    for (u64 i = ring.count - count; i < ring.count; ++i) {
+        records.push_back(ring.records[i % size]);
+    }
+    return records;
+}
+
+Lockstep::Hashes Lockstep::Hash(const NesState& state)
+{
+    Hashes hashes{ FnvOffsetBasis, FnvOffsetBasis, FnvOffsetBasis };
+    const u8* bytes = reinterpret_cast<const u8*>(&state);
+    for (const Range& range : Ranges) {
+        u64& hash = range.part == Registers ? hashes.registers : range.part == Ram ? hashes.ram : hashes.ppu;
+        hash = Fnv1a64(bytes + range.offset, range.size, hash);
+    }
+    return hashes;
+}
+
+void Lockstep::Capture(Nes& nes, Ring& ring)
+{
+    Cpu& cpu = nes.cpu;
+    if (cpu.stall != 0 || cpu.nmiOccurred) {
+        return;
+    }
+    InstructionTrace::Record& record = ring.records[ring.count % ring.records.size()];
+    record.cycle = 0;
+    record.pc = cpu.registers.PC;
+    record.scanLine = u16(reference.ppu.ScanLine);
+    record.dot = u16(reference.ppu.Cycle);
+    for (int i = 0; i < 3; ++i) {
+        record.bytes[i] = cpu.Operand(i);
+    }
+    record.a = cpu.registers.A;
+    record.x = cpu.registers.X;
+    record.y = cpu.registers.Y;
+    record.p = cpu.registers.P;
+    record.sp = cpu.registers.SP;
+    record.reserved[0] = 0;
+    record.reserved[1] = 0;
+    ring.count++;
+}
+
+bool Lockstep::Compare()
+{
+    candidate.Sync();
+    reference.SaveState(referenceState);
+    candidate.GetNes().SaveState(candidateState);
+    comparisons++;
+
+    u8 parts = 0;
+    u32 offset = sizeof(NesState);
+    for (const Range& range : Ranges) {
+        u32 first = FirstDifference(referenceState + range.offset, candidateState + range.offset, range.size);
+        if (first < range.size) {
+            parts |= range.part;
+            if (offset == sizeof(NesState)) {
+                offset = range.offset + first;
+            }
+        }
+    }
+    if (parts == 0) {
+        divergence.lastMatch = instructions;
+        return true;
+    }
+
+    diverged = true;
+    divergence.instruction = instructions;
+    divergence.frame = reference.ppu.Frame;
+    divergence.scanLine = reference.ppu.ScanLine;
+    divergence.dot = reference.ppu.Cycle;
+    divergence.parts = parts;
+    divergence.offset = offset;
+    divergence.reference = Hash(*reinterpret_cast<const NesState*>(referenceState));
+    divergence.candidate = Hash(*reinterpret_cast<const NesState*>(candidateState));
+    return false;
+}
+
+std::vector<u8> Lockstep::MakeFuzzRom(u64 seed, u32 count)
+{
+    std::mt19937_64 random(seed);
+    std::vector<u8> image(Rom::HeaderSize + PrgSize + ChrSize, 0);
+    const u8 header[] = { 'N', 'E', 'S', 0x1A, 1, 1 };  // one 16 KB PRG bank, one 8 KB CHR bank, mapper 0
+    memcpy(image.data(), header, sizeof(header));
+    u8* prg = image.data() + Rom::HeaderSize;
+    u8* chr = prg + PrgSize;
+    memset(prg, NOP, PrgSize);
+    for (u32 i = 0; i < ChrSize; ++i) {
+        chr[i] = u8(random());
+    }
+
+    // SEI, CLD, LDX #$FF, TXS, then the NMI (LDA #$80, STA $2000) and the
+    // rendering (LDA #$1E, STA $2001) on
+    const u8 reset[] = { 0x78, 0xD8, 0xA2, 0xFF, 0x9A, 0xA9, 0x80, 0x8D, 0x00, 0x20, 0xA9, 0x1E, 0x8D, 0x01, 0x20 };
+    u32 offset = ResetAddress & (PrgSize - 1);
+    memcpy(prg + offset, reset, sizeof(reset));
+    u16 loop = u16(ResetAddress + sizeof(reset));
+    offset = Assemble(RandomBody(random, GetOpcodes(true), count), prg, loop);
+    prg[offset] = JMP_ABS;
+    prg[offset + 1] = u8(loop);
+    prg[offset + 2] = u8(loop >> 8);
+
+    // the handler must leave the stack as it found it, for its RTI
+    offset = Assemble(RandomBody(random, GetOpcodes(false), count / 4 + 1), prg, NmiAddress);
+    prg[offset] = RTI;
+    prg[IrqAddress & (PrgSize - 1)] = RTI;
+
+    const u16 vectors[] = { NmiAddress, ResetAddress, IrqAddress };
+    for (u32 i = 0; i < 3; ++i) {
+        prg[PrgSize - 6 + i * 2] = u8(vectors[i]);
+        prg[PrgSize - 5 + i * 2] = u8(vectors[i] >> 8);
+    }
+    return image;
+}
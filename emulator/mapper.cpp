@@ -2,6 +2,9 @@
 
 using namespace Frankenstein;
 
+// pure virtual, but still called by the destructors of the derived classes
+Mapper::~Mapper() {}
+
 /**********************************************/
 /***************** MAPPER 1 *******************/
 /**********************************************/
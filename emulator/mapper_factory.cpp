@@ -11,12 +11,7 @@ Mapper* MapperFactory::MakeMapper(u8 mapper, Rom& rom)
         return new Mapper1(rom);
     case 2:
         return new Mapper2(rom);
-    case 3:
-        return new Mapper3();
-    case 4:
-        return new Mapper4();
-    case 7:
-        return new Mapper7();
     }
+    // Mapper3, Mapper4 and Mapper7 are stubs yet
     return nullptr;
 }
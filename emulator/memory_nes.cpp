@@ -6,8 +6,17 @@ namespace Frankenstein {
 
 template <>
 NesMemory::Memory(Nes& pNes)
-    : raw{ 0 }
+    : raw()
     , nes(pNes)
+    , dirtySramPages(0)
+{
+}
+
+template <>
+NesMemory::Memory(Nes& pNes, const NesMemory& parent)
+    : raw(parent.raw)
+    , nes(pNes)
+    , dirtySramPages(0)
 {
 }
 
@@ -17,8 +26,29 @@ NesMemory::Ref NesMemory::operator[](const u16 addr)
     return Ref(addr, this);
 }
 
+template <>
+u8 NesMemory::Fetch(const u16 address)
+{
+    // code runs from the cartridge almost always, nothing to decode there
+    if (address >= ADDR_PRG_ROM_LOWER_BANK) {
+        return raw[address];
+    }
+    return ReadDevice(address);
+}
+
 template <>
 u8 NesMemory::Read(const u16 address)
+{
+    if (nes.bus.IsWatched(address, Bus::Read)) {
+        u8 value = ReadDevice(address);
+        nes.bus.NotifyRead(address, value);
+        return value;
+    }
+    return ReadDevice(address);
+}
+
+template <>
+u8 NesMemory::ReadDevice(const u16 address)
 {
     // $0000-$07FF; With mirrors $0800-$0FFF, $1000-$17FF, $1800-$1FFF; Internal RAM
     if (address < 0x2000) {
@@ -26,6 +56,9 @@ u8 NesMemory::Read(const u16 address)
     }
     // $2000-$2007; With mirrors $2008-$3FFF; NES PPU registers
     else if (address < 0x4000) {
+        if (nes.ppu.port != nullptr) {
+            return nes.ppu.port->ReadRegister(address & 0x2007);
+        }
         return nes.ppu.readRegister(address & 0x2007);
     }
     // $4014; PPU DMA
@@ -48,6 +81,9 @@ u8 NesMemory::Read(const u16 address)
     //else {
     //    return raw[address];
     //}
+#ifdef WithCdl
+    nes.cdl.MarkPrg(address, CodeDataLog::Data);
+#endif
     return raw[address];
 }
 
@@ -56,29 +92,87 @@ void NesMemory::Write(const u16 address, const u8 val)
 {
     // $0800-$0FFF, $1000-$17FF, $1800-$1FFF are mirrors of $0000-$07FF; Internal RAM
     if (address < 0x2000) {
-        raw[address & 0x07FF] = val;
+        raw.Write(address & 0x07FF, val);
     }
     //$2008-$3FFF are Mirrors of $2000-2007; NES PPU registers
-    else if (address < 0x4000) {
-        nes.ppu.writeRegister(address & 0x2007, val);
-    }
-    // $4014; PPU DMA
-    else if (address == 0x4014) {
-        nes.ppu.writeRegister(address, val);
+    else if (address < 0x4000 || address == 0x4014) {
+        // $4014; PPU DMA
+        u16 ppuAddress = address == 0x4014 ? address : address & 0x2007;
+#ifdef WithStats
+        // on the CPU side, a PpuPipeline copies the DMA bytes itself
+        if (address == 0x4014) {
+            nes.stats.current.oamDmas++;
+        }
+#endif
+        if (nes.ppu.port != nullptr) {
+            nes.ppu.port->WriteRegister(ppuAddress, val);
+        } else {
+            nes.ppu.writeRegister(ppuAddress, val);
+        }
     }
     // $4000-$4017; NES APU and I/O registers
     else if (address == 0x4016) {
-            nes.pad1.Write(raw[address]);
-            nes.pad2.Write(raw[address]);
+            nes.pad1.Write(val);
+            nes.pad2.Write(val);
+    }
+    // $6000-$7FFF; Cartridge PRG RAM, battery backed on some cartridges
+    else if (address >= ADDR_SRAM && address < ADDR_PRG_ROM_LOWER_BANK) {
+        raw.Write(address, val);
+        dirtySramPages |= 1u << ((address - ADDR_SRAM) >> 8);
     } else {
-        raw[address] = val;
+        raw.Write(address, val);
+    }
+    if (nes.bus.IsWatched(address, Bus::Write)) {
+        nes.bus.NotifyWrite(address, val);
     }
 }
 
 template <>
 void NesMemory::Copy(const u8* source, const u16 destination, const unsigned int size)
 {
-    memcpy(&raw[destination], source, size);
+    raw.Copy(source, destination, size);
+}
+
+template <>
+void NesMemory::CopyTo(const u16 source, u8* destination, const unsigned int size) const
+{
+    raw.CopyTo(source, destination, size);
+}
+
+template <>
+u32 NesMemory::SharedPages() const
+{
+    return raw.SharedPages();
+}
+
+template <>
+u32 NesMemory::PrivatePages() const
+{
+    return raw.PrivatePages();
+}
+
+template <>
+u32 NesMemory::TakeDirtySramPages()
+{
+    u32 pages = dirtySramPages;
+    dirtySramPages = 0;
+    return pages;
+}
+
+template <>
+void NesMemory::Save(NesState& state) const
+{
+    raw.CopyTo(ADDR_ZERO_PAGE, state.ram, sizeof(state.ram));
+    raw.CopyTo(ADDR_IO_REGISTERS_2, state.io, sizeof(state.io));
+    raw.CopyTo(ADDR_SRAM, state.sram, sizeof(state.sram));
+}
+
+template <>
+void NesMemory::Load(const NesState& state)
+{
+    raw.Copy(state.ram, ADDR_ZERO_PAGE, sizeof(state.ram));
+    raw.Copy(state.io, ADDR_IO_REGISTERS_2, sizeof(state.io));
+    dirtySramPages |= raw.Copy(state.sram, ADDR_SRAM, sizeof(state.sram));
 }
 
 template <>
@@ -210,6 +304,9 @@ template <>
 template <>
 NesMemory::Ref NesMemory::Get<Addressing::PreIndexedIndirect>(const u8 low, const u8 index)
 {
+#ifdef WithCdl
+    nes.cdl.MarkPrg(PreIndexedIndirect(low, index), CodeDataLog::IndirectData);
+#endif
     return this->operator[](NesMemory::PreIndexedIndirect(low, index));
 }
 
@@ -217,6 +314,9 @@ template <>
 template <>
 NesMemory::Ref NesMemory::Get<Addressing::PostIndexedIndirect>(const u8 low, const u8 index)
 {
+#ifdef WithCdl
+    nes.cdl.MarkPrg(PostIndexedIndirect(low, index), CodeDataLog::IndirectData);
+#endif
     return this->operator[](PostIndexedIndirect(low, index));
 }
 }
@@ -0,0 +1,217 @@
+#include "movie.h"
+
+#include "nes.h"
+#include "pack_bits.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace Frankenstein;
+
+constexpr u32 Movie::Magic;
+constexpr u32 Movie::Version;
+constexpr u32 Movie::CheckpointInterval;
+
+Movie::Movie(Nes& pNes)
+    : nes(pNes)
+    , mode(Mode::Idle)
+    , frame(0)
+    , firstMismatch(-1)
+    , length(0)
+    , position(0)
+    , remaining(0)
+{
+}
+
+Movie::~Movie()
+{
+    Stop();
+}
+
+void Movie::Record()
+{
+    Stop();
+    nes.SaveState(initialState);
+    input.clear();
+    latches.clear();
+    checkpoints.clear();
+    frame = 0;
+    firstMismatch = -1;
+
+    mode = Mode::Recording;
+    // the checkpoints hash the picture
+    nes.ppu.AllocateFrameBuffers();
+    nes.pad1.listener = this;
+    nes.pad2.listener = this;
+}
+
+bool Movie::Save(const std::string& path) const
+{
+    std::vector<u8> packedState(PackBits::Bound(sizeof(NesState)));
+    std::vector<u8> packedInput(PackBits::Bound(input.size()));
+
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.romHash = nes.rom.GetHash();
+    header.frames = frame;
+    header.stateSize = PackBits::Compress(initialState, sizeof(NesState), packedState.data());
+    header.inputSize = PackBits::Compress(input.data(), input.size(), packedInput.data());
+    header.inputRawSize = input.size();
+    header.checkpoints = checkpoints.size();
+    header.reserved = 0;
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool valid = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(packedState.data(), 1, header.stateSize, f) == header.stateSize
+        && fwrite(packedInput.data(), 1, header.inputSize, f) == header.inputSize
+        && fwrite(checkpoints.data(), sizeof(u64), header.checkpoints, f) == header.checkpoints;
+    return fclose(f) == 0 && valid;
+}
+
+bool Movie::Play(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    std::vector<u8> data;
+    u8 chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(f);
+
+    Header header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    u64 size = u64(sizeof(header)) + header.stateSize + header.inputSize + u64(header.checkpoints) * sizeof(u64);
+    if (header.magic != Magic || header.version != Version || header.romHash != nes.rom.GetHash() || data.size() != size) {
+        return false;
+    }
+
+    const u8* packed = data.data() + sizeof(header);
+    alignas(8) u8 state[sizeof(NesState)];
+    if (PackBits::Decompress(packed, header.stateSize, state, sizeof(NesState)) != sizeof(NesState)) {
+        return false;
+    }
+    packed += header.stateSize;
+
+    // the raw size is not trusted further than the packed stream can expand
+    if (header.inputRawSize > PackBits::ExpandedBound(header.inputSize)) {
+        return false;
+    }
+    std::vector<u8> stream(header.inputRawSize);
+    if (PackBits::Decompress(packed, header.inputSize, stream.data(), stream.size()) != header.inputRawSize) {
+        return false;
+    }
+    packed += header.inputSize;
+
+    Stop();
+    if (!nes.LoadState(state)) {
+        return false;
+    }
+    memcpy(initialState, state, sizeof(NesState));
+    input.swap(stream);
+    // the hashes follow the packed streams, at any alignment
+    checkpoints.resize(header.checkpoints);
+    if (!checkpoints.empty()) {
+        memcpy(checkpoints.data(), packed, checkpoints.size() * sizeof(u64));
+    }
+    length = header.frames;
+    frame = 0;
+    firstMismatch = -1;
+    position = 0;
+    remaining = 0;
+
+    if (length == 0) {
+        mode = Mode::Finished;
+        return true;
+    }
+    remaining = input[position++];
+    mode = Mode::Playing;
+    nes.ppu.AllocateFrameBuffers();
+    nes.pad1.listener = this;
+    nes.pad2.listener = this;
+    return true;
+}
+
+void Movie::Stop()
+{
+    if (mode == Mode::Recording || mode == Mode::Playing) {
+        nes.pad1.listener = nullptr;
+        nes.pad2.listener = nullptr;
+    }
+    mode = Mode::Idle;
+}
+
+void Movie::EndFrame()
+{
+    if (mode == Mode::Recording) {
+        input.push_back(u8(latches.size()));
+        input.insert(input.end(), latches.begin(), latches.end());
+        latches.clear();
+        frame++;
+        if (frame % CheckpointInterval == 0) {
+            checkpoints.push_back(PictureHash());
+        }
+    } else if (mode == Mode::Playing) {
+        position += remaining;
+        frame++;
+        u32 checkpoint = frame / CheckpointInterval;
+        if (frame % CheckpointInterval == 0 && checkpoint <= checkpoints.size()
+            && firstMismatch < 0 && checkpoints[checkpoint - 1] != PictureHash()) {
+            firstMismatch = frame;
+        }
+        if (frame == length || position >= input.size()) {
+            Stop();
+            mode = Mode::Finished;
+            return;
+        }
+        remaining = input[position++];
+    }
+}
+
+void Movie::OnLatch(Gamepad& pad)
+{
+    if (mode == Mode::Recording) {
+        // a frame record counts its latches on one byte, games only poll a few times per frame
+        if (latches.size() < 255) {
+            latches.push_back(pad.GetButtons());
+        }
+    } else if (mode == Mode::Playing && remaining > 0 && position < input.size()) {
+        pad.SetButtons(input[position++]);
+        remaining--;
+    }
+}
+
+Movie::Mode Movie::GetMode() const
+{
+    return mode;
+}
+
+u32 Movie::GetFrame() const
+{
+    return frame;
+}
+
+u32 Movie::GetLength() const
+{
+    return mode == Mode::Recording ? frame : length;
+}
+
+s32 Movie::GetFirstMismatch() const
+{
+    return firstMismatch;
+}
+
+u64 Movie::PictureHash() const
+{
+    return Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+}
@@ -3,15 +3,135 @@
 
 using namespace Frankenstein;
 
-Nes::Nes(Rom &pRom) : pad1(), pad2(), ram(*this), rom(pRom), cpu(*this), ppu(*this){
+constexpr u32 NesState::Magic;
+constexpr u32 NesState::Version;
+
+Nes::Nes(Rom &pRom) : pad1(), pad2(), ram(*this), rom(pRom),
+#ifdef WithCdl
+    cdl(pRom),
+#endif
+    bus(*this), cpu(*this), ppu(*this){
     screen = nullptr;
+    frameListener = nullptr;
+    tracer = nullptr;
 }
 
-Nes::Nes(Rom &pRom, CScreenDevice* pScreen) : pad1(), pad2(), ram(*this), rom(pRom), cpu(*this), ppu(*this){
+Nes::Nes(Rom &pRom, CScreenDevice* pScreen) : pad1(), pad2(), ram(*this), rom(pRom),
+#ifdef WithCdl
+    cdl(pRom),
+#endif
+    bus(*this), cpu(*this), ppu(*this){
     screen = pScreen;
+    frameListener = nullptr;
+    tracer = nullptr;
+}
+
+Nes::Nes(Nes& parent, const Rom& pRom) : pad1(parent.pad1), pad2(parent.pad2), ram(*this, parent.ram), rom(pRom),
+#ifdef WithCdl
+    cdl(pRom),
+#endif
+    bus(*this), cpu(*this, parent.cpu), ppu(*this, parent.ppu){
+    screen = parent.screen;
+    frameListener = nullptr;
+    tracer = nullptr;
+    pad1.listener = nullptr;
+    pad2.listener = nullptr;
+}
+
+Nes* Nes::Fork()
+{
+    return new Nes(*this, rom);
+}
+
+u32 Nes::SaveState(u8* buffer) const
+{
+    NesState& state = *reinterpret_cast<NesState*>(buffer);
+    state.header.magic = NesState::Magic;
+    state.header.version = NesState::Version;
+    state.header.size = sizeof(NesState);
+    state.header.reserved = 0;
+    cpu.Save(state);
+    ppu.Save(state);
+    ram.Save(state);
+    pad1.Save(state.pads[0]);
+    pad2.Save(state.pads[1]);
+    return sizeof(NesState);
+}
+
+bool Nes::LoadState(const u8* buffer)
+{
+    const NesState& state = *reinterpret_cast<const NesState*>(buffer);
+    if (state.header.magic != NesState::Magic || state.header.version != NesState::Version
+        || state.header.size != sizeof(NesState)) {
+        return false;
+    }
+    cpu.Load(state);
+    ppu.Load(state);
+    ram.Load(state);
+    pad1.Load(state.pads[0]);
+    pad2.Load(state.pads[1]);
+    return true;
+}
+
+u32 Nes::MemoryReport::Total() const
+{
+    return object + ram + vram + frameBuffers;
+}
+
+Nes::MemoryReport Nes::GetMemoryReport() const
+{
+    MemoryReport report;
+    report.object = sizeof(Nes);
+    report.ram = ram.PrivatePages() * sizeof(CowPage);
+    report.vram = (ppu.nameTableData.PrivatePages() + ppu.chrData.PrivatePages()) * sizeof(CowPage);
+    report.frameBuffers = ppu.front != nullptr ? 2 * 256 * 240 * sizeof(Ppu::RGBColor) : 0;
+    report.shared = (ram.SharedPages() + ppu.nameTableData.SharedPages() + ppu.chrData.SharedPages()) * NES_PAGE_SIZE;
+    return report;
+}
+
+void Nes::RunFrame()
+{
+    u64 frame = ppu.Frame;
+    if (tracer != nullptr) {
+        tracer->Begin(TraceEvent::Run, u32(frame));
+    }
+    while (ppu.Frame == frame) {
+        Step();
+    }
+    if (tracer != nullptr) {
+        tracer->End(TraceEvent::Run);
+    }
+}
+
+u32 Nes::RunCycles(u32 cycles)
+{
+    if (tracer != nullptr) {
+        tracer->Begin(TraceEvent::Run, u32(ppu.Frame));
+    }
+    u32 elapsed = 0;
+    while (elapsed < cycles) {
+        Step();
+        elapsed += cpu.cycles;
+    }
+    if (tracer != nullptr) {
+        tracer->End(TraceEvent::Run);
+    }
+    return elapsed;
 }
 
 void Nes::Step(){
+#ifdef WithStats
+    if (stats.SampleStep()) {
+        u64 begin = NesStats::Now();
+        cpu.Step();
+        u64 middle = NesStats::Now();
+        for(u16 i = 0; i < (cpu.cycles * 3); ++i) {
+            ppu.Step();
+        }
+        stats.AddSample(middle - begin, NesStats::Now() - middle);
+        return;
+    }
+#endif
     cpu.Step();
     for(u16 i = 0; i < (cpu.cycles * 3); ++i) {
         ppu.Step();
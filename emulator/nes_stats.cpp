@@ -0,0 +1,103 @@
+#include "nes_stats.h"
+
+#include "dependencies.h"
+
+#ifndef NotNative
+    #include <chrono>
+#else
+    #include <circle/timer.h>
+#endif
+
+using namespace Frankenstein;
+
+constexpr u32 NesStats::History;
+constexpr u32 NesStats::SampleInterval;
+
+NesStats::NesStats()
+    : ended(0)
+    , sampledCpu(0)
+    , sampledPpu(0)
+    , sampledSteps(0)
+    , steps(0)
+    , countdown(1)
+    , seed(1)
+{
+    memset(&current, 0, sizeof(current));
+    memset(&ppuCurrent, 0, sizeof(ppuCurrent));
+    memset(frames, 0, sizeof(frames));
+}
+
+void NesStats::EndFrame(u64 frame)
+{
+    Add(current, ppuCurrent);
+    current.frame = frame;
+    if (sampledSteps > 0) {
+        current.cpuNanoseconds = sampledCpu * steps / sampledSteps;
+        current.ppuNanoseconds = sampledPpu * steps / sampledSteps;
+    }
+    frames[ended % History] = current;
+    ended++;
+    memset(&current, 0, sizeof(current));
+    memset(&ppuCurrent, 0, sizeof(ppuCurrent));
+    sampledCpu = 0;
+    sampledPpu = 0;
+    sampledSteps = 0;
+    steps = 0;
+}
+
+u64 NesStats::GetFrames() const
+{
+    return ended;
+}
+
+const FrameStats& NesStats::Last(u32 age) const
+{
+    return frames[(ended - 1 - age) % History];
+}
+
+FrameStats NesStats::Sum(u32 count) const
+{
+    FrameStats sum;
+    memset(&sum, 0, sizeof(sum));
+    for (u32 age = 0; age < count; ++age) {
+        Add(sum, Last(age));
+    }
+    if (count > 0) {
+        sum.frame = Last(0).frame;
+    }
+    return sum;
+}
+
+void NesStats::Add(FrameStats& sum, const FrameStats& frame)
+{
+    sum.instructions += frame.instructions;
+    sum.cpuCycles += frame.cpuCycles;
+    sum.dmaStallCycles += frame.dmaStallCycles;
+    for (u32 i = 0; i < 8; ++i) {
+        sum.registerReads[i] += frame.registerReads[i];
+        sum.registerWrites[i] += frame.registerWrites[i];
+    }
+    sum.oamDmas += frame.oamDmas;
+    sum.statusPolls += frame.statusPolls;
+    sum.nmis += frame.nmis;
+    sum.spriteOverflowLines += frame.spriteOverflowLines;
+    sum.cpuNanoseconds += frame.cpuNanoseconds;
+    sum.ppuNanoseconds += frame.ppuNanoseconds;
+}
+
+u64 NesStats::Now()
+{
+#ifndef NotNative
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    // the 32 bits microsecond clock wraps every 71 minutes, one thread runs the machine
+    static u32 last = 0;
+    static u64 wraps = 0;
+    u32 ticks = CTimer::GetClockTicks();
+    if (ticks < last) {
+        wraps++;
+    }
+    last = ticks;
+    return ((wraps << 32) + ticks) * (1000000000 / CLOCKHZ);
+#endif
+}
@@ -0,0 +1,84 @@
+#include "pack_bits.h"
+
+using namespace Frankenstein;
+
+static constexpr u32 MinRun = 3;
+static constexpr u32 MaxRun = 130;
+static constexpr u32 MaxLiteral = 128;
+
+u32 PackBits::Compress(const u8* source, u32 size, u8* destination)
+{
+    u32 in = 0;
+    u32 out = 0;
+    u32 literalStart = 0;
+
+    while (in < size) {
+        u32 run = 1;
+        while (in + run < size && run < MaxRun && source[in + run] == source[in]) {
+            run++;
+        }
+
+        if (run < MinRun) {
+            in += run;
+            // flush literals when the packet is full
+            while (in - literalStart >= MaxLiteral) {
+                destination[out++] = u8(MaxLiteral - 1);
+                for (u32 i = 0; i < MaxLiteral; ++i) {
+                    destination[out++] = source[literalStart + i];
+                }
+                literalStart += MaxLiteral;
+            }
+            continue;
+        }
+
+        if (in > literalStart) {
+            u32 count = in - literalStart;
+            destination[out++] = u8(count - 1);
+            for (u32 i = 0; i < count; ++i) {
+                destination[out++] = source[literalStart + i];
+            }
+        }
+        destination[out++] = u8(0x80 + run - MinRun);
+        destination[out++] = source[in];
+        in += run;
+        literalStart = in;
+    }
+
+    if (in > literalStart) {
+        u32 count = in - literalStart;
+        destination[out++] = u8(count - 1);
+        for (u32 i = 0; i < count; ++i) {
+            destination[out++] = source[literalStart + i];
+        }
+    }
+    return out;
+}
+
+u32 PackBits::Decompress(const u8* source, u32 size, u8* destination, u32 capacity)
+{
+    u32 in = 0;
+    u32 out = 0;
+
+    while (in < size) {
+        u8 control = source[in++];
+        if (control < 0x80) {
+            u32 count = u32(control) + 1;
+            if (in + count > size || out + count > capacity) {
+                return 0;
+            }
+            for (u32 i = 0; i < count; ++i) {
+                destination[out++] = source[in++];
+            }
+        } else {
+            u32 count = u32(control) - 0x80 + MinRun;
+            if (in >= size || out + count > capacity) {
+                return 0;
+            }
+            u8 value = source[in++];
+            for (u32 i = 0; i < count; ++i) {
+                destination[out++] = value;
+            }
+        }
+    }
+    return out;
+}
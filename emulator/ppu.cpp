@@ -1,37 +1,187 @@
 #include "dependencies.h"
+#ifndef NotNative
+#include "frame_exchange.h"
+#endif
 #include "nes.h"
 #include "ppu.h"
 #include "rom.h"
 
 using namespace Frankenstein;
 
+constexpr u32 Ppu::PictureHashHistory;
+
+const u16 Ppu::MirrorLookup[5][4] = {
+    { 0, 0, 1, 1 },
+    { 0, 1, 0, 1 },
+    { 0, 0, 0, 0 },
+    { 1, 1, 1, 1 },
+    { 0, 1, 2, 3 },
+};
+
+const Ppu::RGBColor Ppu::systemPalette[0x40] = {
+    { 0x80, 0x80, 0x80 },
+    { 0x00, 0x3D, 0xA6 },
+    { 0x00, 0x12, 0xB0 },
+    { 0x44, 0x00, 0x96 },
+    { 0xA1, 0x00, 0x5E },
+    { 0xC7, 0x00, 0x28 },
+    { 0xBA, 0x06, 0x00 },
+    { 0x8C, 0x17, 0x00 },
+    { 0x5C, 0x2F, 0x00 },
+    { 0x10, 0x45, 0x00 },
+    { 0x05, 0x4A, 0x00 },
+    { 0x00, 0x47, 0x2E },
+    { 0x00, 0x41, 0x66 },
+    { 0x00, 0x00, 0x00 },
+    { 0x05, 0x05, 0x05 },
+    { 0x05, 0x05, 0x05 },
+    { 0xC7, 0xC7, 0xC7 },
+    { 0x00, 0x77, 0xFF },
+    { 0x21, 0x55, 0xFF },
+    { 0x82, 0x37, 0xFA },
+    { 0xEB, 0x2F, 0xB5 },
+    { 0xFF, 0x29, 0x50 },
+    { 0xFF, 0x22, 0x00 },
+    { 0xD6, 0x32, 0x00 },
+    { 0xC4, 0x62, 0x00 },
+    { 0x35, 0x80, 0x00 },
+    { 0x05, 0x8F, 0x00 },
+    { 0x00, 0x8A, 0x55 },
+    { 0x00, 0x99, 0xCC },
+    { 0x21, 0x21, 0x21 },
+    { 0x09, 0x09, 0x09 },
+    { 0x09, 0x09, 0x09 },
+    { 0xFF, 0xFF, 0xFF },
+    { 0x0F, 0xD7, 0xFF },
+    { 0x69, 0xA2, 0xFF },
+    { 0xD4, 0x80, 0xFF },
+    { 0xFF, 0x45, 0xF3 },
+    { 0xFF, 0x61, 0x8B },
+    { 0xFF, 0x88, 0x33 },
+    { 0xFF, 0x9C, 0x12 },
+    { 0xFA, 0xBC, 0x20 },
+    { 0x9F, 0xE3, 0x0E },
+    { 0x2B, 0xF0, 0x35 },
+    { 0x0C, 0xF0, 0xA4 },
+    { 0x05, 0xFB, 0xFF },
+    { 0x5E, 0x5E, 0x5E },
+    { 0x0D, 0x0D, 0x0D },
+    { 0x0D, 0x0D, 0x0D },
+    { 0xFF, 0xFF, 0xFF },
+    { 0xA6, 0xFC, 0xFF },
+    { 0xB3, 0xEC, 0xFF },
+    { 0xDA, 0xAB, 0xEB },
+    { 0xFF, 0xA8, 0xF9 },
+    { 0xFF, 0xAB, 0xB3 },
+    { 0xFF, 0xD2, 0xB0 },
+    { 0xFF, 0xEF, 0xA6 },
+    { 0xFF, 0xF7, 0x9C },
+    { 0xD7, 0xE8, 0x95 },
+    { 0xA6, 0xED, 0xAF },
+    { 0xA2, 0xF2, 0xDA },
+    { 0x99, 0xFF, 0xFC },
+    { 0xDD, 0xDD, 0xDD },
+    { 0x11, 0x11, 0x11 },
+    { 0x11, 0x11, 0x11 }
+};
+
 Ppu::Ppu(Nes& pNes)
     : nes(pNes)
+    , skipRender(false)
+    , hashPictures(false)
+    , port(nullptr)
+    , signalNmi(true)
+    , frames(nullptr)
+    , Cycle(0)
+    , ScanLine(0)
+    , Frame(0)
+    , paletteData{ 0 }
+    , nameTableData()
+    , oamData{ 0 }
+    , chrData(pNes.rom.GetCHRPages())
+    , v(0)
+    , t(0)
+    , x(0)
+    , w(0)
+    , f(0)
+    , reg(0)
+    , nmiOccurred(false)
+    , nmiOutput(false)
+    , nmiPrevious(false)
     , vblankOccured(false)
+    , nmiDelay(0)
+    , nameTableByte(0)
+    , attributeTableByte(0)
+    , lowTileByte(0)
+    , highTileByte(0)
+    , tileData(0)
+    , spriteCount(0)
+    , spritePatterns{ 0 }
+    , spritePositions{ 0 }
+    , spritePriorities{ 0 }
+    , spriteIndexes{ 0 }
+    , flagSpriteZeroHit(0)
+    , flagSpriteOverflow(0)
+    , bufferedData(0)
+    , pictureHash(FnvOffsetBasis)
+    , pictureHashes{ 0 }
+    , picturesHashed(0)
+    , picturesTaken(0)
 {
-    
-#ifndef NotNative
-    front = new RGBColor[256 * 240];
-    back = new RGBColor[256 * 240];
+    // allocated by the consumers of the picture, see AllocateFrameBuffers
+    front = nullptr;
+    back = nullptr;
 
-    for (int i = 0; i < 256; ++i) {
-	for (int j = 0; j < 240; j++) {
-	    front[i + 256 * j] = RGBColor();
-	    back[i + 256 * j] = RGBColor();
-	}
-    }
-#endif
+    Reset();
+}
 
-    const iNesHeader header = nes.rom.GetHeader();
-    u32 prgRomBanks = header.prgRomBanks;
-    u32 trainerOffset = nes.rom.GetTrainerOffset();
-    u32 vRomBanksLocation = Rom::HeaderSize + trainerOffset + prgRomBanks * PRGROM_BANK_SIZE;
+Ppu::Ppu(Nes& pNes, const Ppu& parent)
+    : nes(pNes)
+    , front(nullptr)
+    , back(nullptr)
+    , skipRender(parent.skipRender)
+    , hashPictures(false)
+    , port(nullptr)
+    , signalNmi(true)
+    , frames(nullptr)
+    , nameTableData(parent.nameTableData)
+    , chrData(parent.chrData)
+    , pictureHash(FnvOffsetBasis)
+    , pictureHashes{ 0 }
+    , picturesHashed(0)
+    , picturesTaken(0)
+{
+    NesState::PpuBlock block;
+    parent.Save(block);
+    Load(block);
+    memcpy(paletteData, parent.paletteData, sizeof(paletteData));
+    memcpy(oamData, parent.oamData, sizeof(oamData));
+}
+
+Ppu::~Ppu()
+{
+    delete[] front;
+    delete[] back;
+}
 
-    for (u32 i = 0; i < 0x2000; ++i) {
-        chrData[i] = nes.rom.GetRaw()[vRomBanksLocation + i];
+void Ppu::AllocateFrameBuffers()
+{
+#ifndef NotNative
+    if (front == nullptr) {
+        front = new RGBColor[256 * 240];
+        back = new RGBColor[256 * 240];
     }
+#endif
+}
 
-    Reset();
+bool Ppu::HasFrameBuffers() const
+{
+#ifndef NotNative
+    return back != nullptr;
+#else
+    // pixels go straight to the screen
+    return true;
+#endif
 }
 
 void Ppu::Reset()
@@ -44,6 +194,120 @@ void Ppu::Reset()
     writeOAMAddress(0);
 }
 
+void Ppu::Save(NesState& state) const
+{
+    Save(state.ppu);
+    memcpy(state.paletteData, paletteData, sizeof(state.paletteData));
+    nameTableData.CopyTo(0, state.nameTableData, sizeof(state.nameTableData));
+    memcpy(state.oamData, oamData, sizeof(state.oamData));
+    chrData.CopyTo(0, state.chrData, sizeof(state.chrData));
+}
+
+void Ppu::Load(const NesState& state)
+{
+    Load(state.ppu);
+    memcpy(paletteData, state.paletteData, sizeof(paletteData));
+    nameTableData.Copy(state.nameTableData, 0, sizeof(state.nameTableData));
+    memcpy(oamData, state.oamData, sizeof(oamData));
+    chrData.Copy(state.chrData, 0, sizeof(state.chrData));
+}
+
+void Ppu::Save(NesState::PpuBlock& block) const
+{
+    block.Frame = Frame;
+    block.tileData = tileData;
+    block.Cycle = Cycle;
+    block.ScanLine = ScanLine;
+    block.spriteCount = spriteCount;
+    memcpy(block.spritePatterns, spritePatterns, sizeof(block.spritePatterns));
+    block.v = v;
+    block.t = t;
+    block.x = x;
+    block.w = w;
+    block.f = f;
+    block.reg = reg;
+    block.nmiOccurred = nmiOccurred;
+    block.nmiOutput = nmiOutput;
+    block.nmiPrevious = nmiPrevious;
+    block.vblankOccured = vblankOccured;
+    block.nmiDelay = nmiDelay;
+    block.nameTableByte = nameTableByte;
+    block.attributeTableByte = attributeTableByte;
+    block.lowTileByte = lowTileByte;
+    block.highTileByte = highTileByte;
+    memcpy(block.spritePositions, spritePositions, sizeof(block.spritePositions));
+    memcpy(block.spritePriorities, spritePriorities, sizeof(block.spritePriorities));
+    memcpy(block.spriteIndexes, spriteIndexes, sizeof(block.spriteIndexes));
+    block.control = flagNameTable | (flagIncrement << 2) | (flagSpriteTable << 3) | (flagBackgroundTable << 4)
+        | (flagSpriteSize << 5) | (flagMasterSlave << 6) | (u8(nmiOutput) << 7);
+    block.mask = flagGrayscale | (flagShowLeftBackground << 1) | (flagShowLeftSprites << 2) | (flagShowBackground << 3)
+        | (flagShowSprites << 4) | (flagRedTint << 5) | (flagGreenTint << 6) | (flagBlueTint << 7);
+    block.flagSpriteZeroHit = flagSpriteZeroHit;
+    block.flagSpriteOverflow = flagSpriteOverflow;
+    block.oamAddress = oamAddress;
+    block.bufferedData = bufferedData;
+    memset(block.reserved, 0, sizeof(block.reserved));
+}
+
+void Ppu::Load(const NesState::PpuBlock& block)
+{
+    Frame = block.Frame;
+    tileData = block.tileData;
+    Cycle = block.Cycle;
+    ScanLine = block.ScanLine;
+    spriteCount = block.spriteCount;
+    memcpy(spritePatterns, block.spritePatterns, sizeof(spritePatterns));
+    v = block.v;
+    t = block.t;
+    x = block.x;
+    w = block.w;
+    f = block.f;
+    reg = block.reg;
+    nmiOccurred = block.nmiOccurred != 0;
+    nmiPrevious = block.nmiPrevious != 0;
+    vblankOccured = block.vblankOccured != 0;
+    nmiDelay = block.nmiDelay;
+    nameTableByte = block.nameTableByte;
+    attributeTableByte = block.attributeTableByte;
+    lowTileByte = block.lowTileByte;
+    highTileByte = block.highTileByte;
+    memcpy(spritePositions, block.spritePositions, sizeof(spritePositions));
+    memcpy(spritePriorities, block.spritePriorities, sizeof(spritePriorities));
+    memcpy(spriteIndexes, block.spriteIndexes, sizeof(spriteIndexes));
+    flagNameTable = block.control & 3;
+    flagIncrement = (block.control >> 2) & 1;
+    flagSpriteTable = (block.control >> 3) & 1;
+    flagBackgroundTable = (block.control >> 4) & 1;
+    flagSpriteSize = (block.control >> 5) & 1;
+    flagMasterSlave = (block.control >> 6) & 1;
+    nmiOutput = ((block.control >> 7) & 1) == 1;
+    flagGrayscale = block.mask & 1;
+    flagShowLeftBackground = (block.mask >> 1) & 1;
+    flagShowLeftSprites = (block.mask >> 2) & 1;
+    flagShowBackground = (block.mask >> 3) & 1;
+    flagShowSprites = (block.mask >> 4) & 1;
+    flagRedTint = (block.mask >> 5) & 1;
+    flagGreenTint = (block.mask >> 6) & 1;
+    flagBlueTint = (block.mask >> 7) & 1;
+    flagSpriteZeroHit = block.flagSpriteZeroHit;
+    flagSpriteOverflow = block.flagSpriteOverflow;
+    oamAddress = block.oamAddress;
+    bufferedData = block.bufferedData;
+}
+
+u32 Ppu::TakePictureHashes(u64* hashes, u32 capacity)
+{
+    if (picturesHashed - picturesTaken > PictureHashHistory) {
+        picturesTaken = picturesHashed - PictureHashHistory;
+    }
+    u32 count = 0;
+    while (picturesTaken < picturesHashed && count < capacity) {
+        hashes[count++] = pictureHashes[picturesTaken % PictureHashHistory];
+        picturesTaken++;
+    }
+    return count;
+}
+
 u8 Ppu::Read(u16 address)
 {
     u16 temp = address & 0x3FFF; // TODO CONFIRM % 0x4000;
@@ -62,10 +326,10 @@ void Ppu::Write(u16 address, u8 value)
 {
     u16 temp = address & 0x3FFF; // TODO CONFIRM % 0x4000;
     if (temp < 0x2000) {
-        chrData[temp] = value;
+        chrData.Write(temp, value);
     } else if (temp < 0x3F00) {
         u8 mode = CheckBit<1>(nes.rom.GetHeader().controlByte1);
-        nameTableData[MirrorAddress(mode, temp) & 0x7FF] = value;
+        nameTableData.Write(MirrorAddress(mode, temp) & 0x7FF, value);
     } else if (temp < 0x4000) {
         writePalette(temp & 0x1F, value);
     }
@@ -97,6 +361,11 @@ void Ppu::writePalette(u16 address, u8 value)
 
 u8 Ppu::readRegister(u16 address)
 {
+#ifdef WithStats
+    if (address < 0x4000) {
+        nes.stats.ppuCurrent.registerReads[address & 0x07]++;
+    }
+#endif
     switch (address) {
     case 0x2002:
         return readStatus();
@@ -110,6 +379,11 @@ u8 Ppu::readRegister(u16 address)
 
 void Ppu::writeRegister(u16 address, u8 value)
 {
+#ifdef WithStats
+    if (address < 0x4000) {
+        nes.stats.ppuCurrent.registerWrites[address & 0x07]++;
+    }
+#endif
     reg = value;
     switch (address) {
     case 0x2000:
@@ -179,6 +453,11 @@ u8 Ppu::readStatus()
     if (nmiOccurred) {
         result |= 1 << 7;
     }
+#ifdef WithStats
+    else {
+        nes.stats.ppuCurrent.statusPolls++;
+    }
+#endif
     nmiOccurred = false;
     nmiChange();
     w = 0;
@@ -252,6 +531,9 @@ void Ppu::writeAddress(u8 value)
 u8 Ppu::readData()
 {
     u8 value = Read(v);
+#ifdef WithCdl
+    nes.cdl.MarkChr(v & 0x3FFF, CodeDataLog::Read);
+#endif
     // emulate buffered reads
     if ((v & 0x3FFF) < 0x3F00) { // % 0x4000
         u8 buffered = bufferedData;
@@ -291,17 +573,7 @@ void Ppu::writeDMA(u8 value)
         oamAddress++;
         address++;
     }
-    /**
-     * When sprite DMA ($4014) is written to, 
-     * the next instruction always begins on an odd cycle. 
-     * If the $4014 write is on an odd cycle, 
-     * it pauses the CPU for an additional 513 cycles, otherwise 514 cycles. 
-     * We can use this aspect to partially compensate for NMI's variable delay.
-     */
-    nes.cpu.stall += 513;
-    if (nes.cpu.cycles & 1) {
-        nes.cpu.stall++;
-    }
+    nes.cpu.StallForDma(value);
 }
 
 // NTSC Timing Helper Functions
@@ -378,14 +650,37 @@ void Ppu::nmiChange()
 void Ppu::setVerticalBlank()
 {
 #ifndef NotNative
-	auto temp = back;
-	back = front;
-	front = temp;
+    if (frames != nullptr && !skipRender) {
+        front = back;
+        back = frames->Publish();
+    } else if (!skipRender) {
+        auto temp = back;
+        back = front;
+        front = temp;
+    }
 #endif
+    if (hashPictures) {
+        pictureHashes[picturesHashed % PictureHashHistory] = pictureHash;
+        picturesHashed++;
+    }
+    pictureHash = FnvOffsetBasis;
     nmiOccurred = true;
     nmiChange();
 
     vblankOccured = true;
+    if (nes.tracer != nullptr) {
+        nes.tracer->End(TraceEvent::Frame);
+        nes.tracer->Begin(TraceEvent::Frame, u32(Frame));
+    }
+#ifdef WithStats
+    // with a PpuPipeline, the CPU thread ends the frames at PpuPipeline::Sync
+    if (port == nullptr) {
+        nes.stats.EndFrame(Frame);
+    }
+#endif
+    if (nes.frameListener != nullptr && !skipRender) {
+        nes.frameListener->OnFrame(nes);
+    }
 }
 
 void Ppu::clearVerticalBlank()
@@ -415,6 +710,9 @@ void Ppu::fetchLowTileByte()
     u8 tile = nameTableByte;
     u16 address = 0x1000 * u16(table) + u16(tile) * 16 + fineY;
     lowTileByte = Read(address);
+#ifdef WithCdl
+    nes.cdl.MarkChr(address, CodeDataLog::Rendered);
+#endif
 }
 
 void Ppu::fetchHighTileByte()
@@ -424,6 +722,9 @@ void Ppu::fetchHighTileByte()
     u8 tile = nameTableByte;
     u16 address = 0x1000 * u16(table) + u16(tile) * 16 + fineY;
     highTileByte = Read(address + 8);
+#ifdef WithCdl
+    nes.cdl.MarkChr(address + 8, CodeDataLog::Rendered);
+#endif
 }
 
 void Ppu::storeTileData()
@@ -508,6 +809,12 @@ void Ppu::renderPixel()
             color = background;
         }
     }
+    if (hashPictures) {
+        pictureHash = (pictureHash ^ (readPalette(u16(color)) & 0x3F)) * FnvPrime;
+    }
+    if (skipRender || !HasFrameBuffers()) {
+        return;
+    }
     RGBColor c = systemPalette[readPalette(u16(color)) & 0x3F]; // % 64
 #ifndef NotNative
     back[x + 256 * y] = c;
@@ -548,6 +855,10 @@ u32 Ppu::fetchSpritePattern(u8 i, u32 row)
     u8 a = (attributes & 3) << 2;
     lowTileByte = Read(address);
     highTileByte = Read(address + 8);
+#ifdef WithCdl
+    nes.cdl.MarkChr(address, CodeDataLog::Rendered);
+    nes.cdl.MarkChr(address + 8, CodeDataLog::Rendered);
+#endif
     u32 data = 0;
     for (u8 i = 0; i < 8; i++) {
         u8 p1, p2;
@@ -596,6 +907,9 @@ void Ppu::evaluateSprites()
     if (count > 8) {
         count = 8;
         flagSpriteOverflow = 1;
+#ifdef WithStats
+        nes.stats.ppuCurrent.spriteOverflowLines++;
+#endif
     }
     spriteCount = count;
 }
@@ -606,7 +920,7 @@ void Ppu::tick()
 {
     if (nmiDelay > 0) {
         nmiDelay--;
-        if (nmiDelay == 0 && nmiOutput && nmiOccurred) {
+        if (nmiDelay == 0 && nmiOutput && nmiOccurred && signalNmi) {
             nes.cpu.nmiOccurred = true;
         }
     }
@@ -635,6 +949,10 @@ void Ppu::tick()
 void Ppu::Step()
 {
     tick();
+    if (Cycle == 0 && (ScanLine & 7) == 0 && nes.tracer != nullptr) {
+        nes.tracer->End(TraceEvent::ScanLines);
+        nes.tracer->Begin(TraceEvent::ScanLines, ScanLine);
+    }
 
     bool renderingEnabled = flagShowBackground != 0 || flagShowSprites != 0;
     bool preLine = ScanLine == 261;
@@ -645,6 +963,13 @@ void Ppu::Step()
     bool visibleCycle = Cycle >= 1 && Cycle <= 256;
     bool fetchCycle = preFetchCycle || visibleCycle;
 
+    // with the rendering off the PPU outputs the backdrop, or the palette
+    // entry v points to
+    if (!renderingEnabled && hashPictures && visibleLine && visibleCycle) {
+        u16 backdrop = (v & 0x3F00) == 0x3F00 ? u16(v & 0x1F) : 0;
+        pictureHash = (pictureHash ^ (readPalette(backdrop) & 0x3F)) * FnvPrime;
+    }
+
     // background logic
     if (renderingEnabled) {
         if (visibleLine && visibleCycle) {
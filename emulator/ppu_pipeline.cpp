@@ -0,0 +1,406 @@
+#include "ppu_pipeline.h"
+
+#include "nes.h"
+
+#include <cassert>
+
+using namespace Frankenstein;
+
+namespace {
+
+constexpr u64 Never = ~u64(0);
+
+// rounds the render thread yields with nothing to do before it sleeps
+constexpr u32 IdleRounds = 256;
+
+u8 SpriteFlags(const Ppu& ppu)
+{
+    return ppu.flagSpriteOverflow | (ppu.flagSpriteZeroHit << 1);
+}
+
+}
+
+void PpuPipeline::Timing::Load(const Ppu& ppu)
+{
+    Cycle = ppu.Cycle;
+    ScanLine = ppu.ScanLine;
+    Frame = ppu.Frame;
+    f = ppu.f;
+    reg = ppu.reg;
+    nmiDelay = ppu.nmiDelay;
+    nmiOccurred = ppu.nmiOccurred;
+    nmiOutput = ppu.nmiOutput;
+    nmiPrevious = ppu.nmiPrevious;
+    rendering = ppu.flagShowBackground != 0 || ppu.flagShowSprites != 0;
+}
+
+bool PpuPipeline::Timing::operator==(const Timing& other) const
+{
+    return Cycle == other.Cycle && ScanLine == other.ScanLine && Frame == other.Frame && f == other.f
+        && reg == other.reg && nmiDelay == other.nmiDelay && nmiOccurred == other.nmiOccurred
+        && nmiOutput == other.nmiOutput && nmiPrevious == other.nmiPrevious && rendering == other.rendering;
+}
+
+PpuPipeline::PpuPipeline(Nes& pNes, u32 capacity)
+    : nes(pNes)
+    , dot(0)
+    , clearDot(0)
+    , finalDot(Never)
+    , renderedSinceClear(true)
+    , requests(0)
+    , stats()
+    , log(capacity)
+    , mask(capacity - 1)
+    , head(0)
+    , tail(0)
+    , cpuDot(0)
+    , renderDot(0)
+    , published(SpriteFlags(pNes.ppu))
+    , replies(0)
+    , replyValue(0)
+    , replyTiming()
+    , mispredictions(0)
+    , resync(false)
+    , stopping(false)
+    , sleeping(false)
+{
+    model.Load(nes.ppu);
+#ifdef WithStats
+    statsFrame = model.Frame;
+#endif
+    nes.ppu.port = this;
+    nes.ppu.signalNmi = false;
+    renderer = std::thread(&PpuPipeline::RenderMain, this);
+}
+
+PpuPipeline::~PpuPipeline()
+{
+    Sync();
+    stopping.store(true, std::memory_order_release);
+    Wake();
+    renderer.join();
+    nes.ppu.port = nullptr;
+    nes.ppu.signalNmi = true;
+}
+
+void PpuPipeline::Step()
+{
+    nes.cpu.Step();
+    for (u16 i = 0; i < (nes.cpu.cycles * 3); ++i) {
+        StepModel();
+    }
+    cpuDot.store(dot, std::memory_order_release);
+    Wake();
+}
+
+void PpuPipeline::RunFrame()
+{
+    u64 frame = model.Frame;
+    if (nes.tracer != nullptr) {
+        nes.tracer->Begin(TraceEvent::Run, u32(frame));
+    }
+    while (model.Frame == frame) {
+        Step();
+    }
+    Sync();
+    if (nes.tracer != nullptr) {
+        nes.tracer->End(TraceEvent::Run);
+    }
+}
+
+void PpuPipeline::Sync()
+{
+    cpuDot.store(dot, std::memory_order_release);
+    Wake();
+    u64 logged = head.load(std::memory_order_relaxed);
+    while (tail.load(std::memory_order_acquire) != logged
+           || (published.load(std::memory_order_acquire) >> 2) != dot) {
+        std::this_thread::yield();
+    }
+#ifdef WithStats
+    // the counters of the render thread (NesStats::ppuCurrent) join the last frame
+    if (model.Frame != statsFrame) {
+        nes.stats.EndFrame(model.Frame - 1);
+        statsFrame = model.Frame;
+    }
+#endif
+}
+
+void PpuPipeline::Reload()
+{
+    model.Load(nes.ppu);
+#ifdef WithStats
+    statsFrame = model.Frame;
+#endif
+    // the flags published so far may come from the replaced state
+    clearDot = dot + 1;
+    finalDot = Never;
+    renderedSinceClear = true;
+}
+
+u64 PpuPipeline::GetFrame() const
+{
+    return model.Frame;
+}
+
+PpuPipeline::Stats PpuPipeline::GetStats() const
+{
+    Stats result = stats;
+    result.mispredictions = mispredictions.load(std::memory_order_relaxed);
+    return result;
+}
+
+u8 PpuPipeline::ReadRegister(u16 address)
+{
+    if (address == 0x2002 && !resync.load(std::memory_order_relaxed)) {
+        u8 flags;
+        if (PredictFlags(flags)) {
+            // as Ppu::readStatus
+            u8 value = (model.reg & 0x1F) | (flags << 5) | (model.nmiOccurred ? 0x80 : 0);
+            model.nmiOccurred = false;
+            NmiChange();
+            Push(Event{ dot, address, value, Kind::Status });
+            stats.predictedReads++;
+            return value;
+        }
+    }
+    if (address == 0x2002 || address == 0x2004 || address == 0x2007) {
+        return BlockingRead(address);
+    }
+    return 0;
+}
+
+void PpuPipeline::WriteRegister(u16 address, u8 value)
+{
+    stats.writes++;
+    model.reg = value;
+    if (address == 0x2000) {
+        model.nmiOutput = ((value >> 7) & 1) == 1;
+        NmiChange();
+    } else if (address == 0x2001) {
+        model.rendering = (value & 0x18) != 0;
+    }
+    Push(Event{ dot, address, value, Kind::Write });
+
+    if (address == 0x4014) {
+        // as Ppu::writeDMA, the bytes are read here and copied by the render thread
+        u16 source = u16(value) << 8;
+        for (u16 i = 0; i < 256; i++) {
+            u8 byte = nes.ram[source + i];
+            Push(Event{ dot, 0, byte, Kind::OamByte });
+        }
+        nes.cpu.StallForDma(value);
+    }
+}
+
+// the timing part of Ppu::tick and Ppu::Step
+void PpuPipeline::StepModel()
+{
+    Timing& m = model;
+    if (m.nmiDelay > 0) {
+        m.nmiDelay--;
+        if (m.nmiDelay == 0 && m.nmiOutput && m.nmiOccurred) {
+            nes.cpu.nmiOccurred = true;
+        }
+    }
+
+    if (m.f == 1 && m.ScanLine == 261 && m.Cycle == 339 && m.rendering) {
+        m.Cycle = 0;
+        m.ScanLine = 0;
+        m.Frame++;
+        m.f ^= 1;
+    } else {
+        m.Cycle++;
+        if (m.Cycle > 340) {
+            m.Cycle = 0;
+            m.ScanLine++;
+            if (m.ScanLine > 261) {
+                m.ScanLine = 0;
+                m.Frame++;
+                m.f ^= 1;
+            }
+        }
+    }
+    dot++;
+
+    // sprite zero hit is drawn on cycles 1-256, the overflow evaluated on 257
+    if (m.ScanLine < 240 && m.Cycle >= 1 && m.Cycle <= 257) {
+        renderedSinceClear |= m.rendering;
+        if (m.ScanLine == 239 && m.Cycle == 257) {
+            finalDot = dot;
+        }
+    }
+    if (m.ScanLine == 241 && m.Cycle == 1) {
+        m.nmiOccurred = true;
+        NmiChange();
+    }
+    if (m.ScanLine == 261 && m.Cycle == 1) {
+        m.nmiOccurred = false;
+        NmiChange();
+        clearDot = dot;
+        finalDot = Never;
+        renderedSinceClear = false;
+    }
+}
+
+void PpuPipeline::NmiChange()
+{
+    bool nmi = model.nmiOutput && model.nmiOccurred;
+    if (nmi && !model.nmiPrevious) {
+        model.nmiDelay = 15;
+    }
+    model.nmiPrevious = nmi;
+}
+
+bool PpuPipeline::PredictFlags(u8& flags) const
+{
+    if (!renderedSinceClear) {
+        flags = 0;
+        return true;
+    }
+    // the flags are only set between two clears: once both are set, or once
+    // the visible lines are over, the last ones published are the current ones
+    u64 state = published.load(std::memory_order_acquire);
+    u64 stateDot = state >> 2;
+    flags = state & 3;
+    return stateDot >= clearDot && (flags == 3 || stateDot >= finalDot);
+}
+
+u8 PpuPipeline::BlockingRead(u16 address)
+{
+    u64 request = ++requests;
+    Push(Event{ dot, address, 0, Kind::Read });
+    cpuDot.store(dot, std::memory_order_release);
+    Wake();
+    while (replies.load(std::memory_order_acquire) != request) {
+        std::this_thread::yield();
+    }
+    stats.blockingReads++;
+
+    if (address == 0x2002) {
+        model.nmiOccurred = false;
+        NmiChange();
+    }
+    if (!(model == replyTiming)) {
+        model = replyTiming;
+        // the frame bookkeeping is unknown, only trust the flags published from now
+        clearDot = dot;
+        finalDot = Never;
+        renderedSinceClear = true;
+        stats.resyncs++;
+    }
+    resync.store(false, std::memory_order_relaxed);
+    return replyValue;
+}
+
+void PpuPipeline::Push(const Event& event)
+{
+    u64 next = head.load(std::memory_order_relaxed);
+    while (next - tail.load(std::memory_order_acquire) >= log.size()) {
+        // the log is full, let the render thread catch up
+        cpuDot.store(dot, std::memory_order_release);
+        Wake();
+        std::this_thread::yield();
+    }
+    log[next & mask] = event;
+    head.store(next + 1, std::memory_order_release);
+}
+
+// a store of head, cpuDot or stopping before, or Sleep sees it
+void PpuPipeline::Wake()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        // Sleep holds the mutex from its last check until it waits
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idle.notify_one();
+    }
+}
+
+void PpuPipeline::RenderMain()
+{
+    u32 idleRounds = 0;
+    for (;;) {
+        // every event logged before the CPU reached limit is visible once head is read
+        u64 limit = cpuDot.load(std::memory_order_acquire);
+        u64 logged = head.load(std::memory_order_acquire);
+        u64 next = tail.load(std::memory_order_relaxed);
+        if (next < logged) {
+            const Event& event = log[next & mask];
+            StepTo(event.dot);
+            Apply(event);
+            tail.store(next + 1, std::memory_order_release);
+            idleRounds = 0;
+        } else if (renderDot < limit) {
+            StepTo(limit);
+            idleRounds = 0;
+        } else if (stopping.load(std::memory_order_acquire)) {
+            return;
+        } else if (++idleRounds < IdleRounds) {
+            // the CPU thread is running, it logs more soon
+            std::this_thread::yield();
+        } else {
+            Sleep();
+            idleRounds = 0;
+        }
+    }
+}
+
+// waits until the CPU thread logs an event, runs further or stops
+void PpuPipeline::Sleep()
+{
+    std::unique_lock<std::mutex> lock(idleMutex);
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    idle.wait(lock, [this] {
+        return head.load(std::memory_order_acquire) != tail.load(std::memory_order_relaxed)
+            || renderDot < cpuDot.load(std::memory_order_acquire) || stopping.load(std::memory_order_acquire);
+    });
+    sleeping.store(false, std::memory_order_relaxed);
+}
+
+void PpuPipeline::StepTo(u64 target)
+{
+    Ppu& ppu = nes.ppu;
+    while (renderDot < target) {
+        ppu.Step();
+        renderDot++;
+    }
+    Publish();
+}
+
+void PpuPipeline::Apply(const Event& event)
+{
+    Ppu& ppu = nes.ppu;
+    switch (event.kind) {
+    case Kind::Write:
+        if (event.address == 0x4014) {
+            ppu.reg = event.value;
+        } else {
+            ppu.writeRegister(event.address, event.value);
+        }
+        break;
+    case Kind::OamByte:
+        ppu.writeOAMData(event.value);
+        break;
+    case Kind::Status:
+        if (ppu.readStatus() != event.value) {
+            // the CPU went on with the wrong value, the run differs from Nes::Step
+            assert(false && "PpuPipeline answered $2002 differently from the Ppu");
+            mispredictions.fetch_add(1, std::memory_order_relaxed);
+            resync.store(true, std::memory_order_relaxed);
+        }
+        break;
+    case Kind::Read:
+        replyValue = ppu.readRegister(event.address);
+        replyTiming.Load(ppu);
+        Publish();
+        replies.fetch_add(1, std::memory_order_release);
+        break;
+    }
+}
+
+void PpuPipeline::Publish()
+{
+    published.store(renderDot << 2 | SpriteFlags(nes.ppu), std::memory_order_release);
+}
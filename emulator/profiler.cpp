@@ -0,0 +1,310 @@
+#include "profiler.h"
+
+#include "nes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Frankenstein;
+
+constexpr u32 Profiler::MaxDepth;
+constexpr u32 Profiler::DmaFrame;
+constexpr u32 Profiler::Root;
+
+namespace {
+
+const u8 JSR = 0x20;
+const u8 BRK = 0x00;
+const u8 RTS = 0x60;
+const u8 RTI = 0x40;
+
+std::string Hex(u16 address)
+{
+    char text[8];
+    snprintf(text, sizeof(text), "$%04X", address);
+    return text;
+}
+
+bool ParseHex(std::string text, u32& value)
+{
+    if (!text.empty() && text[0] == '$') {
+        text.erase(0, 1);
+    } else if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text.erase(0, 2);
+    }
+    if (text.empty() || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        return false;
+    }
+    value = std::stoul(text, nullptr, 16);
+    return true;
+}
+
+// the value of key=value in a line of a ca65 debug file, quotes removed
+std::string GetField(const std::string& line, const std::string& key)
+{
+    size_t start = 0;
+    while ((start = line.find(key + "=", start)) != std::string::npos) {
+        if (start == 0 || line[start - 1] == ',' || line[start - 1] == '\t' || line[start - 1] == ' ') {
+            break;
+        }
+        start++;
+    }
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    start += key.size() + 1;
+    if (start < line.size() && line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        return line.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+    }
+    size_t end = line.find(',', start);
+    return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+}
+
+bool SymbolTable::Load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    u32 before = GetCount();
+    std::string line;
+    while (std::getline(in, line)) {
+        u32 address;
+        if (line.compare(0, 4, "sym\t") == 0 || line.compare(0, 4, "sym ") == 0) {
+            if (GetField(line, "type") == "lab" && ParseHex(GetField(line, "val"), address) && address <= 0xFFFF) {
+                Add(u16(address), GetField(line, "name"));
+            }
+            continue;
+        }
+        std::istringstream words(line);
+        std::string first;
+        std::string second;
+        std::string third;
+        words >> first >> second >> third;
+        if (first == "al" && ParseHex(second, address) && !third.empty()) {
+            // VICE: al 00C000 .reset
+            Add(u16(address), third[0] == '.' ? third.substr(1) : third);
+        } else if (second == "=" && ParseHex(third, address)) {
+            Add(u16(address), first);
+        } else if (ParseHex(first, address) && !second.empty()) {
+            Add(u16(address), second);
+        }
+    }
+    return GetCount() > before;
+}
+
+void SymbolTable::Add(u16 address, const std::string& name)
+{
+    if (!name.empty()) {
+        labels[address] = name;
+    }
+}
+
+std::string SymbolTable::GetName(u16 address) const
+{
+    auto found = labels.find(address);
+    return found != labels.end() ? found->second : Hex(address);
+}
+
+std::string SymbolTable::Locate(u16 address) const
+{
+    auto found = labels.upper_bound(address);
+    if (found == labels.begin()) {
+        return Hex(address);
+    }
+    --found;
+    if (found->first == address) {
+        return found->second;
+    }
+    return found->second + "+" + std::to_string(address - found->first);
+}
+
+u32 SymbolTable::GetCount() const
+{
+    return u32(labels.size());
+}
+
+Profiler::Profiler(Nes& pNes)
+    : nes(pNes)
+    , histogram(0x10000, 0)
+    , dmaCycles(0)
+    , depth(0)
+{
+    nodes.push_back(Node{ Root, 0, 0 });
+}
+
+void Profiler::Step()
+{
+    Cpu& cpu = nes.cpu;
+    u16 pc = cpu.registers.PC;
+    u8 sp = cpu.registers.SP;
+    bool stalled = cpu.stall > 0;
+    bool nmi = !stalled && cpu.nmiOccurred;
+    u8 opcode = stalled || nmi ? 0xEA : cpu.OpCode();
+
+    nes.Step();
+
+    u32 cycles = cpu.cycles;
+    u32 current = depth == 0 ? Root : stack[depth - 1].node;
+    if (stalled) {
+        dmaCycles += cycles;
+        nodes[GetChild(current, DmaFrame)].cycles += cycles;
+        return;
+    }
+    if (nmi) {
+        // the 7 cycles of the interrupt belong to the handler
+        Enter(cpu.registers.PC, sp);
+        histogram[cpu.registers.PC] += cycles;
+        nodes[stack[depth - 1].node].cycles += cycles;
+        return;
+    }
+    histogram[pc] += cycles;
+    nodes[current].cycles += cycles;
+    switch (opcode) {
+    case JSR:
+    case BRK:
+        Enter(cpu.registers.PC, sp);
+        break;
+    case RTS:
+    case RTI:
+        Leave(cpu.registers.SP);
+        break;
+    }
+}
+
+void Profiler::RunFrame()
+{
+    u64 frame = nes.ppu.Frame;
+    while (nes.ppu.Frame == frame) {
+        Step();
+    }
+}
+
+void Profiler::Reset()
+{
+    std::fill(histogram.begin(), histogram.end(), 0);
+    dmaCycles = 0;
+    for (Node& node : nodes) {
+        node.cycles = 0;
+    }
+}
+
+u64 Profiler::GetCycles() const
+{
+    u64 total = dmaCycles;
+    for (u64 cycles : histogram) {
+        total += cycles;
+    }
+    return total;
+}
+
+u64 Profiler::GetCycles(u16 pc) const
+{
+    return histogram[pc];
+}
+
+std::vector<Profiler::Bank> Profiler::GetBanks() const
+{
+    u32 prgBanks = std::max<u32>(1, nes.rom.GetHeader().prgRomBanks);
+    std::vector<Bank> banks;
+    banks.push_back(Bank{ "RAM", 0 });
+    banks.push_back(Bank{ "SRAM", 0 });
+    banks.push_back(Bank{ "I/O", 0 });
+    for (u32 i = 0; i < std::min<u32>(prgBanks, 2); ++i) {
+        banks.push_back(Bank{ "PRG" + std::to_string(i), 0 });
+    }
+    for (u32 pc = 0; pc < 0x10000; ++pc) {
+        u32 bank;
+        if (pc < 0x2000) {
+            bank = 0;
+        } else if (pc >= 0x6000 && pc < 0x8000) {
+            bank = 1;
+        } else if (pc < 0x8000) {
+            bank = 2;
+        } else {
+            bank = 3 + ((pc - 0x8000) / 0x4000) % std::min<u32>(prgBanks, 2);
+        }
+        banks[bank].cycles += histogram[pc];
+    }
+    return banks;
+}
+
+std::vector<std::pair<u16, u64>> Profiler::GetHottest(u32 count) const
+{
+    std::vector<std::pair<u16, u64>> hottest;
+    for (u32 pc = 0; pc < 0x10000; ++pc) {
+        if (histogram[pc] > 0) {
+            hottest.push_back(std::make_pair(u16(pc), histogram[pc]));
+        }
+    }
+    std::stable_sort(hottest.begin(), hottest.end(),
+                     [](const std::pair<u16, u64>& a, const std::pair<u16, u64>& b) { return a.second > b.second; });
+    if (hottest.size() > count) {
+        hottest.resize(count);
+    }
+    return hottest;
+}
+
+void Profiler::WriteFoldedStacks(std::ostream& out, const SymbolTable& symbols) const
+{
+    for (u32 i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].cycles == 0) {
+            continue;
+        }
+        std::vector<std::string> names;
+        for (u32 node = i; node != Root; node = nodes[node].parent) {
+            u32 function = nodes[node].function;
+            names.push_back(function == DmaFrame ? "[OAM DMA]" : symbols.GetName(u16(function)));
+        }
+        out << "[top]";
+        for (auto name = names.rbegin(); name != names.rend(); ++name) {
+            out << ";" << *name;
+        }
+        out << " " << nodes[i].cycles << "\n";
+    }
+}
+
+void Profiler::WriteHeatmap(std::ostream& out) const
+{
+    u64 highest = *std::max_element(histogram.begin(), histogram.end());
+    double scale = highest > 0 ? 255.0 / std::log2(1.0 + highest) : 0;
+    out << "P5\n256 256\n255\n";
+    for (u32 pc = 0; pc < 0x10000; ++pc) {
+        out.put(char(u8(std::log2(1.0 + histogram[pc]) * scale + 0.5)));
+    }
+}
+
+void Profiler::Enter(u32 function, u8 sp)
+{
+    if (depth == MaxDepth) {
+        return;
+    }
+    u32 parent = depth == 0 ? Root : stack[depth - 1].node;
+    stack[depth++] = Frame{ GetChild(parent, function), sp };
+}
+
+void Profiler::Leave(u8 sp)
+{
+    while (depth > 0 && stack[depth - 1].sp <= sp) {
+        depth--;
+    }
+}
+
+u32 Profiler::GetChild(u32 parent, u32 function)
+{
+    u64 key = (u64(parent) << 32) | function;
+    auto found = children.find(key);
+    if (found != children.end()) {
+        return found->second;
+    }
+    u32 node = u32(nodes.size());
+    nodes.push_back(Node{ parent, function, 0 });
+    children[key] = node;
+    return node;
+}
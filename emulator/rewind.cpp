@@ -0,0 +1,188 @@
+#include "rewind.h"
+
+#include "dependencies.h"
+#include "nes.h"
+#include "pack_bits.h"
+
+using namespace Frankenstein;
+
+static constexpr u32 StateBound = PackBits::Bound(sizeof(NesState));
+
+// an all zero delta still takes more than 256 bytes once packed
+static constexpr u32 MinEntrySize = 256;
+
+Rewind::Rewind(Nes& pNes, u32 pCapacity, u32 pKeyframeInterval)
+    : nes(pNes)
+    , capacity(pCapacity < StateBound ? StateBound : pCapacity)
+    , keyframeInterval(pKeyframeInterval)
+    , maxEntries(capacity / MinEntrySize + 1)
+    , data(new u8[capacity])
+    , entries(new Entry[maxEntries])
+    , first(0)
+    , count(0)
+    , head(0)
+    , used(0)
+    , keyframes(0)
+    , sinceKeyframe(0)
+    , packed(new u8[StateBound])
+{
+}
+
+Rewind::~Rewind()
+{
+    delete[] data;
+    delete[] entries;
+    delete[] packed;
+}
+
+void Rewind::Push()
+{
+    nes.SaveState(current);
+
+    bool isKeyframe = count == 0 || sinceKeyframe >= keyframeInterval;
+    if (!isKeyframe) {
+        for (u32 i = 0; i < sizeof(NesState); ++i) {
+            current[i] ^= keyframe[i];
+        }
+    }
+    u32 size = PackBits::Compress(current, sizeof(NesState), packed);
+    u32 offset = Allocate(size);
+
+    if (!isKeyframe && count == 0) {
+        // making room dropped the keyframe of this delta, store it whole instead
+        for (u32 i = 0; i < sizeof(NesState); ++i) {
+            current[i] ^= keyframe[i];
+        }
+        isKeyframe = true;
+        size = PackBits::Compress(current, sizeof(NesState), packed);
+        offset = Allocate(size);
+    }
+
+    memcpy(&data[offset], packed, size);
+    Entry& entry = At(count);
+    entry.offset = offset;
+    entry.size = size;
+    entry.keyframe = isKeyframe;
+    count++;
+    head = offset + size;
+    used += size;
+
+    if (isKeyframe) {
+        memcpy(keyframe, current, sizeof(NesState));
+        keyframes++;
+        sinceKeyframe = 0;
+    } else {
+        sinceKeyframe++;
+    }
+}
+
+bool Rewind::Pop()
+{
+    if (count == 0) {
+        return false;
+    }
+
+    const Entry entry = At(count - 1);
+    Restore(entry);
+    nes.LoadState(current);
+
+    count--;
+    used -= entry.size;
+    head = entry.offset;
+    if (entry.keyframe) {
+        keyframes--;
+        ReloadKeyframe();
+    } else {
+        sinceKeyframe--;
+    }
+    return true;
+}
+
+void Rewind::Clear()
+{
+    first = 0;
+    count = 0;
+    head = 0;
+    used = 0;
+    keyframes = 0;
+    sinceKeyframe = 0;
+}
+
+Rewind::Stats Rewind::GetStats() const
+{
+    Stats stats;
+    stats.capacity = capacity;
+    stats.used = used;
+    stats.frames = count;
+    stats.keyframes = keyframes;
+    stats.rawBytes = u64(count) * sizeof(NesState);
+    return stats;
+}
+
+Rewind::Entry& Rewind::At(u32 index) const
+{
+    return entries[(first + index) % maxEntries];
+}
+
+u32 Rewind::Allocate(u32 size)
+{
+    if (count == maxEntries) {
+        DropOldest();
+    }
+    while (true) {
+        if (count == 0) {
+            head = 0;
+            return 0;
+        }
+        u32 tail = At(0).offset;
+        if (head > tail) {
+            // snapshots use [tail, head), the free space is [head, capacity) then [0, tail)
+            if (capacity - head >= size) {
+                return head;
+            }
+            if (tail >= size) {
+                return 0;
+            }
+        } else if (tail - head >= size) {
+            // snapshots wrapped around, the free space is [head, tail)
+            return head;
+        }
+        DropOldest();
+    }
+}
+
+void Rewind::DropOldest()
+{
+    do {
+        const Entry& entry = At(0);
+        used -= entry.size;
+        if (entry.keyframe) {
+            keyframes--;
+        }
+        first = (first + 1) % maxEntries;
+        count--;
+    } while (count > 0 && !At(0).keyframe);
+}
+
+void Rewind::Restore(const Entry& entry)
+{
+    PackBits::Decompress(&data[entry.offset], entry.size, current, sizeof(NesState));
+    if (!entry.keyframe) {
+        for (u32 i = 0; i < sizeof(NesState); ++i) {
+            current[i] ^= keyframe[i];
+        }
+    }
+}
+
+void Rewind::ReloadKeyframe()
+{
+    sinceKeyframe = 0;
+    for (u32 i = count; i > 0; --i) {
+        const Entry& entry = At(i - 1);
+        if (entry.keyframe) {
+            PackBits::Decompress(&data[entry.offset], entry.size, keyframe, sizeof(NesState));
+            return;
+        }
+        sinceKeyframe++;
+    }
+}
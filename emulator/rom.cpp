@@ -10,6 +10,31 @@ Rom::Rom(u8 const* const raw, u64 size)
     this->PRG = MakePRG();
     this->CHR = MakeCHR();
     this->SRAM = MakeSRAM();
+    this->hash = Fnv1a64(raw + Rom::HeaderSize, size - Rom::HeaderSize);
+    MapPages();
+}
+
+Rom::Rom(Rom&& other)
+    : raw(other.raw)
+    , length(other.length)
+    , header(other.header)
+    , PRG(other.PRG)
+    , CHR(other.CHR)
+    , SRAM(other.SRAM)
+    , hash(other.hash)
+    , prgPages(other.prgPages)
+    , chrPages(other.chrPages)
+{
+    other.PRG = nullptr;
+    other.CHR = nullptr;
+    other.SRAM = nullptr;
+}
+
+Rom::~Rom()
+{
+    delete[] this->PRG;
+    delete[] this->CHR;
+    delete[] this->SRAM;
 }
 
 const iNesHeader Rom::GetHeader() const {
@@ -36,6 +61,22 @@ u8* Rom::GetSRAM() const {
     return this->SRAM;
 }
 
+const CowMemory<0x8000>& Rom::GetPRGPages() const {
+    return this->prgPages;
+}
+
+const CowMemory<0x2000>& Rom::GetCHRPages() const {
+    return this->chrPages;
+}
+
+bool Rom::HasBattery() const {
+    return CheckBit<2>(this->GetHeader().controlByte1);
+}
+
+u64 Rom::GetHash() const {
+    return this->hash;
+}
+
 u8* Rom::MakePRG() const
 {
     iNesHeader header = GetHeader();
@@ -65,7 +106,32 @@ u8* Rom::MakeCHR() const
 
 u8* Rom::MakeSRAM() const
 {
-    return new u8[0x2000];
+    return new u8[PRGRAM_BANK_SIZE]();
+}
+
+void Rom::MapPages()
+{
+    iNesHeader header = GetHeader();
+    u32 prgRomBanksLocation = Rom::HeaderSize + GetTrainerOffset();
+    u32 vRomBanksLocation = prgRomBanksLocation + header.prgRomBanks * PRGROM_BANK_SIZE;
+
+    switch (header.prgRomBanks) {
+    case 1:
+        prgPages.Copy(GetRaw() + prgRomBanksLocation, 0, PRGROM_BANK_SIZE);
+        prgPages.Copy(GetRaw() + prgRomBanksLocation, PRGROM_BANK_SIZE, PRGROM_BANK_SIZE);
+        break;
+    case 2:
+        prgPages.Copy(GetRaw() + prgRomBanksLocation, 0, 2 * PRGROM_BANK_SIZE);
+        break;
+    default: //TODO: implement multiple PRG-ROM banks
+        break;
+    }
+
+    // CHR-RAM cartridges have no CHR-ROM, their pattern tables start blank
+    if (vRomBanksLocation < length) {
+        u32 available = length - vRomBanksLocation;
+        chrPages.Copy(GetRaw() + vRomBanksLocation, 0, available < 0x2000 ? available : 0x2000);
+    }
 }
 
 iNesHeader Rom::MakeHeader() const
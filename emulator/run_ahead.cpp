@@ -0,0 +1,41 @@
+#include "run_ahead.h"
+
+#include "nes.h"
+
+using namespace Frankenstein;
+
+RunAhead::RunAhead(Nes& pNes, u32 pFrames)
+    : nes(pNes)
+    , frames(pFrames)
+{
+}
+
+void RunAhead::RunFrame()
+{
+    if (frames == 0) {
+        nes.RunFrame();
+        return;
+    }
+
+    nes.ppu.skipRender = true;
+    nes.RunFrame();
+    nes.SaveState(state);
+
+    for (u32 i = 1; i < frames; ++i) {
+        nes.RunFrame();
+    }
+    nes.ppu.skipRender = false;
+    nes.RunFrame();
+
+    nes.LoadState(state);
+}
+
+u32 RunAhead::GetFrames() const
+{
+    return frames;
+}
+
+void RunAhead::SetFrames(u32 pFrames)
+{
+    frames = pFrames;
+}
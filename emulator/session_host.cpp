@@ -0,0 +1,225 @@
+#include "session_host.h"
+
+#include "nes.h"
+
+#include <algorithm>
+
+using namespace Frankenstein;
+
+constexpr std::chrono::nanoseconds SessionHost::FramePeriod;
+
+struct SessionHost::Session {
+    std::unique_ptr<Nes> nes;
+    std::atomic<u16> buttons;       // pad2 << 8 | pad1
+    Clock::time_point start;        // start of the current frame period, frame task only
+
+    // host mutex
+    bool running;
+    bool removed;
+
+    // picture and stats, guarded by mutex
+    std::mutex mutex;
+    std::vector<Ppu::RGBColor> picture;
+    u64 pictureFrame;
+    Stats stats;
+};
+
+SessionHost::SessionHost(u32 threads, bool pin)
+    : pool(threads, pin)
+    , wakeAt(Clock::time_point::max())
+    , nextId(0)
+    , stopping(false)
+{
+    scheduler = std::thread(&SessionHost::SchedulerMain, this);
+}
+
+SessionHost::~SessionHost()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    scheduler.join();
+    // the frames being emulated do not queue their next one anymore
+    pool.Wait();
+}
+
+u32 SessionHost::Add(Rom& rom, bool video)
+{
+    std::shared_ptr<Session> session(new Session());
+    session->nes.reset(new Nes(rom));
+    session->buttons = 0;
+    session->start = Clock::now();
+    session->running = false;
+    session->removed = false;
+    session->pictureFrame = 0;
+    session->stats = Stats();
+    if (video) {
+        session->nes->ppu.AllocateFrameBuffers();
+        session->picture.resize(256 * 240);
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    u32 id = nextId++;
+    sessions[id] = session;
+    timers.push(Timer{ session->start, session });
+    wakeUp.notify_one();
+    return id;
+}
+
+void SessionHost::Remove(u32 id)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = sessions.find(id);
+    if (found == sessions.end()) {
+        return;
+    }
+    std::shared_ptr<Session> session = found->second;
+    sessions.erase(found);
+    session->removed = true;
+    finished.wait(lock, [&session] { return !session->running; });
+    // its timer may still reference the session, the machine goes now
+    session->nes.reset();
+}
+
+u32 SessionHost::Size() const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return sessions.size();
+}
+
+void SessionHost::SetButtons(u32 id, u8 pad1, u8 pad2)
+{
+    std::shared_ptr<Session> session = Find(id);
+    if (session) {
+        session->buttons.store(u16(pad2 << 8 | pad1), std::memory_order_relaxed);
+    }
+}
+
+u64 SessionHost::CollectFrame(u32 id, Ppu::RGBColor* picture)
+{
+    std::shared_ptr<Session> session = Find(id);
+    if (!session) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> guard(session->mutex);
+    if (session->pictureFrame != 0 && !session->picture.empty()) {
+        std::copy(session->picture.begin(), session->picture.end(), picture);
+    }
+    return session->pictureFrame;
+}
+
+SessionHost::Stats SessionHost::GetStats(u32 id) const
+{
+    std::shared_ptr<Session> session = Find(id);
+    if (!session) {
+        return Stats();
+    }
+    std::lock_guard<std::mutex> guard(session->mutex);
+    return session->stats;
+}
+
+SessionHost::Stats SessionHost::GetTotals() const
+{
+    std::vector<std::shared_ptr<Session>> current;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (auto& entry : sessions) {
+            current.push_back(entry.second);
+        }
+    }
+
+    Stats totals = Stats();
+    for (auto& session : current) {
+        std::lock_guard<std::mutex> guard(session->mutex);
+        totals.frames += session->stats.frames;
+        totals.missed += session->stats.missed;
+        totals.skipped += session->stats.skipped;
+        totals.worstLateness = std::max(totals.worstLateness, session->stats.worstLateness);
+        totals.emulation += session->stats.emulation;
+    }
+    return totals;
+}
+
+ThreadPool& SessionHost::GetPool()
+{
+    return pool;
+}
+
+std::shared_ptr<SessionHost::Session> SessionHost::Find(u32 id) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    auto found = sessions.find(id);
+    return found == sessions.end() ? nullptr : found->second;
+}
+
+void SessionHost::SchedulerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        Clock::time_point now = Clock::now();
+        while (!timers.empty() && timers.top().start <= now) {
+            std::shared_ptr<Session> session = timers.top().session;
+            timers.pop();
+            if (!session->removed) {
+                session->running = true;
+                pool.Submit([this, session] { RunFrame(session); });
+            }
+        }
+
+        if (timers.empty()) {
+            wakeAt = Clock::time_point::max();
+            wakeUp.wait(lock);
+        } else {
+            wakeAt = timers.top().start;
+            wakeUp.wait_until(lock, wakeAt);
+        }
+    }
+}
+
+void SessionHost::RunFrame(const std::shared_ptr<Session>& session)
+{
+    Nes& nes = *session->nes;
+    u16 buttons = session->buttons.load(std::memory_order_relaxed);
+    nes.pad1.SetButtons(u8(buttons));
+    nes.pad2.SetButtons(u8(buttons >> 8));
+
+    Clock::time_point begin = Clock::now();
+    nes.RunFrame();
+    Clock::time_point end = Clock::now();
+
+    Clock::time_point deadline = session->start + FramePeriod;
+    Clock::time_point next = deadline;
+    {
+        std::lock_guard<std::mutex> guard(session->mutex);
+        Stats& stats = session->stats;
+        stats.frames++;
+        stats.emulation += end - begin;
+        if (end > deadline) {
+            stats.missed++;
+            stats.worstLateness = std::max(stats.worstLateness, end - deadline);
+            // catching up on whole periods would only make the next frames late too
+            if (end - deadline > FramePeriod) {
+                stats.skipped += (end - deadline) / FramePeriod;
+                next = end;
+            }
+        }
+        if (!session->picture.empty()) {
+            std::copy(nes.ppu.front, nes.ppu.front + 256 * 240, session->picture.begin());
+            session->pictureFrame = nes.ppu.Frame;
+        }
+    }
+    session->start = next;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    session->running = false;
+    if (session->removed || stopping) {
+        finished.notify_all();
+        return;
+    }
+    timers.push(Timer{ next, session });
+    if (next < wakeAt) {
+        wakeUp.notify_one();
+    }
+}
@@ -0,0 +1,177 @@
+#include "common.h"
+
+#include <bus.h>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct Counter : BusListener {
+    u32 reads = 0;
+    u32 writes = 0;
+    u32 executes = 0;
+    u16 lastAddress = 0;
+    u8 lastValue = 0;
+
+    void OnRead(u16 address, u8 value) override
+    {
+        reads++;
+        lastAddress = address;
+        lastValue = value;
+    }
+
+    void OnWrite(u16 address, u8 value) override
+    {
+        writes++;
+        lastAddress = address;
+        lastValue = value;
+    }
+
+    void OnExecute(u16 address) override
+    {
+        executes++;
+        lastAddress = address;
+    }
+};
+
+// reads the address it is told about again
+struct Peeker : BusListener {
+    Nes& nes;
+    u32 reads = 0;
+
+    explicit Peeker(Nes& pNes) : nes(pNes)
+    {
+    }
+
+    void OnRead(u16 address, u8 value) override
+    {
+        reads++;
+        EXPECT_EQ(value, u8(nes.ram[address]));
+    }
+};
+
+struct BusTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(MemoryTest, Bus_WatchesTheRangeOnly)
+{
+    Counter counter;
+    s32 id = nes.bus.Watch(0x0010, 0x0011, Bus::Read | Bus::Write, &counter);
+    ASSERT_LE(0, id);
+    EXPECT_TRUE(nes.bus.IsWatched(0x00FF, Bus::Read));
+    EXPECT_FALSE(nes.bus.IsWatched(0x0100, Bus::Read));
+    EXPECT_FALSE(nes.bus.IsWatched(0x0010, Bus::Execute));
+
+    nes.ram[0x0010] = 0x42;
+    nes.ram[0x0012] = 0x43;
+    EXPECT_EQ(1u, counter.writes);
+    EXPECT_EQ(0x0010, counter.lastAddress);
+    EXPECT_EQ(0x42, counter.lastValue);
+
+    u8 value = nes.ram[0x0011];
+    EXPECT_EQ(1u, counter.reads);
+    EXPECT_EQ(value, counter.lastValue);
+
+    nes.bus.Unwatch(id);
+    nes.ram[0x0010] = 0x44;
+    EXPECT_EQ(1u, counter.writes);
+    EXPECT_FALSE(nes.bus.IsWatched(0x0010, Bus::Write));
+}
+
+TEST_F(MemoryTest, Bus_HasAFixedNumberOfWatches)
+{
+    Counter counter;
+    for (u32 i = 0; i < Bus::MaxWatches; ++i) {
+        EXPECT_EQ(s32(i), nes.bus.Watch(u16(i), u16(i), Bus::Write, &counter));
+    }
+    EXPECT_EQ(-1, nes.bus.Watch(0x0100, 0x0100, Bus::Write, &counter));
+    nes.bus.Unwatch(3);
+    EXPECT_EQ(3, nes.bus.Watch(0x0100, 0x0100, Bus::Write, &counter));
+    EXPECT_EQ(-1, nes.bus.Watch(0x0200, 0x0100, Bus::Write, &counter));
+}
+
+TEST_F(MemoryTest, Bus_FoldsTheMirrors)
+{
+    Counter counter;
+    nes.bus.Watch(0x0810, 0x0810, Bus::Write, &counter);
+    EXPECT_TRUE(nes.bus.IsWatched(0x0010, Bus::Write));
+    EXPECT_TRUE(nes.bus.IsWatched(0x1810, Bus::Write));
+    EXPECT_FALSE(nes.bus.IsWatched(0x0110, Bus::Write));
+    nes.ram[0x0010] = 0x42;
+    nes.ram[0x1810] = 0x43;
+    nes.ram[0x0011] = 0x44;
+    EXPECT_EQ(2u, counter.writes);
+    EXPECT_EQ(0x1810, counter.lastAddress);
+
+    // a range across the end of the RAM covers the start of the next mirror
+    Counter across;
+    nes.bus.Watch(0x07F0, 0x0805, Bus::Read, &across);
+    u8 value = nes.ram[0x1005];
+    EXPECT_EQ(value, across.lastValue);
+    value = nes.ram[0x0006];
+    EXPECT_EQ(1u, across.reads);
+    EXPECT_EQ(0x1005, across.lastAddress);
+
+    Counter status;
+    nes.bus.Watch(0x2002, 0x2002, Bus::Read, &status);
+    value = nes.ram[0x3FFA];
+    nes.ram[0x2003] = 0;
+    EXPECT_EQ(1u, status.reads);
+    EXPECT_EQ(value, status.lastValue);
+    EXPECT_EQ(0x3FFA, status.lastAddress);
+}
+
+TEST_F(MemoryTest, Bus_ListenersReadingTheRangeAreNotTold)
+{
+    Peeker peeker(nes);
+    nes.bus.Watch(0x0000, 0x07FF, Bus::Read, &peeker);
+    u8 value = nes.ram[0x0020];
+    EXPECT_EQ(1u, peeker.reads);
+    EXPECT_EQ(value, u8(nes.ram[0x0820]));
+    EXPECT_EQ(2u, peeker.reads);
+}
+
+TEST_F(BusTest, Execute_IsToldBeforeTheInstruction)
+{
+    u16 reset = nes.cpu.registers.PC;
+    Counter counter;
+    nes.bus.Watch(reset, reset, Bus::Execute, &counter);
+    nes.Step();
+    EXPECT_EQ(1u, counter.executes);
+    EXPECT_EQ(reset, counter.lastAddress);
+    EXPECT_EQ(0u, counter.reads);
+
+    // the game polls $2002 for the vertical blank
+    Counter status;
+    nes.bus.Watch(0x2002, 0x2002, Bus::Read, &status);
+    nes.RunFrame();
+    EXPECT_LT(0u, status.reads);
+}
+
+TEST_F(BusTest, Breakpoints_StopBeforeTheInstruction)
+{
+    u16 nmi = u16(u8(nes.ram[0xFFFA]) | (u8(nes.ram[0xFFFB]) << 8));
+    s32 id = nes.bus.AddBreakpoint(nmi);
+    ASSERT_LE(0, id);
+
+    ASSERT_TRUE(nes.bus.RunToBreakpoint(30 * 29781));
+    EXPECT_EQ(nmi, nes.cpu.registers.PC);
+    u64 frame = nes.ppu.Frame;
+
+    // resumes past the breakpoint, then stops on the next NMI
+    ASSERT_TRUE(nes.bus.RunToBreakpoint(2 * 29781));
+    EXPECT_EQ(nmi, nes.cpu.registers.PC);
+    EXPECT_EQ(frame + 1, nes.ppu.Frame);
+
+    // a condition which never holds
+    nes.bus.RemoveBreakpoint(id);
+    Bus::Condition never{ Bus::Condition::Register::A, 0x00, 0x01 };
+    nes.bus.AddBreakpoint(nmi, never);
+    EXPECT_FALSE(nes.bus.RunToBreakpoint(2 * 29781));
+
+    Bus::Condition stack{ Bus::Condition::Register::SP, 0x00, 0x00 };
+    nes.bus.AddBreakpoint(nmi, stack);
+    EXPECT_TRUE(nes.bus.RunToBreakpoint(2 * 29781));
+}
@@ -0,0 +1,80 @@
+#include "common.h"
+
+#include <code_data_log.h>
+
+#include <cstdio>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct CdlTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(CdlTest, Marks_FollowTheMapper0Layout)
+{
+    CodeDataLog cdl(rom);
+    ASSERT_EQ(0x4000u, cdl.GetPrgSize());
+    ASSERT_EQ(0x2000u, cdl.GetChrSize());
+
+    // 16 KB are mirrored, $C000 is $8000 seen through the third window
+    cdl.MarkPrg(0xC005, CodeDataLog::Code | CodeDataLog::Opcode);
+    cdl.MarkPrg(0x8006, CodeDataLog::Code);
+    cdl.MarkPrg(0x6000, CodeDataLog::Data);
+    cdl.MarkChr(0x1010, CodeDataLog::Rendered);
+    cdl.MarkChr(0x2000, CodeDataLog::Read);
+    EXPECT_EQ(0x89, cdl.GetPrg()[5]);
+    EXPECT_EQ(0x01, cdl.GetPrg()[6]);
+    EXPECT_EQ(0x01, cdl.GetChr()[0x1010]);
+
+    CodeDataLog::Coverage coverage = cdl.GetCoverage();
+    EXPECT_EQ(2u, coverage.code);
+    EXPECT_EQ(0u, coverage.data);
+    EXPECT_EQ(1u, coverage.rendered);
+
+    const char* path = "cdl_test.cdl";
+    ASSERT_TRUE(cdl.Save(path));
+    FILE* file = fopen(path, "rb");
+    ASSERT_NE(nullptr, file);
+    fseek(file, 0, SEEK_END);
+    EXPECT_EQ(0x6000, ftell(file));
+    fclose(file);
+
+    CodeDataLog loaded(rom);
+    loaded.MarkPrg(0x8007, CodeDataLog::Data);
+    ASSERT_TRUE(loaded.Load(path));
+    remove(path);
+    // the Opcode bit is not part of the format
+    EXPECT_EQ(0x09, loaded.GetPrg()[5]);
+    EXPECT_EQ(0x02, loaded.GetPrg()[7]);
+    EXPECT_EQ(0x01, loaded.GetChr()[0x1010]);
+
+    loaded.Clear();
+    EXPECT_EQ(0u, loaded.GetCoverage().code);
+    EXPECT_FALSE(loaded.Load("missing.cdl"));
+}
+
+#ifdef WithCdl
+TEST_F(CdlTest, Run_MarksCodeDataAndTiles)
+{
+    u16 reset = u16(nes.cpu.registers.PC);
+    for (u32 i = 0; i < 120; ++i) {
+        nes.RunFrame();
+    }
+    const u8* prg = nes.cdl.GetPrg();
+    u8 first = prg[(reset - 0x8000) & 0x3FFF];
+    EXPECT_EQ(CodeDataLog::Code | CodeDataLog::Opcode, first & (CodeDataLog::Code | CodeDataLog::Opcode));
+    // fetching an instruction is not a data read
+    EXPECT_EQ(0, first & CodeDataLog::Data);
+    // the NMI vector is read by the CPU
+    EXPECT_EQ(CodeDataLog::Data, prg[0x3FFA] & CodeDataLog::Data);
+
+    CodeDataLog::Coverage coverage = nes.cdl.GetCoverage();
+    EXPECT_LT(1000u, coverage.code);
+    EXPECT_LT(0u, coverage.data);
+    EXPECT_LT(0u, coverage.rendered);
+    EXPECT_LE(coverage.code + coverage.data, coverage.prgSize);
+}
+#endif
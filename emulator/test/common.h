@@ -20,7 +20,7 @@ struct MemoryTest : testing::Test {
 
 struct CPUTest : MemoryTest {
     Frankenstein::Rom rom;
-    Frankenstein::Nes nes = Frankenstein::Nes(rom);
+    Frankenstein::Nes nes;
 
     CPUTest() : rom(Frankenstein::RomLoader::GetRom("roms/01-basics.nes")), nes(rom)
     {
@@ -31,6 +31,24 @@ struct CPUTest : MemoryTest {
     }
 };
 
+/**
+ * Balloon Fight, a mapper 0 game, with a Nes at power on; the fixture owns
+ * the rom, tests build their other machines on it.
+ */
+struct BalloonFightTest : testing::Test {
+    Frankenstein::Rom rom;
+    Frankenstein::Nes nes;
+
+    BalloonFightTest() : rom(Frankenstein::RomLoader::GetRom("roms/Balloon Fight (USA).nes")), nes(rom)
+    {
+    }
+
+    virtual ~BalloonFightTest()
+    {
+        delete[] rom.GetRaw();
+    }
+};
+
 struct RomTest : CPUTest {
 
     RomTest() {
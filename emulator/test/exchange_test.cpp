@@ -0,0 +1,99 @@
+#include "common.h"
+
+#include <input_snapshot.h>
+#include <seq_lock.h>
+#include <spsc_ring.h>
+
+#include <thread>
+
+using namespace Frankenstein;
+
+TEST(ExchangeTest, SpscRing_KeepsOrderAcrossThreads)
+{
+    static SpscRing<u32, 64> ring;
+    const u32 count = 100000;
+    std::thread producer([count] {
+        for (u32 i = 0; i < count; ++i) {
+            while (!ring.Push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    u32 expected = 0;
+    while (expected < count) {
+        u32 value;
+        if (ring.Pop(value)) {
+            ASSERT_EQ(expected, value);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    u32 value;
+    EXPECT_FALSE(ring.Pop(value));
+}
+
+TEST(ExchangeTest, SpscRing_FailsWhenFull)
+{
+    SpscRing<u8, 4> ring;
+    for (u8 i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.Push(i));
+    }
+    EXPECT_FALSE(ring.Push(4));
+    EXPECT_EQ(4u, ring.Size());
+    u8 value;
+    EXPECT_TRUE(ring.Pop(value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(ring.Push(4));
+}
+
+TEST(ExchangeTest, SeqLock_NeverReadsTornValues)
+{
+    struct Value {
+        u32 words[8];
+    };
+    SeqLock<Value> lock;
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        Value value;
+        for (u32 i = 1; i <= 100000; ++i) {
+            for (u32& word : value.words) {
+                word = i;
+            }
+            lock.Store(value);
+        }
+        done = true;
+    });
+
+    while (!done) {
+        Value value = lock.Load();
+        for (u32 word : value.words) {
+            ASSERT_EQ(value.words[0], word);
+        }
+    }
+    writer.join();
+    EXPECT_EQ(100000u, lock.GetVersion());
+    EXPECT_EQ(100000u, lock.Load().words[7]);
+}
+
+TEST_F(BalloonFightTest, InputSnapshot_TakenAtTheStrobe)
+{
+    InputSnapshot input(nes);
+    input.SetButton(0, Gamepad::Start, true);
+    input.SetButtons(1, 1 << Gamepad::A);
+
+    // nothing reaches the pads before the game latches them
+    EXPECT_EQ(0, nes.pad1.GetButtons());
+    nes.ram[0x4016] = 1;
+    nes.ram[0x4016] = 0;
+    EXPECT_EQ(1 << Gamepad::Start, nes.pad1.latched);
+    EXPECT_EQ(1 << Gamepad::A, nes.pad2.latched);
+
+    input.SetButton(0, Gamepad::Start, false);
+    EXPECT_EQ(0, input.GetButtons(0));
+    nes.ram[0x4016] = 1;
+    nes.ram[0x4016] = 0;
+    EXPECT_EQ(0, nes.pad1.latched);
+}
@@ -0,0 +1,113 @@
+#include "common.h"
+
+using namespace Frankenstein;
+
+struct ForkTest : BalloonFightTest {
+    ForkTest()
+    {
+        for (u32 i = 0; i < 120; ++i) {
+            nes.RunFrame();
+        }
+    }
+
+    static void RunFrames(Nes& target, u32 count)
+    {
+        for (u32 i = 0; i < count; ++i) {
+            target.RunFrame();
+        }
+    }
+};
+
+TEST_F(ForkTest, Fork_SameStateAsParent)
+{
+    alignas(8) u8 expected[sizeof(NesState)];
+    alignas(8) u8 actual[sizeof(NesState)];
+
+    Nes* fork = nes.Fork();
+    nes.SaveState(expected);
+    fork->SaveState(actual);
+    EXPECT_EQ(0, memcmp(expected, actual, sizeof(NesState)));
+
+    RunFrames(nes, 60);
+    RunFrames(*fork, 60);
+    nes.SaveState(expected);
+    fork->SaveState(actual);
+    EXPECT_EQ(0, memcmp(expected, actual, sizeof(NesState)));
+
+    delete fork;
+}
+
+TEST_F(ForkTest, Fork_CopiesPagesOnWrite)
+{
+    u32 owned = nes.ram.PrivatePages();
+    EXPECT_LT(0u, owned);
+
+    Nes* fork = nes.Fork();
+    EXPECT_EQ(0u, nes.ram.PrivatePages());
+    EXPECT_EQ(0u, fork->ram.PrivatePages());
+
+    fork->ram[0x0000] = nes.ram[0x0000] + 1;
+    fork->ram[0x6000] = 0x5A;
+    EXPECT_EQ(2u, fork->ram.PrivatePages());
+    EXPECT_EQ(1u, nes.ram.PrivatePages());
+    EXPECT_NE(nes.ram[0x0000], fork->ram[0x0000]);
+    EXPECT_EQ(0, nes.ram[0x6000]);
+
+    delete fork;
+    EXPECT_EQ(owned, nes.ram.PrivatePages());
+}
+
+TEST_F(ForkTest, Fork_BranchesDiverge)
+{
+    Nes* fork = nes.Fork();
+    fork->pad1.buttons[Gamepad::Start] = true;
+    RunFrames(*fork, 10);
+    fork->pad1.buttons[Gamepad::Start] = false;
+    RunFrames(*fork, 50);
+    RunFrames(nes, 60);
+
+    alignas(8) u8 parent[sizeof(NesState)];
+    alignas(8) u8 branch[sizeof(NesState)];
+    nes.SaveState(parent);
+    fork->SaveState(branch);
+    EXPECT_NE(0, memcmp(parent, branch, sizeof(NesState)));
+    delete fork;
+
+    // discarding the branch left the parent untouched
+    Nes replay(rom);
+    RunFrames(replay, 180);
+    alignas(8) u8 expected[sizeof(NesState)];
+    replay.SaveState(expected);
+    EXPECT_EQ(0, memcmp(expected, parent, sizeof(NesState)));
+}
+
+TEST_F(ForkTest, Fork_FrameBuffersOnDemand)
+{
+    nes.ppu.AllocateFrameBuffers();
+    Nes* fork = nes.Fork();
+    EXPECT_FALSE(fork->ppu.HasFrameBuffers());
+    RunFrames(*fork, 2);
+
+    fork->ppu.AllocateFrameBuffers();
+    RunFrames(nes, 2);
+    RunFrames(*fork, 2);
+    EXPECT_EQ(Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor)),
+              Fnv1a64((const u8*)fork->ppu.front, 256 * 240 * sizeof(Ppu::RGBColor)));
+
+    delete fork;
+}
+
+TEST_F(ForkTest, MemoryReport_CompactInstance)
+{
+    Nes::MemoryReport report = nes.GetMemoryReport();
+    EXPECT_EQ(0u, report.frameBuffers);
+    // the rom is shared, only the RAM, the name tables and the object remain
+    EXPECT_LE(0x8000u, report.shared);
+    EXPECT_GT(64u * KILOBYTE, report.Total());
+
+    Nes* fork = nes.Fork();
+    EXPECT_EQ(sizeof(Nes), fork->GetMemoryReport().Total());
+    fork->ppu.AllocateFrameBuffers();
+    EXPECT_EQ(2 * 256 * 240 * sizeof(Ppu::RGBColor), fork->GetMemoryReport().frameBuffers);
+    delete fork;
+}
@@ -0,0 +1,103 @@
+#include "common.h"
+
+#include <frame_exchange.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+
+using namespace Frankenstein;
+
+namespace {
+
+u64 PictureHash(const Ppu::RGBColor* picture)
+{
+    return Fnv1a64((const u8*)picture, 256 * 240 * sizeof(Ppu::RGBColor));
+}
+
+// presses Start now and then so that the pictures change
+u8 Buttons(u32 frame)
+{
+    return (frame % 60) < 4 ? 1 << Gamepad::Start : 0;
+}
+
+struct FrameExchangeTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(FrameExchangeTest, Acquire_TakesEachFrameOnce)
+{
+    nes.ppu.AllocateFrameBuffers();
+    FrameExchange frames(nes.ppu);
+
+    for (u32 frame = 0; frame < 60; ++frame) {
+        nes.RunFrame();
+        bool fresh = false;
+        const Ppu::RGBColor* picture = frames.Acquire(&fresh);
+        ASSERT_TRUE(fresh);
+        ASSERT_EQ(PictureHash(nes.ppu.front), PictureHash(picture));
+    }
+    bool fresh = true;
+    frames.Acquire(&fresh);
+    EXPECT_FALSE(fresh);
+
+    // the first of two frames is never seen
+    nes.RunFrame();
+    nes.RunFrame();
+    EXPECT_EQ(PictureHash(nes.ppu.front), PictureHash(frames.Acquire()));
+
+    FrameExchange::Stats stats = frames.GetStats();
+    EXPECT_EQ(62u, stats.published);
+    EXPECT_EQ(61u, stats.acquired);
+    EXPECT_EQ(1u, stats.dropped);
+    EXPECT_EQ(1u, stats.repeated);
+}
+
+TEST_F(FrameExchangeTest, Acquire_NeverTearsFromAnotherThread)
+{
+    // every picture drawn by a plain run
+    std::set<u64> expected;
+    Nes reference(rom);
+    reference.ppu.AllocateFrameBuffers();
+    for (u32 frame = 0; frame < 300; ++frame) {
+        reference.pad1.SetButtons(Buttons(frame));
+        reference.RunFrame();
+        expected.insert(PictureHash(reference.ppu.front));
+    }
+
+    nes.ppu.AllocateFrameBuffers();
+    std::atomic<bool> done(false);
+    std::vector<u64> seen;
+    {
+        FrameExchange frames(nes.ppu);
+        std::thread display([&] {
+            while (!done) {
+                bool fresh = false;
+                const Ppu::RGBColor* picture = frames.Acquire(&fresh);
+                if (fresh) {
+                    seen.push_back(PictureHash(picture));
+                }
+                std::this_thread::yield();
+            }
+        });
+        for (u32 frame = 0; frame < 300; ++frame) {
+            nes.pad1.SetButtons(Buttons(frame));
+            nes.RunFrame();
+        }
+        done = true;
+        display.join();
+
+        FrameExchange::Stats stats = frames.GetStats();
+        EXPECT_EQ(300u, stats.published);
+        // the last picture may still wait for an Acquire
+        EXPECT_GE(stats.acquired + stats.dropped, 299u);
+        EXPECT_LE(stats.acquired + stats.dropped, 300u);
+    }
+    EXPECT_EQ(PictureHash(reference.ppu.front), PictureHash(nes.ppu.front));
+
+    EXPECT_FALSE(seen.empty());
+    for (u64 hash : seen) {
+        EXPECT_EQ(1u, expected.count(hash));
+    }
+}
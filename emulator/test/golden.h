@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * A picture hashes to the offset basis when none of its dots is hashed.
+ */
+inline bool OnlyEmptyPictures(const std::vector<u64>& hashes)
+{
+    return !hashes.empty() && std::count(hashes.begin(), hashes.end(), FnvOffsetBasis) == std::ptrdiff_t(hashes.size());
+}
+
+/**
+ * Runs rom without input until frames pictures are completed and compares
+ * the hash of each one (Ppu::hashPictures) with the golden file, one
+ * hexadecimal hash per line, # starting a comment. Set UPDATE_GOLDEN in the
+ * environment to write the golden file instead, after a deliberate change
+ * of the rendering.
+ */
+inline testing::AssertionResult MatchesGoldenHashes(const std::string& romPath, u32 frames, const std::string& goldenPath)
+{
+    std::vector<u64> hashes;
+    {
+        Frankenstein::Rom rom(Frankenstein::RomLoader::GetRom(romPath));
+        Frankenstein::Nes nes(rom);
+        nes.ppu.hashPictures = true;
+        u64 taken[Frankenstein::Ppu::PictureHashHistory];
+        while (hashes.size() < frames) {
+            nes.RunFrame();
+            u32 count = nes.ppu.TakePictureHashes(taken, Frankenstein::Ppu::PictureHashHistory);
+            hashes.insert(hashes.end(), taken, taken + count);
+        }
+        hashes.resize(frames);
+        delete[] rom.GetRaw();
+    }
+
+    if (getenv("UPDATE_GOLDEN") != nullptr) {
+        if (OnlyEmptyPictures(hashes)) {
+            return testing::AssertionFailure() << romPath << " only draws empty pictures, not writing " << goldenPath;
+        }
+        std::ofstream out(goldenPath);
+        out << "# " << romPath << ", " << frames << " pictures without input\n";
+        for (u64 hash : hashes) {
+            out << std::hex << std::setw(16) << std::setfill('0') << hash << "\n";
+        }
+        if (!out) {
+            return testing::AssertionFailure() << "cannot write " << goldenPath;
+        }
+        return testing::AssertionSuccess();
+    }
+
+    std::ifstream in(goldenPath);
+    if (!in) {
+        return testing::AssertionFailure() << "no " << goldenPath << ", run with UPDATE_GOLDEN=1 to create it";
+    }
+    std::vector<u64> golden;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[0] != '#') {
+            golden.push_back(std::stoull(line, nullptr, 16));
+        }
+    }
+    if (OnlyEmptyPictures(golden)) {
+        return testing::AssertionFailure() << goldenPath << " only holds empty pictures, it cannot fail";
+    }
+    for (size_t i = 0; i < hashes.size() && i < golden.size(); ++i) {
+        if (hashes[i] != golden[i]) {
+            return testing::AssertionFailure() << romPath << ": picture " << i << " is " << std::hex << hashes[i]
+                                               << " instead of " << golden[i] << " (" << goldenPath << ")";
+        }
+    }
+    if (golden.size() != hashes.size()) {
+        return testing::AssertionFailure() << goldenPath << " holds " << golden.size() << " hashes, not " << frames;
+    }
+    return testing::AssertionSuccess();
+}
@@ -0,0 +1,73 @@
+#include "common.h"
+
+#include <instance_groups.h>
+
+using namespace Frankenstein;
+
+struct InstanceGroupsTest : BalloonFightTest {
+    InstanceGroupsTest()
+    {
+        for (u32 i = 0; i < 60; ++i) {
+            nes.RunFrame();
+        }
+    }
+
+    // buttons of an instance at a frame: instances 0-3 start a game at frame 10,
+    // then each one flaps with its own period
+    static u8 Buttons(u32 index, u32 frame)
+    {
+        u8 buttons = 0;
+        if (index < 4 && frame >= 10 && frame < 14) {
+            buttons |= 1 << Gamepad::Start;
+        }
+        if (frame >= 60 && (frame / (index + 2)) % 2 == 0) {
+            buttons |= 1 << Gamepad::A;
+        }
+        return buttons;
+    }
+};
+
+TEST_F(InstanceGroupsTest, RunFrame_SameAsIndependentInstances)
+{
+    const u32 count = 8;
+    const u32 frames = 90;
+    InstanceGroups groups(nes, count);
+    for (u32 frame = 0; frame < frames; ++frame) {
+        for (u32 i = 0; i < count; ++i) {
+            groups.SetButtons(i, Buttons(i, frame));
+        }
+        groups.RunFrame();
+    }
+
+    alignas(8) u8 expected[sizeof(NesState)];
+    alignas(8) u8 actual[sizeof(NesState)];
+    for (u32 i = 0; i < count; ++i) {
+        Nes* single = nes.Fork();
+        for (u32 frame = 0; frame < frames; ++frame) {
+            single->pad1.SetButtons(Buttons(i, frame));
+            single->RunFrame();
+        }
+        single->SaveState(expected);
+        groups.Get(i).SaveState(actual);
+        EXPECT_EQ(0, memcmp(expected, actual, sizeof(NesState))) << "instance " << i;
+        delete single;
+    }
+}
+
+TEST_F(InstanceGroupsTest, RunFrame_EmulatesIdenticalInstancesOnce)
+{
+    InstanceGroups groups(nes, 8);
+    groups.RunFrame();
+    EXPECT_EQ(1u, groups.GetEmulated());
+    EXPECT_EQ(&groups.Get(0), &groups.Get(7));
+
+    groups.SetButtons(5, 1 << Gamepad::Start);
+    groups.RunFrame();
+    EXPECT_EQ(2u, groups.GetEmulated());
+
+    // once diverged, instances stay apart even with the same buttons
+    groups.SetButtons(5, 0);
+    groups.RunFrame();
+    EXPECT_EQ(2u, groups.GetEmulated());
+    EXPECT_NE(&groups.Get(0), &groups.Get(5));
+}
@@ -0,0 +1,84 @@
+#include "common.h"
+
+#include <instruction_trace.h>
+
+#include <cstdio>
+#include <vector>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct InstructionTraceTest : BalloonFightTest {
+    // the records of the first frames of Balloon Fight, traced to path
+    std::vector<InstructionTrace::Record> TraceFrames(const char* path, bool compress, u32 blockRecords)
+    {
+        std::vector<InstructionTrace::Record> expected;
+        InstructionTrace trace(nes, path, compress, 7, blockRecords);
+        EXPECT_TRUE(trace.IsOpen());
+        u64 cycle = 7;
+        while (nes.ppu.Frame < 30) {
+            if (nes.cpu.stall == 0 && !nes.cpu.nmiOccurred) {
+                InstructionTrace::Record record = {};
+                record.cycle = cycle;
+                record.pc = nes.cpu.registers.PC;
+                record.a = nes.cpu.registers.A;
+                record.dot = u16(nes.ppu.Cycle);
+                expected.push_back(record);
+            }
+            trace.Step();
+            cycle += nes.cpu.cycles;
+        }
+        EXPECT_EQ(expected.size(), trace.GetRecords());
+        return expected;
+    }
+};
+
+void ExpectSameRecords(const char* path, bool compressed, const std::vector<InstructionTrace::Record>& expected)
+{
+    InstructionTraceReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    EXPECT_EQ(compressed ? 1u : 0u, reader.GetHeader().compressed);
+    InstructionTrace::Record record;
+    for (const InstructionTrace::Record& wanted : expected) {
+        ASSERT_TRUE(reader.Next(record));
+        ASSERT_EQ(wanted.cycle, record.cycle);
+        ASSERT_EQ(wanted.pc, record.pc);
+        ASSERT_EQ(wanted.a, record.a);
+        ASSERT_EQ(wanted.dot, record.dot);
+    }
+    EXPECT_FALSE(reader.Next(record));
+}
+
+long FileSize(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+}
+
+TEST_F(InstructionTraceTest, Raw_ReadsBackEveryInstruction)
+{
+    const char* path = "instruction_trace_test.trace";
+    // small blocks, so that the emulator has to wait for the writer
+    std::vector<InstructionTrace::Record> expected = TraceFrames(path, false, 256);
+    ExpectSameRecords(path, false, expected);
+    EXPECT_EQ(long(sizeof(InstructionTrace::Header) + expected.size() * sizeof(InstructionTrace::Record)
+                   + (expected.size() + 255) / 256 * sizeof(InstructionTrace::BlockHeader)),
+              FileSize(path));
+    std::remove(path);
+}
+
+TEST_F(InstructionTraceTest, Compressed_ReadsBackEveryInstruction)
+{
+    const char* path = "instruction_trace_test.ctrace";
+    std::vector<InstructionTrace::Record> expected = TraceFrames(path, true, 1 << 16);
+    ExpectSameRecords(path, true, expected);
+    // the registers and the upper bytes barely change
+    EXPECT_GT(long(expected.size() * sizeof(InstructionTrace::Record) / 2), FileSize(path));
+    std::remove(path);
+}
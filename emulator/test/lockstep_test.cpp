@@ -0,0 +1,160 @@
+#include "common.h"
+
+#include <lockstep.h>
+
+#include <cstddef>
+
+using namespace Frankenstein;
+
+namespace {
+
+// flips a RAM byte of its Nes before the instruction at corruptAt
+struct CorruptingCore : LockstepCore {
+    u64 steps = 0;
+    u64 corruptAt;
+    u16 address;
+
+    CorruptingCore(Nes& pNes, u64 pCorruptAt, u16 pAddress) : LockstepCore(pNes), corruptAt(pCorruptAt), address(pAddress)
+    {
+    }
+
+    void Step() override
+    {
+        if (steps++ == corruptAt) {
+            nes.ram[address] = u8(nes.ram[address]) ^ 0xFF;
+        }
+        nes.Step();
+    }
+};
+
+// counts the opcodes executed from the cartridge
+struct OpcodeCounter : BusListener {
+    Nes& nes;
+    u32 executed = 0;
+    u32 unimplemented = 0;
+    u32 nmis = 0;
+
+    explicit OpcodeCounter(Nes& pNes) : nes(pNes)
+    {
+    }
+
+    void OnExecute(u16 address) override
+    {
+        executed++;
+        if (std::string(Cpu::instructions[u8(nes.ram[address])].name) == "UNIMP") {
+            unimplemented++;
+        }
+        if (address == 0xD000) {
+            nmis++;
+        }
+    }
+};
+
+struct LockstepTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(LockstepTest, SameCore_NeverDiverges)
+{
+    Nes& reference = nes;
+    Nes skipped(rom);
+    reference.ppu.AllocateFrameBuffers();
+    skipped.ppu.skipRender = true;
+    LockstepCore candidate(skipped);
+
+    Lockstep frames(reference, candidate, Lockstep::Granularity::Frame);
+    for (u32 i = 0; i < 60; ++i) {
+        ASSERT_TRUE(frames.RunFrame()) << "frame " << i;
+    }
+    EXPECT_EQ(60u, frames.GetComparisons());
+
+    Lockstep instructions(reference, candidate, Lockstep::Granularity::Instruction);
+    ASSERT_TRUE(instructions.RunFrame());
+    EXPECT_EQ(instructions.GetInstructions(), instructions.GetComparisons());
+    EXPECT_FALSE(instructions.HasDiverged());
+}
+
+TEST_F(LockstepTest, Divergence_IsPinpointed)
+{
+    const u64 corruptAt = 5000;
+    const u16 address = 0x0300;
+    u64 lastMatch = 0;
+    {
+        Nes reference(rom);
+        Nes corrupted(rom);
+        CorruptingCore candidate(corrupted, corruptAt, address);
+        Lockstep lockstep(reference, candidate, Lockstep::Granularity::Frame, 0, 8);
+        for (u32 i = 0; i < 10 && lockstep.RunFrame(); ++i) {
+        }
+        ASSERT_TRUE(lockstep.HasDiverged());
+        const Lockstep::Divergence& divergence = lockstep.GetDivergence();
+        EXPECT_LT(corruptAt, divergence.instruction);
+        EXPECT_GT(corruptAt, divergence.lastMatch);
+        EXPECT_EQ(Lockstep::Ram, divergence.parts & Lockstep::Ram);
+        EXPECT_NE(divergence.reference.ram, divergence.candidate.ram);
+        EXPECT_EQ(8u, lockstep.GetWindow(false).size());
+        EXPECT_FALSE(lockstep.Step());
+        lastMatch = divergence.lastMatch;
+    }
+
+    // the same run again, compared after every instruction from the last match
+    Nes reference(rom);
+    Nes corrupted(rom);
+    CorruptingCore candidate(corrupted, corruptAt, address);
+    Lockstep lockstep(reference, candidate, Lockstep::Granularity::Instruction, lastMatch);
+    while (lockstep.Step()) {
+    }
+    const Lockstep::Divergence& divergence = lockstep.GetDivergence();
+    EXPECT_EQ(corruptAt + 1, divergence.instruction);
+    EXPECT_EQ(Lockstep::Ram, divergence.parts);
+    EXPECT_EQ(offsetof(NesState, ram) + address, divergence.offset);
+    EXPECT_EQ(corruptAt + 1 - lastMatch, lockstep.GetComparisons());
+
+    // both machines ran the same instructions until then
+    std::vector<InstructionTrace::Record> expected = lockstep.GetWindow(false);
+    std::vector<InstructionTrace::Record> actual = lockstep.GetWindow(true);
+    ASSERT_EQ(16u, expected.size());
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].pc, actual[i].pc);
+    }
+}
+
+TEST_F(LockstepTest, FuzzRom_IsRepeatable)
+{
+    std::vector<u8> image = Lockstep::MakeFuzzRom(42);
+    EXPECT_EQ(image, Lockstep::MakeFuzzRom(42));
+    EXPECT_NE(image, Lockstep::MakeFuzzRom(43));
+    EXPECT_EQ(16u + 0x4000 + 0x2000, image.size());
+
+    Rom fuzzRom(image.data(), image.size());
+    Nes fuzzed(fuzzRom);
+    EXPECT_EQ(0xC000, fuzzed.cpu.registers.PC);
+    OpcodeCounter counter(fuzzed);
+    fuzzed.bus.Watch(0x8000, 0xFFFF, Bus::Execute, &counter);
+    for (u32 i = 0; i < 5; ++i) {
+        fuzzed.RunFrame();
+    }
+    EXPECT_LT(1000u, counter.executed);
+    EXPECT_EQ(0u, counter.unimplemented);
+    EXPECT_LT(0u, counter.nmis);
+}
+
+TEST_F(LockstepTest, Pipeline_MatchesOnFuzzRoms)
+{
+    for (u64 seed = 1; seed <= 4; ++seed) {
+        std::vector<u8> image = Lockstep::MakeFuzzRom(seed);
+        Rom fuzzRom(image.data(), image.size());
+        Nes reference(fuzzRom);
+        Nes pipelined(fuzzRom);
+        PipelineCore candidate(pipelined);
+        Lockstep lockstep(reference, candidate, Lockstep::Granularity::ScanLine);
+        for (u32 i = 0; i < 5; ++i) {
+            ASSERT_TRUE(lockstep.RunFrame()) << "seed " << seed << ", frame " << i << ", byte "
+                                             << lockstep.GetDivergence().offset;
+        }
+        // the OAM DMA stalls step over a few scanlines at once
+        EXPECT_LT(5u * 200, lockstep.GetComparisons());
+    }
+}
@@ -0,0 +1,115 @@
+#include "common.h"
+
+#include <movie.h>
+#include <cstdio>
+
+using namespace Frankenstein;
+
+struct MovieTest : BalloonFightTest {
+    void RunFrames(Nes& target, Movie& movie, u32 count)
+    {
+        for (u32 i = 0; i < count; ++i) {
+            target.RunFrame();
+            movie.EndFrame();
+        }
+    }
+};
+
+TEST_F(MemoryTest, Gamepad_ReadsLatchedButtons)
+{
+    nes.pad1.buttons[Gamepad::Start] = true;
+    nes.ram[0x4016] = 1;
+    nes.ram[0x4016] = 0;
+    nes.pad1.buttons[Gamepad::Start] = false;
+    nes.pad1.buttons[Gamepad::A] = true;
+
+    u8 bits = 0;
+    for (u8 i = 0; i < 8; ++i) {
+        bits |= (nes.ram[0x4016] & 1) << i;
+    }
+    EXPECT_EQ(1 << Gamepad::Start, bits);
+}
+
+TEST_F(MovieTest, Play_ReproducesRecording)
+{
+    Movie movie(nes);
+    RunFrames(nes, movie, 30);
+    movie.Record();
+
+    // start a game, then flap and steer
+    RunFrames(nes, movie, 90);
+    nes.pad1.buttons[Gamepad::Start] = true;
+    RunFrames(nes, movie, 5);
+    nes.pad1.buttons[Gamepad::Start] = false;
+    RunFrames(nes, movie, 120);
+    for (u32 i = 0; i < 20; ++i) {
+        nes.pad1.buttons[Gamepad::A] = i % 2 == 0;
+        nes.pad1.buttons[Gamepad::Left] = i % 5 == 0;
+        RunFrames(nes, movie, 7);
+    }
+    movie.Stop();
+    ASSERT_TRUE(movie.Save("movie_test.nesm"));
+
+    alignas(8) u8 recorded[sizeof(NesState)];
+    nes.SaveState(recorded);
+    u64 picture = Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+
+    Nes other(rom);
+    Movie replay(other);
+    ASSERT_TRUE(replay.Play("movie_test.nesm"));
+    EXPECT_EQ(movie.GetFrame(), replay.GetLength());
+    while (replay.GetMode() == Movie::Mode::Playing) {
+        other.RunFrame();
+        replay.EndFrame();
+    }
+    EXPECT_EQ(Movie::Mode::Finished, replay.GetMode());
+    EXPECT_EQ(-1, replay.GetFirstMismatch());
+
+    alignas(8) u8 replayed[sizeof(NesState)];
+    other.SaveState(replayed);
+    EXPECT_EQ(0, memcmp(recorded, replayed, sizeof(NesState)));
+    EXPECT_EQ(picture, Fnv1a64((const u8*)other.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor)));
+
+    remove("movie_test.nesm");
+}
+
+TEST_F(MovieTest, Play_RejectsOtherRom)
+{
+    Movie movie(nes);
+    movie.Record();
+    RunFrames(nes, movie, 10);
+    movie.Stop();
+    ASSERT_TRUE(movie.Save("movie_test.nesm"));
+
+    Frankenstein::Rom basics(Frankenstein::RomLoader::GetRom("roms/01-basics.nes"));
+    Nes other(basics);
+    Movie replay(other);
+    EXPECT_FALSE(replay.Play("movie_test.nesm"));
+    EXPECT_EQ(Movie::Mode::Idle, replay.GetMode());
+
+    delete[] basics.GetRaw();
+    remove("movie_test.nesm");
+}
+
+TEST_F(MovieTest, Play_RejectsInputLargerThanItsStream)
+{
+    Movie movie(nes);
+    movie.Record();
+    RunFrames(nes, movie, 10);
+    movie.Stop();
+    ASSERT_TRUE(movie.Save("movie_test.nesm"));
+
+    FILE* f = fopen("movie_test.nesm", "r+b");
+    ASSERT_NE(nullptr, f);
+    u32 inputRawSize = 0xFFFFFFF0;
+    fseek(f, offsetof(Movie::Header, inputRawSize), SEEK_SET);
+    fwrite(&inputRawSize, sizeof(inputRawSize), 1, f);
+    fclose(f);
+
+    Nes other(rom);
+    Movie replay(other);
+    bool played = replay.Play("movie_test.nesm");
+    remove("movie_test.nesm");
+    EXPECT_FALSE(played);
+    EXPECT_EQ(Movie::Mode::Idle, replay.GetMode());
+}
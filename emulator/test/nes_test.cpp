@@ -0,0 +1,55 @@
+#include "common.h"
+
+#include <run_ahead.h>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct FrameCounter : FrameListener {
+    u32 pictures = 0;
+    u32 scanLine = 0;
+
+    void OnFrame(Nes& nes) override
+    {
+        pictures++;
+        scanLine = nes.ppu.ScanLine;
+    }
+};
+
+struct NesTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(NesTest, RunCycles_StopsAfterTheCycles)
+{
+    u64 total = 0;
+    for (u32 cycles : { 1u, 7u, 100u, 29781u }) {
+        u32 elapsed = nes.RunCycles(cycles);
+        EXPECT_LE(cycles, elapsed);
+        // the longest instruction, or the NMI, takes 7 cycles
+        EXPECT_GT(cycles + 7, elapsed);
+        total += elapsed;
+    }
+    // three PPU dots per CPU cycle, 341 dots per line
+    EXPECT_EQ(total * 3 / 341 / 262, nes.ppu.Frame);
+}
+
+TEST_F(NesTest, FrameListener_OncePerPicture)
+{
+    FrameCounter counter;
+    nes.frameListener = &counter;
+    for (u32 i = 0; i < 10; ++i) {
+        nes.RunFrame();
+    }
+    EXPECT_EQ(10u, counter.pictures);
+    EXPECT_EQ(241u, counter.scanLine);
+
+    // only the displayed frame of a run-ahead is a picture
+    RunAhead runAhead(nes, 2);
+    for (u32 i = 0; i < 10; ++i) {
+        runAhead.RunFrame();
+    }
+    EXPECT_EQ(20u, counter.pictures);
+}
@@ -0,0 +1,69 @@
+#include "golden.h"
+
+using namespace Frankenstein;
+
+namespace {
+
+struct PictureHashTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(PictureHashTest, Take_ReturnsEachPictureOnce)
+{
+    u64 hashes[Ppu::PictureHashHistory];
+    nes.RunFrame();
+    EXPECT_EQ(0u, nes.ppu.TakePictureHashes(hashes, Ppu::PictureHashHistory));
+
+    nes.ppu.hashPictures = true;
+    for (u32 i = 0; i < 3; ++i) {
+        nes.RunFrame();
+    }
+    EXPECT_EQ(2u, nes.ppu.TakePictureHashes(hashes, 2));
+    EXPECT_EQ(1u, nes.ppu.TakePictureHashes(hashes, Ppu::PictureHashHistory));
+    EXPECT_EQ(0u, nes.ppu.TakePictureHashes(hashes, Ppu::PictureHashHistory));
+
+    // only the last ones are kept
+    for (u32 i = 0; i < Ppu::PictureHashHistory + 10; ++i) {
+        nes.RunFrame();
+    }
+    EXPECT_EQ(Ppu::PictureHashHistory, nes.ppu.TakePictureHashes(hashes, Ppu::PictureHashHistory + 10));
+}
+
+TEST_F(PictureHashTest, Hash_IgnoresTheFrameBuffers)
+{
+    Nes& drawn = nes;
+    Nes skipped(rom);
+    drawn.ppu.AllocateFrameBuffers();
+    skipped.ppu.skipRender = true;
+    drawn.ppu.hashPictures = true;
+    skipped.ppu.hashPictures = true;
+    u64 a[Ppu::PictureHashHistory];
+    u64 b[Ppu::PictureHashHistory];
+    for (u32 i = 0; i < 60; ++i) {
+        drawn.RunFrame();
+        skipped.RunFrame();
+    }
+    u32 count = drawn.ppu.TakePictureHashes(a, Ppu::PictureHashHistory);
+    ASSERT_EQ(60u, count);
+    ASSERT_EQ(count, skipped.ppu.TakePictureHashes(b, Ppu::PictureHashHistory));
+    for (u32 i = 0; i < count; ++i) {
+        EXPECT_EQ(a[i], b[i]) << "picture " << i;
+    }
+    EXPECT_NE(a[0], a[count - 1]);
+}
+
+TEST_F(PictureHashTest, Golden_ColorTest)
+{
+    EXPECT_TRUE(MatchesGoldenHashes("roms/color_test.nes", 120, "golden/color_test.hashes"));
+}
+
+TEST_F(PictureHashTest, Golden_FullNesPalette)
+{
+    EXPECT_TRUE(MatchesGoldenHashes("roms/full_nes_palette.nes", 120, "golden/full_nes_palette.hashes"));
+}
+
+TEST_F(PictureHashTest, Golden_BalloonFight)
+{
+    EXPECT_TRUE(MatchesGoldenHashes("roms/Balloon Fight (USA).nes", 300, "golden/balloon_fight.hashes"));
+}
@@ -0,0 +1,61 @@
+#include "common.h"
+
+#include <ppu_pipeline.h>
+
+using namespace Frankenstein;
+
+// the same rom run by Nes::RunFrame and by a PpuPipeline, frame by frame
+struct PipelineTest : testing::TestWithParam<const char*> {
+    Frankenstein::Rom rom;
+    Frankenstein::Nes reference;
+    Frankenstein::Nes pipelined;
+
+    PipelineTest() : rom(Frankenstein::RomLoader::GetRom(std::string("roms/") + GetParam())), reference(rom), pipelined(rom)
+    {
+        reference.ppu.AllocateFrameBuffers();
+        pipelined.ppu.AllocateFrameBuffers();
+    }
+
+    virtual ~PipelineTest()
+    {
+        delete[] rom.GetRaw();
+    }
+
+    static u64 PictureHash(const Nes& nes)
+    {
+        return Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+    }
+
+    // presses Start for a few frames now and then, and A every other frame
+    static u8 Buttons(u32 frame)
+    {
+        return ((frame % 90) < 4 ? 1 << Gamepad::Start : 0) | ((frame / 2) % 2) << Gamepad::A;
+    }
+};
+
+TEST_P(PipelineTest, RunFrame_SameAsSingleThread)
+{
+    PpuPipeline pipeline(pipelined);
+    for (u32 frame = 0; frame < 300; ++frame) {
+        reference.pad1.SetButtons(Buttons(frame));
+        pipelined.pad1.SetButtons(Buttons(frame));
+        reference.RunFrame();
+        pipeline.RunFrame();
+        ASSERT_EQ(reference.ppu.Frame, pipeline.GetFrame());
+        ASSERT_EQ(PictureHash(reference), PictureHash(pipelined)) << "frame " << frame;
+    }
+
+    alignas(8) u8 expected[sizeof(NesState)];
+    alignas(8) u8 actual[sizeof(NesState)];
+    reference.SaveState(expected);
+    pipelined.SaveState(actual);
+    EXPECT_EQ(0, memcmp(expected, actual, sizeof(NesState)));
+
+    PpuPipeline::Stats stats = pipeline.GetStats();
+    EXPECT_EQ(0u, stats.mispredictions);
+    EXPECT_EQ(0u, stats.resyncs);
+    EXPECT_LT(0u, stats.writes);
+}
+
+INSTANTIATE_TEST_CASE_P(Roms, PipelineTest,
+    testing::Values("Balloon Fight (USA).nes", "color_test.nes", "full_nes_palette.nes"));
@@ -0,0 +1,106 @@
+#include "common.h"
+
+#include <profiler.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Frankenstein;
+
+namespace {
+
+u64 SumFolded(const std::string& folded)
+{
+    std::istringstream lines(folded);
+    std::string line;
+    u64 sum = 0;
+    while (std::getline(lines, line)) {
+        sum += std::stoull(line.substr(line.rfind(' ') + 1));
+    }
+    return sum;
+}
+
+struct ProfilerTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(ProfilerTest, Cycles_AddUpToTheFrames)
+{
+    Profiler profiler(nes);
+    u64 cycles = 0;
+    for (u32 i = 0; i < 120; ++i) {
+        u64 frame = nes.ppu.Frame;
+        while (nes.ppu.Frame == frame) {
+            profiler.Step();
+            cycles += nes.cpu.cycles;
+        }
+    }
+    EXPECT_EQ(cycles, profiler.GetCycles());
+
+    u64 banks = 0;
+    for (const Profiler::Bank& bank : profiler.GetBanks()) {
+        banks += bank.cycles;
+    }
+    std::ostringstream folded;
+    profiler.WriteFoldedStacks(folded, SymbolTable());
+    // the DMA stalls are in the stacks but not in any bank
+    EXPECT_EQ(cycles, SumFolded(folded.str()));
+    EXPECT_LT(banks, cycles);
+    // no sprite DMA before the game enables the NMI
+    EXPECT_LE(100u * 513u, cycles - banks);
+
+    auto hottest = profiler.GetHottest(5);
+    ASSERT_EQ(5u, hottest.size());
+    EXPECT_GE(hottest[0].second, hottest[4].second);
+    EXPECT_EQ(hottest[0].second, profiler.GetCycles(hottest[0].first));
+
+    profiler.Reset();
+    EXPECT_EQ(0u, profiler.GetCycles());
+}
+
+TEST_F(ProfilerTest, Nmi_IsCalledFromTheInterruptedStack)
+{
+    Profiler profiler(nes);
+    for (u32 i = 0; i < 60; ++i) {
+        profiler.RunFrame();
+    }
+    u16 vector = u16(u8(nes.ram[0xFFFA]) | (u8(nes.ram[0xFFFB]) << 8));
+    SymbolTable symbols;
+    symbols.Add(vector, "nmi");
+    std::ostringstream folded;
+    profiler.WriteFoldedStacks(folded, symbols);
+    std::string text = folded.str();
+    EXPECT_NE(std::string::npos, text.find(";nmi "));
+    EXPECT_NE(std::string::npos, text.find(";nmi;[OAM DMA] "));
+    // RTI leaves the handler, it never nests in itself
+    EXPECT_EQ(std::string::npos, text.find(";nmi;nmi"));
+}
+
+TEST_F(ProfilerTest, Symbols_ReadTheThreeFormats)
+{
+    const char* path = "profiler_test.labels";
+    {
+        std::ofstream labels(path);
+        labels << "version\tmajor=2,minor=0\n"
+               << "sym\tid=0,name=\"reset\",addrsize=absolute,size=1,scope=0,def=1,ref=2,val=0xC000,seg=0,type=lab\n"
+               << "sym\tid=1,name=\"PPUCTRL\",addrsize=absolute,scope=0,def=3,val=0x2000,type=equ\n"
+               << "al 00C010 .main\n"
+               << "C020 update\n"
+               << "nmi = $C030\n";
+    }
+    SymbolTable symbols;
+    ASSERT_TRUE(symbols.Load(path));
+    remove(path);
+
+    EXPECT_EQ(4u, symbols.GetCount());
+    EXPECT_EQ("reset", symbols.GetName(0xC000));
+    EXPECT_EQ("main", symbols.GetName(0xC010));
+    EXPECT_EQ("update", symbols.GetName(0xC020));
+    EXPECT_EQ("nmi", symbols.GetName(0xC030));
+    EXPECT_EQ("$2000", symbols.GetName(0x2000));
+    EXPECT_EQ("main+5", symbols.Locate(0xC015));
+    EXPECT_EQ("$8000", symbols.Locate(0x8000));
+    EXPECT_FALSE(symbols.Load("missing.labels"));
+}
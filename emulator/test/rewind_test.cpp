@@ -0,0 +1,124 @@
+#include "common.h"
+
+#include <pack_bits.h>
+#include <rewind.h>
+#include <vector>
+
+using namespace Frankenstein;
+
+struct RewindTest : BalloonFightTest {
+    void RunFrames(u32 count)
+    {
+        u64 target = nes.ppu.Frame + count;
+        while (nes.ppu.Frame < target) {
+            nes.Step();
+        }
+    }
+
+    std::vector<u8> Snapshot()
+    {
+        std::vector<u8> state(sizeof(NesState) + 8);
+        nes.SaveState(state.data());
+        state.resize(sizeof(NesState));
+        return state;
+    }
+};
+
+TEST(PackBitsTest, RoundTrip)
+{
+    u8 source[1000];
+    for (u32 i = 0; i < sizeof(source); ++i) {
+        source[i] = i < 300 ? 0 : (i < 600 ? u8(i * 7) : u8(i / 100));
+    }
+    u8 packed[PackBits::Bound(sizeof(source))];
+    u8 unpacked[sizeof(source)];
+
+    u32 size = PackBits::Compress(source, sizeof(source), packed);
+    EXPECT_LT(size, sizeof(source));
+    EXPECT_EQ(sizeof(source), PackBits::Decompress(packed, size, unpacked, sizeof(unpacked)));
+    EXPECT_EQ(0, memcmp(source, unpacked, sizeof(source)));
+}
+
+TEST(PackBitsTest, Decompress_Overflow)
+{
+    u8 source[64] = { 0 };
+    u8 packed[PackBits::Bound(sizeof(source))];
+    u8 unpacked[32];
+
+    u32 size = PackBits::Compress(source, sizeof(source), packed);
+    EXPECT_EQ(0u, PackBits::Decompress(packed, size, unpacked, sizeof(unpacked)));
+}
+
+TEST(PackBitsTest, ExpandedBound_LongestRuns)
+{
+    u8 source[1300] = { 0 };
+    u8 packed[PackBits::Bound(sizeof(source))];
+
+    u32 size = PackBits::Compress(source, sizeof(source), packed);
+    EXPECT_EQ(20u, size);
+    EXPECT_EQ(sizeof(source), PackBits::ExpandedBound(size));
+    EXPECT_EQ(sizeof(source), PackBits::ExpandedBound(size + 1));
+}
+
+TEST_F(RewindTest, Pop_RestoresFramesInReverseOrder)
+{
+    Rewind rewind(nes, 4 * 1024 * 1024, 10);
+    std::vector<std::vector<u8>> states;
+
+    RunFrames(30);
+    for (u32 i = 0; i < 45; ++i) {
+        rewind.Push();
+        states.push_back(Snapshot());
+        RunFrames(1);
+    }
+    EXPECT_EQ(45u, rewind.GetStats().frames);
+    EXPECT_EQ(5u, rewind.GetStats().keyframes);
+
+    for (u32 i = 45; i > 0; --i) {
+        ASSERT_TRUE(rewind.Pop());
+        EXPECT_EQ(states[i - 1], Snapshot());
+    }
+    EXPECT_FALSE(rewind.Pop());
+}
+
+TEST_F(RewindTest, Push_AfterPop)
+{
+    Rewind rewind(nes, 4 * 1024 * 1024, 4);
+
+    for (u32 i = 0; i < 10; ++i) {
+        rewind.Push();
+        RunFrames(1);
+    }
+    for (u32 i = 0; i < 6; ++i) {
+        rewind.Pop();
+    }
+    auto expected = Snapshot();
+    rewind.Push();
+    RunFrames(3);
+
+    ASSERT_TRUE(rewind.Pop());
+    EXPECT_EQ(expected, Snapshot());
+    EXPECT_EQ(4u, rewind.GetStats().frames);
+}
+
+TEST_F(RewindTest, Push_StaysWithinBudget)
+{
+    const u32 budget = 64 * 1024;
+    Rewind rewind(nes, budget, 8);
+    std::vector<u8> last;
+
+    for (u32 i = 0; i < 300; ++i) {
+        rewind.Push();
+        last = Snapshot();
+        RunFrames(1);
+        EXPECT_LE(rewind.GetStats().used, budget);
+    }
+
+    Rewind::Stats stats = rewind.GetStats();
+    EXPECT_GT(stats.frames, 8u);
+    EXPECT_LT(stats.frames, 300u);
+    EXPECT_GT(stats.rawBytes, u64(stats.used));
+
+    ASSERT_TRUE(rewind.Pop());
+    EXPECT_EQ(last, Snapshot());
+}
@@ -0,0 +1,71 @@
+#include "common.h"
+
+#include <run_ahead.h>
+
+using namespace Frankenstein;
+
+struct RunAheadTest : BalloonFightTest {
+    static u64 PictureHash(const Nes& target)
+    {
+        return Fnv1a64((const u8*)target.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+    }
+
+    // frames shown between pressing Start on the title screen and the picture changing
+    u32 StartLatency(Nes& target, u32 frames)
+    {
+        target.ppu.AllocateFrameBuffers();
+        RunAhead runAhead(target, frames);
+        for (u32 i = 0; i < 120; ++i) {
+            runAhead.RunFrame();
+        }
+        u64 title = PictureHash(target);
+
+        target.pad1.buttons[Gamepad::Start] = true;
+        for (u32 latency = 1; latency < 60; ++latency) {
+            runAhead.RunFrame();
+            if (PictureHash(target) != title) {
+                return latency;
+            }
+        }
+        return 60;
+    }
+};
+
+TEST_F(RunAheadTest, RunFrame_AdvancesOneFrame)
+{
+    RunAhead runAhead(nes, 2);
+    u64 frame = nes.ppu.Frame;
+    runAhead.RunFrame();
+    EXPECT_EQ(frame + 1, nes.ppu.Frame);
+}
+
+TEST_F(RunAheadTest, RunFrame_SameStateAsPlainRun)
+{
+    alignas(8) u8 expected[sizeof(NesState)];
+    alignas(8) u8 actual[sizeof(NesState)];
+
+    for (u32 i = 0; i < 90; ++i) {
+        nes.RunFrame();
+    }
+    nes.SaveState(expected);
+
+    Nes other(rom);
+    RunAhead runAhead(other, 3);
+    for (u32 i = 0; i < 90; ++i) {
+        runAhead.RunFrame();
+    }
+    other.SaveState(actual);
+
+    EXPECT_EQ(0, memcmp(expected, actual, sizeof(NesState)));
+}
+
+TEST_F(RunAheadTest, RunFrame_ReducesLatency)
+{
+    u32 plain = StartLatency(nes, 0);
+
+    Nes other(rom);
+    u32 ahead = StartLatency(other, 2);
+
+    EXPECT_LT(plain, 60u);
+    EXPECT_EQ(plain - 2, ahead);
+}
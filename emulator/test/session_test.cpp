@@ -0,0 +1,73 @@
+#include "common.h"
+
+#include <session_host.h>
+#include <thread_pool.h>
+
+#include <vector>
+
+using namespace Frankenstein;
+
+TEST(ThreadPoolTest, Wait_RunsEveryTask)
+{
+    ThreadPool pool(4);
+    std::atomic<u32> done(0);
+    for (u32 i = 0; i < 100; ++i) {
+        // tasks queued from a worker go to its own queue, the others steal them
+        pool.Submit([&pool, &done] {
+            for (u32 j = 0; j < 10; ++j) {
+                pool.Submit([&done] { done++; });
+            }
+            done++;
+        });
+    }
+    pool.Wait();
+    EXPECT_EQ(1100u, done.load());
+}
+
+struct SessionTest : BalloonFightTest {
+};
+
+TEST_F(SessionTest, Sessions_RunInRealTime)
+{
+    SessionHost host(2);
+    u32 first = host.Add(rom);
+    u32 second = host.Add(rom, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    // 30 frame periods, the scheduling jitter of a loaded machine aside
+    SessionHost::Stats stats = host.GetStats(first);
+    EXPECT_LE(20u, stats.frames);
+    EXPECT_GE(32u, stats.frames);
+    EXPECT_LE(20u, host.GetStats(second).frames);
+
+    std::vector<Ppu::RGBColor> picture(256 * 240);
+    EXPECT_LT(0u, host.CollectFrame(first, picture.data()));
+    EXPECT_EQ(0u, host.CollectFrame(second, picture.data()));
+
+    host.Remove(first);
+    EXPECT_EQ(1u, host.Size());
+    EXPECT_EQ(0u, host.GetStats(first).frames);
+}
+
+TEST_F(SessionTest, SetButtons_ReachesTheGame)
+{
+    SessionHost host(1);
+    u32 idle = host.Add(rom);
+    u32 started = host.Add(rom);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    host.SetButtons(started, 1 << Gamepad::Start);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    host.SetButtons(started, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // the title screen against the game
+    std::vector<Ppu::RGBColor> title(256 * 240);
+    std::vector<Ppu::RGBColor> game(256 * 240);
+    host.CollectFrame(idle, title.data());
+    host.CollectFrame(started, game.data());
+    EXPECT_NE(0, memcmp(title.data(), game.data(), 256 * 240 * sizeof(Ppu::RGBColor)));
+
+    host.Remove(idle);
+    host.Remove(started);
+    EXPECT_EQ(0u, host.Size());
+}
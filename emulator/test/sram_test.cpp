@@ -0,0 +1,88 @@
+#include "common.h"
+
+#include <battery_saver.h>
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Frankenstein;
+
+namespace {
+
+// the saves go to a directory of their own, removed with what the saver wrote
+struct SramTest : MemoryTest {
+    std::string directory;
+    std::string path;
+
+    SramTest()
+    {
+        std::string pattern = testing::TempDir() + "sram_test_XXXXXX";
+        if (mkdtemp(&pattern[0]) != nullptr) {
+            directory = pattern;
+        }
+    }
+
+    ~SramTest() override
+    {
+        if (!path.empty()) {
+            remove(path.c_str());
+            remove((path + ".tmp").c_str());
+        }
+        if (!directory.empty()) {
+            rmdir(directory.c_str());
+        }
+    }
+};
+
+}
+
+TEST_F(MemoryTest, Sram_PrivateToInstance)
+{
+    nes.ram[0x6000] = 0x12;
+    nes.ram[0x7FFF] = 0x34;
+
+    u8 sram[2];
+    nes.ram.CopyTo(0x6000, &sram[0], 1);
+    nes.ram.CopyTo(0x7FFF, &sram[1], 1);
+    EXPECT_EQ(0x12, sram[0]);
+    EXPECT_EQ(0x34, sram[1]);
+
+    Nes other(rom);
+    EXPECT_EQ(0, other.ram[0x6000]);
+}
+
+TEST_F(MemoryTest, Sram_DirtyPages)
+{
+    nes.ram.TakeDirtySramPages();
+
+    nes.ram[0x6000] = 1;
+    nes.ram[0x60FF] = 1;
+    nes.ram[0x6A10] = 1;
+    nes.ram[0x7F00] = 1;
+    nes.ram[0x0000] = 1;
+
+    EXPECT_EQ((1u << 0) | (1u << 0x0A) | (1u << 0x1F), nes.ram.TakeDirtySramPages());
+    EXPECT_EQ(0u, nes.ram.TakeDirtySramPages());
+}
+
+TEST_F(SramTest, Sram_SaveAndRestore)
+{
+    ASSERT_FALSE(directory.empty());
+    {
+        BatterySaver saver(nes, directory, 0);
+        path = saver.GetPath();
+        nes.ram[0x6123] = 0xAB;
+        nes.ram[0x7004] = 0xCD;
+        saver.Update();
+        saver.Flush();
+    }
+
+    nes.ram[0x6123] = 0;
+    nes.ram[0x7004] = 0;
+    {
+        BatterySaver saver(nes, directory, 0);
+        EXPECT_TRUE(saver.Load());
+    }
+    EXPECT_EQ(0xAB, nes.ram[0x6123]);
+    EXPECT_EQ(0xCD, nes.ram[0x7004]);
+}
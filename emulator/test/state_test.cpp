@@ -0,0 +1,69 @@
+#include "common.h"
+
+using namespace Frankenstein;
+
+struct StateTest : BalloonFightTest {
+    alignas(8) u8 state[sizeof(NesState)];
+    alignas(8) u8 other[sizeof(NesState)];
+
+    StateTest()
+    {
+        nes.ppu.AllocateFrameBuffers();
+    }
+
+    void RunFrames(u32 count)
+    {
+        u64 target = nes.ppu.Frame + count;
+        while (nes.ppu.Frame < target) {
+            nes.Step();
+        }
+    }
+};
+
+TEST_F(StateTest, SaveState_Header)
+{
+    EXPECT_EQ(sizeof(NesState), nes.SaveState(state));
+
+    const NesState& saved = *reinterpret_cast<const NesState*>(state);
+    EXPECT_EQ(NesState::Magic, saved.header.magic);
+    EXPECT_EQ(NesState::Version, saved.header.version);
+    EXPECT_EQ(sizeof(NesState), saved.header.size);
+    EXPECT_EQ(nes.cpu.registers.PC, saved.cpu.PC);
+}
+
+TEST_F(StateTest, LoadState_RejectsOtherVersion)
+{
+    nes.SaveState(state);
+    reinterpret_cast<NesState*>(state)->header.version = NesState::Version + 1;
+    EXPECT_FALSE(nes.LoadState(state));
+}
+
+TEST_F(StateTest, LoadState_RoundTrip)
+{
+    RunFrames(30);
+    nes.pad1.buttons[Gamepad::Start] = true;
+    nes.SaveState(state);
+    EXPECT_TRUE(nes.LoadState(state));
+    nes.SaveState(other);
+
+    EXPECT_EQ(0, memcmp(state, other, sizeof(NesState)));
+}
+
+TEST_F(StateTest, LoadState_ReplaysIdentically)
+{
+    RunFrames(60);
+    nes.SaveState(state);
+
+    RunFrames(30);
+    nes.SaveState(other);
+    u64 expectedPixels = Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor));
+
+    RunFrames(7);
+    ASSERT_TRUE(nes.LoadState(state));
+    RunFrames(30);
+
+    alignas(8) u8 replayed[sizeof(NesState)];
+    nes.SaveState(replayed);
+    EXPECT_EQ(0, memcmp(other, replayed, sizeof(NesState)));
+    EXPECT_EQ(expectedPixels, Fnv1a64((const u8*)nes.ppu.front, 256 * 240 * sizeof(Ppu::RGBColor)));
+}
@@ -0,0 +1,76 @@
+#include "common.h"
+
+#include <nes_stats.h>
+#include <ppu_pipeline.h>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct StatsTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(StatsTest, History_KeepsTheLastFrames)
+{
+    NesStats stats;
+    for (u32 i = 1; i <= NesStats::History + 10; ++i) {
+        stats.current.instructions = i;
+        stats.current.nmis = 1;
+        stats.EndFrame(i);
+        EXPECT_EQ(0u, stats.current.instructions);
+    }
+    EXPECT_EQ(NesStats::History + 10, stats.GetFrames());
+    EXPECT_EQ(NesStats::History + 10, stats.Last().instructions);
+    EXPECT_EQ(11u, stats.Last(NesStats::History - 1).instructions);
+
+    FrameStats sum = stats.Sum(3);
+    EXPECT_EQ(NesStats::History + 10, sum.frame);
+    EXPECT_EQ(3 * (NesStats::History + 9), sum.instructions);
+    EXPECT_EQ(3u, sum.nmis);
+}
+
+#ifdef WithStats
+TEST_F(StatsTest, Counters_AddUpToTheFrame)
+{
+    for (u32 i = 0; i < 120; ++i) {
+        nes.RunFrame();
+    }
+    const FrameStats& frame = nes.stats.Last();
+    // 341 * 262 / 3 cycles, less one dot on odd rendered frames
+    EXPECT_NEAR(29780, frame.cpuCycles, 8);
+    EXPECT_EQ(1u, frame.nmis);
+    EXPECT_EQ(1u, frame.oamDmas);
+    EXPECT_LE(513u, frame.dmaStallCycles);
+    EXPECT_GT(frame.cpuCycles, frame.instructions * 2);
+    // the scroll is set once per frame, x then y
+    EXPECT_EQ(2u, frame.registerWrites[5]);
+}
+
+TEST_F(StatsTest, Pipeline_EndsTheFramesAtSync)
+{
+    PpuPipeline pipeline(nes);
+    for (u32 i = 0; i < 120; ++i) {
+        pipeline.RunFrame();
+    }
+    EXPECT_EQ(120u, nes.stats.GetFrames());
+    const FrameStats& frame = nes.stats.Last();
+    EXPECT_EQ(119u, frame.frame);
+    EXPECT_NEAR(29780, frame.cpuCycles, 8);
+    EXPECT_EQ(1u, frame.nmis);
+    EXPECT_EQ(1u, frame.oamDmas);
+    EXPECT_EQ(2u, frame.registerWrites[5]);
+    EXPECT_EQ(0u, frame.cpuNanoseconds);
+}
+
+TEST_F(StatsTest, HostTime_IsSampled)
+{
+    for (u32 i = 0; i < 60; ++i) {
+        nes.RunFrame();
+    }
+    FrameStats sum = nes.stats.Sum(30);
+    EXPECT_LT(0u, sum.cpuNanoseconds);
+    EXPECT_LT(0u, sum.ppuNanoseconds);
+}
+#endif
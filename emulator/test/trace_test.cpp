@@ -0,0 +1,86 @@
+#include "common.h"
+
+#include <chrome_trace.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Frankenstein;
+
+namespace {
+
+struct SpanCounter : TraceSink {
+    u32 begins[u32(TraceEvent::Count)] = {};
+    u32 ends[u32(TraceEvent::Count)] = {};
+    u32 lastScanLine = 0;
+
+    void Begin(TraceEvent event, u32 argument) override
+    {
+        begins[u32(event)]++;
+        if (event == TraceEvent::ScanLines) {
+            lastScanLine = argument;
+        }
+    }
+
+    void End(TraceEvent event) override
+    {
+        ends[u32(event)]++;
+    }
+};
+
+struct TraceTest : BalloonFightTest {
+};
+
+}
+
+TEST_F(TraceTest, Spans_OfAFrame)
+{
+    for (u32 i = 0; i < 120; ++i) {
+        nes.RunFrame();
+    }
+    SpanCounter counter;
+    nes.tracer = &counter;
+    nes.RunFrame();
+    nes.tracer = nullptr;
+
+    EXPECT_EQ(1u, counter.begins[u32(TraceEvent::Run)]);
+    EXPECT_EQ(1u, counter.ends[u32(TraceEvent::Run)]);
+    EXPECT_EQ(1u, counter.begins[u32(TraceEvent::Frame)]);
+    // 262 lines in batches of 8, the frame ends as line 0 starts
+    EXPECT_EQ(33u, counter.begins[u32(TraceEvent::ScanLines)]);
+    EXPECT_EQ(0u, counter.lastScanLine);
+    EXPECT_EQ(1u, counter.begins[u32(TraceEvent::Nmi)]);
+    EXPECT_EQ(1u, counter.begins[u32(TraceEvent::DmaStall)]);
+    EXPECT_EQ(1u, counter.ends[u32(TraceEvent::DmaStall)]);
+}
+
+TEST_F(TraceTest, ChromeTrace_WritesCompleteJson)
+{
+    const char* path = "chrome_trace_test.json";
+    {
+        ChromeTrace trace(path);
+        ASSERT_TRUE(trace.IsOpen());
+        trace.NameThread("emulator");
+        nes.tracer = &trace;
+        for (u32 i = 0; i < 10; ++i) {
+            nes.RunFrame();
+        }
+        nes.tracer = nullptr;
+        EXPECT_EQ(0u, trace.GetDropped());
+    }
+
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    std::string json = content.str();
+    std::remove(path);
+
+    EXPECT_EQ(0u, json.find("{\"displayTimeUnit\""));
+    EXPECT_EQ(json.size() - 4, json.rfind("\n]}\n"));
+    EXPECT_NE(std::string::npos, json.find("\"name\": \"run\", \"ph\": \"B\""));
+    EXPECT_NE(std::string::npos, json.find("\"name\": \"scanlines\", \"cat\": \"nes\", \"ph\": \"b\""));
+    EXPECT_NE(std::string::npos, json.find("\"args\": {\"name\": \"emulator\"}"));
+    // the first frame span has no beginning
+    EXPECT_EQ(json.find("\"name\": \"frame\""), json.find("\"name\": \"frame\", \"cat\": \"nes\", \"ph\": \"b\""));
+}
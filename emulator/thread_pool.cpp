@@ -0,0 +1,144 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace Frankenstein;
+
+namespace {
+
+// the pool and the queue of the worker running on this thread
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local u32 currentWorker = 0;
+
+}
+
+ThreadPool::ThreadPool(u32 threads, bool pin)
+    : nextQueue(0)
+    , steals(0)
+    , pending(0)
+    , queued(0)
+    , stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (u32 i = 0; i < threads; ++i) {
+        workers.emplace_back(new Worker());
+    }
+    // started once every queue exists, the workers steal from each other
+    for (u32 i = 0; i < threads; ++i) {
+        workers[i]->thread = std::thread(&ThreadPool::WorkerMain, this, i, pin);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::Submit(Task task)
+{
+    u32 index = currentPool == this ? currentWorker : nextQueue++ % workers.size();
+    // counted first so that a worker never sees more tasks than counted
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        pending++;
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    wakeUp.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+}
+
+u32 ThreadPool::Size() const
+{
+    return workers.size();
+}
+
+u64 ThreadPool::GetSteals() const
+{
+    return steals.load(std::memory_order_relaxed);
+}
+
+bool ThreadPool::Pop(u32 index, Task& task)
+{
+    // newest task of the own queue first, its data is likely still in cache
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // then the oldest task of the other queues
+    for (u32 i = 1; i < workers.size(); ++i) {
+        Worker& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerMain(u32 index, bool pin)
+{
+    currentPool = this;
+    currentWorker = index;
+
+#ifdef __linux__
+    if (pin) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    for (;;) {
+        Task task;
+        if (Pop(index, task)) {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                queued--;
+            }
+            task();
+            std::lock_guard<std::mutex> guard(mutex);
+            if (--pending == 0) {
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeUp.wait(lock, [this] { return queued > 0 || stopping; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
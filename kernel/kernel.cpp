@@ -6,9 +6,7 @@ static const char FromKernel[] = "kernel";
 
 Nes* CKernel::s_nes = nullptr;
 CLogger* CKernel::s_logger = nullptr;
-CInterruptSystem* CKernel::s_interrupt = nullptr;
-TGamePadState CKernel::s_input_player1;
-TGamePadState CKernel::s_input_player2;
+InputSnapshot* CKernel::s_input = nullptr;
 
 CKernel::CKernel(void)
     : m_Screen(m_Options.GetWidth(), m_Options.GetHeight())
@@ -17,17 +15,11 @@ CKernel::CKernel(void)
     , m_DWHCI(&m_Interrupt, &m_Timer)
     , embedded_rom(Frankenstein::StaticRom::raw, Frankenstein::StaticRom::length)
     , nes(embedded_rom, &m_Screen)
+    , input(nes)
+    , runAhead(nes, RunAheadFrames)
 {
     CKernel::s_logger = &m_Logger;
-    CKernel::s_interrupt = &m_Interrupt;
-
-    CKernel::s_input_player1.axes[0].value = 0;
-    CKernel::s_input_player1.axes[1].value = 0;
-    CKernel::s_input_player1.buttons = 0;
-
-    CKernel::s_input_player2.axes[0].value = 0;
-    CKernel::s_input_player2.axes[1].value = 0;
-    CKernel::s_input_player2.buttons = 0;
+    CKernel::s_input = &input;
 }
 
 CKernel::~CKernel(void)
@@ -117,28 +109,20 @@ TShutdownMode CKernel::Run(void)
 
     m_Logger.Write(FromKernel, LogNotice, "Use your gamepad controls!");
 
-    while (true) {
-        nes.Step();
-        if (nes.cpu.nmiOccurred) {
-            nes.pad1.buttons[Gamepad::ButtonIndex::A]      = s_input_player1.buttons & 0x80;
-            nes.pad1.buttons[Gamepad::ButtonIndex::B]      = s_input_player1.buttons & 0x40;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Select] = s_input_player1.buttons & 0x10;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Start]  = s_input_player1.buttons & 0x20;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Up]     = !s_input_player1.axes[1].value;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Down]   = s_input_player1.axes[1].value == 255;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Left]   = !s_input_player1.axes[0].value;
-            nes.pad1.buttons[Gamepad::ButtonIndex::Right]  = s_input_player1.axes[0].value == 255;
-
-            nes.pad2.buttons[Gamepad::ButtonIndex::A]      = s_input_player2.buttons & 0x80;
-            nes.pad2.buttons[Gamepad::ButtonIndex::B]      = s_input_player2.buttons & 0x40;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Select] = s_input_player2.buttons & 0x10;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Start]  = s_input_player2.buttons & 0x20;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Up]     = !s_input_player2.axes[1].value;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Down]   = s_input_player2.axes[1].value == 255;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Left]   = !s_input_player2.axes[0].value;
-            nes.pad2.buttons[Gamepad::ButtonIndex::Right]  = s_input_player2.axes[0].value == 255;
-
-            m_Interrupt.EnableIRQ(ARM_IRQ_USB);
+    CTracer* tracer = nullptr;
+    if (TracedFrames > 0) {
+        tracer = new CTracer(TraceDepth, TRUE);
+        tracer->Start();
+        nes.tracer = &tracerSink;
+    }
+
+    for (u32 frame = 1; true; frame++) {
+        // the pads take the buttons set by GamePadStatusHandler when the game latches them
+        runAhead.RunFrame();
+        if (frame == TracedFrames) {
+            nes.tracer = nullptr;
+            tracer->Dump();
+            delete tracer;
         }
     }
     return ShutdownHalt;
@@ -146,12 +130,28 @@ TShutdownMode CKernel::Run(void)
 
 void CKernel::GamePadStatusHandler(unsigned nDeviceIndex, const TGamePadState* pState)
 {
-    if(nDeviceIndex == 0) {
-        s_input_player1 = *pState;
-    }
-    else if (nDeviceIndex == 1) {
-        s_input_player2 = *pState;
+    if (nDeviceIndex > 1) {
+        return;
     }
-    s_interrupt->DisableIRQ(ARM_IRQ_USB);
+    u8 buttons = 0;
+    buttons |= (pState->buttons & 0x80 ? 1 : 0) << Gamepad::ButtonIndex::A;
+    buttons |= (pState->buttons & 0x40 ? 1 : 0) << Gamepad::ButtonIndex::B;
+    buttons |= (pState->buttons & 0x10 ? 1 : 0) << Gamepad::ButtonIndex::Select;
+    buttons |= (pState->buttons & 0x20 ? 1 : 0) << Gamepad::ButtonIndex::Start;
+    buttons |= (!pState->axes[1].value ? 1 : 0) << Gamepad::ButtonIndex::Up;
+    buttons |= (pState->axes[1].value == 255 ? 1 : 0) << Gamepad::ButtonIndex::Down;
+    buttons |= (!pState->axes[0].value ? 1 : 0) << Gamepad::ButtonIndex::Left;
+    buttons |= (pState->axes[0].value == 255 ? 1 : 0) << Gamepad::ButtonIndex::Right;
+    // the interrupt never waits for the emulation, nor the emulation for it
+    s_input->SetButtons(nDeviceIndex, buttons);
 }
 
+void CTracerSink::Begin(TraceEvent event, u32 argument)
+{
+    CTracer::Get()->Event(1 + 2 * unsigned(event), argument);
+}
+
+void CTracerSink::End(TraceEvent event)
+{
+    CTracer::Get()->Event(2 + 2 * unsigned(event));
+}
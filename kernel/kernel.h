@@ -13,14 +13,18 @@
 #include <circle/exceptionhandler.h>
 #include <circle/interrupt.h>
 #include <circle/timer.h>
+#include <circle/tracer.h>
 #include <circle/logger.h>
 #include <circle/usb/dwhcidevice.h>
 #include <circle/usb/usbgamepad.h>
 #include <circle/types.h>
 #include <circle/util.h>
 
+#include "../emulator/include/input_snapshot.h"
 #include "../emulator/include/nes.h"
 #include "../emulator/include/rom_static.h"
+#include "../emulator/include/run_ahead.h"
+#include "../emulator/include/trace.h"
 
 using namespace Frankenstein;
 
@@ -31,6 +35,18 @@ enum TShutdownMode
     ShutdownReboot
 };
 
+/**
+ * Records the spans of the emulation in the CTracer ring, dumped to the log
+ * by CTracer::Dump. The event ID is 1 + 2 * TraceEvent for a Begin, one more
+ * for an End; the first parameter is the argument of the Begin.
+ */
+class CTracerSink : public TraceSink
+{
+public:
+    void Begin(TraceEvent event, u32 argument) override;
+    void End(TraceEvent event) override;
+};
+
 class CKernel
 {
 public:
@@ -45,9 +61,16 @@ private:
     static void GamePadStatusHandler (unsigned nDeviceIndex, const TGamePadState *pState);
     static CLogger* s_logger;
     static Nes* s_nes;
-    static TGamePadState s_input_player1;
-    static TGamePadState s_input_player2;
-    static CInterruptSystem* s_interrupt;
+    static InputSnapshot* s_input;
+
+    // frames emulated ahead of the displayed one to hide the game's input lag,
+    // 0 to run plainly; each one costs a state save and load and one more
+    // emulated frame per displayed frame, check the Pi keeps 60 fps first
+    static constexpr u32 RunAheadFrames = 0;
+
+    // frames traced from the start then dumped to the log, 0 to run untraced
+    static constexpr u32 TracedFrames = 0;
+    static constexpr unsigned TraceDepth = 8192;
 
 private:
     // do not change this order
@@ -66,6 +89,9 @@ private:
     // TODO: add more members here
     Rom embedded_rom;
     Nes nes;
+    InputSnapshot input;
+    RunAhead runAhead;
+    CTracerSink tracerSink;
     
 };
 